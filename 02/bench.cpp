@@ -0,0 +1,437 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "linearallocator.h"
+
+/*
+ * Allocation throughput benchmark.
+ * Compares LinearAllocator against malloc, new and std::pmr::monotonic_buffer_resource
+ * on several workloads and prints ns/alloc, cache misses and peak RSS growth.
+ * Every measurement runs in a child process, so peak RSS is not shared between the backends.
+ */
+
+/* Hardware cache miss counter, silently disabled when perf_event_open is not available */
+class CacheMissCounter
+{
+private:
+    int m_fd; /* perf event file descriptor or -1 */
+public:
+    CacheMissCounter(): m_fd(-1)
+    {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1; /* count threads spawned by the workload too */
+        m_fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    ~CacheMissCounter()
+    {
+#ifdef __linux__
+        if (m_fd != -1)
+        {
+            close(m_fd);
+        }
+#endif
+    }
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+    /* Check if the counter works */
+    bool isAvailable() const { return m_fd != -1; }
+    /* Reset and start counting */
+    void start()
+    {
+#ifdef __linux__
+        if (m_fd != -1)
+        {
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    /* Stop counting and return the number of misses since start() */
+    std::uint64_t stop()
+    {
+        std::uint64_t value = 0;
+#ifdef __linux__
+        if (m_fd != -1)
+        {
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_fd, &value, sizeof(value)) != sizeof(value))
+            {
+                value = 0;
+            }
+        }
+#endif
+        return value;
+    }
+};
+
+/* Peak resident set size of the process in kilobytes */
+long getPeakRssKb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/* Current resident set size of the process in kilobytes, 0 if it is unknown */
+long getCurrentRssKb()
+{
+    long pageCount = 0;
+    long residentCount = 0;
+    std::ifstream statm("/proc/self/statm");
+    if (statm >> pageCount >> residentCount)
+    {
+        return residentCount * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    return 0;
+}
+
+/*
+ * Allocator backends.
+ * Each backend provides alloc(size) and reset(); reset() returns all memory allocated since the previous reset.
+ * reserve(count) prepares a backend for count allocations before the measured loop.
+ */
+
+struct LinearBackend
+{
+    LinearAllocator allocator;
+
+    explicit LinearBackend(std::size_t arenaSize): allocator(arenaSize)
+    {
+    }
+    char* alloc(std::size_t size)
+    {
+        return allocator.alloc(size);
+    }
+    void reserve(std::size_t)
+    {
+    }
+    void reset()
+    {
+        allocator.reset();
+    }
+    static const char* name() { return "LinearAllocator"; }
+};
+
+struct MallocBackend
+{
+    std::vector<void*> chunks; /* allocated chunks to be released on reset */
+
+    explicit MallocBackend(std::size_t)
+    {
+    }
+    ~MallocBackend()
+    {
+        reset();
+    }
+    char* alloc(std::size_t size)
+    {
+        void* chunk = std::malloc(size);
+        chunks.push_back(chunk);
+        return static_cast<char*>(chunk);
+    }
+    /* Reserve room for the chunks, so the measured loop doesn't grow the vector */
+    void reserve(std::size_t count)
+    {
+        chunks.reserve(count);
+    }
+    void reset()
+    {
+        for (void* chunk : chunks)
+        {
+            std::free(chunk);
+        }
+        chunks.clear();
+    }
+    static const char* name() { return "malloc"; }
+};
+
+struct NewBackend
+{
+    std::vector<char*> chunks; /* allocated chunks to be released on reset */
+
+    explicit NewBackend(std::size_t)
+    {
+    }
+    ~NewBackend()
+    {
+        reset();
+    }
+    char* alloc(std::size_t size)
+    {
+        char* chunk = new char[size];
+        chunks.push_back(chunk);
+        return chunk;
+    }
+    /* Reserve room for the chunks, so the measured loop doesn't grow the vector */
+    void reserve(std::size_t count)
+    {
+        chunks.reserve(count);
+    }
+    void reset()
+    {
+        for (char* chunk : chunks)
+        {
+            delete[] chunk;
+        }
+        chunks.clear();
+    }
+    static const char* name() { return "new"; }
+};
+
+struct MonotonicBackend
+{
+    std::pmr::monotonic_buffer_resource resource;
+
+    explicit MonotonicBackend(std::size_t arenaSize): resource(arenaSize)
+    {
+    }
+    char* alloc(std::size_t size)
+    {
+        return static_cast<char*>(resource.allocate(size, 1));
+    }
+    void reserve(std::size_t)
+    {
+    }
+    void reset()
+    {
+        resource.release();
+    }
+    static const char* name() { return "pmr::monotonic"; }
+};
+
+/* Workload parameters */
+const std::size_t ALLOC_COUNT = 1 << 19;     /* allocations per workload per thread */
+const std::size_t TINY_SIZE = 16;            /* size of a tiny allocation */
+const std::size_t MIXED_MAX_SIZE = 512;      /* upper bound of a mixed size allocation */
+const std::size_t CYCLE_LENGTH = 1024;       /* allocations between resets in the cycle workload */
+const std::size_t THREAD_COUNT = 4;          /* thread count of the multi-threaded workload */
+const unsigned int SEED = 2019;              /* seed of the mixed size generator */
+
+/* Precomputed allocation sizes, so the generator stays out of the measured loop */
+std::vector<std::size_t> makeSizes(bool mixed)
+{
+    std::vector<std::size_t> sizes(ALLOC_COUNT, TINY_SIZE);
+    if (mixed)
+    {
+        std::mt19937 generator(SEED);
+        std::uniform_int_distribution<std::size_t> distribution(1, MIXED_MAX_SIZE);
+        for (std::size_t& size : sizes)
+        {
+            size = distribution(generator);
+        }
+    }
+    return sizes;
+}
+
+/* Sum of the sizes, arenas are sized by it */
+std::size_t totalSize(const std::vector<std::size_t>& sizes)
+{
+    std::size_t total = 0;
+    for (std::size_t size : sizes)
+    {
+        total += size;
+    }
+    return total;
+}
+
+/*
+ * Run allocations of given sizes on a backend, reset it every cycleLength allocations.
+ * Every chunk is touched so that allocation cost includes bringing memory into the cache.
+ * Returns the checksum of touched bytes to keep the loop alive.
+ */
+template<typename Backend>
+std::size_t runAllocations(Backend& backend, const std::vector<std::size_t>& sizes, std::size_t cycleLength)
+{
+    std::size_t checksum = 0;
+    for (std::size_t i = 0; i < sizes.size(); ++i)
+    {
+        char* chunk = backend.alloc(sizes[i]);
+        chunk[0] = static_cast<char>(i);
+        checksum += reinterpret_cast<std::uintptr_t>(chunk) & 0xFF;
+        if (cycleLength && (i + 1) % cycleLength == 0)
+        {
+            backend.reset();
+        }
+    }
+    backend.reset();
+    return checksum;
+}
+
+/* Measurement of a single workload run */
+struct Measurement
+{
+    double nsPerAlloc;
+    std::uint64_t cacheMisses;
+    long peakRssKb; /* growth of peak RSS over RSS at the start of the run */
+};
+
+/* Run a workload on threadCount threads, each one owning its own backend (arena) */
+template<typename Backend>
+Measurement runWorkloadOnce(const std::vector<std::size_t>& sizes, std::size_t cycleLength, std::size_t threadCount)
+{
+    const std::size_t arenaSize = cycleLength ? cycleLength * MIXED_MAX_SIZE : totalSize(sizes);
+    std::vector<std::size_t> checksums(threadCount);
+    CacheMissCounter counter;
+    const long startRssKb = getCurrentRssKb();
+    std::vector<std::unique_ptr<Backend>> backends;
+    for (std::size_t t = 0; t < threadCount; ++t)
+    {
+        backends.emplace_back(new Backend(arenaSize));
+        backends.back()->reserve(cycleLength ? cycleLength : sizes.size());
+    }
+
+    counter.start();
+    auto start = std::chrono::steady_clock::now();
+    if (threadCount == 1)
+    {
+        checksums[0] = runAllocations(*backends[0], sizes, cycleLength);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&sizes, &checksums, &backends, cycleLength, t]()
+            {
+                checksums[t] = runAllocations(*backends[t], sizes, cycleLength);
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+    auto finish = std::chrono::steady_clock::now();
+    std::uint64_t cacheMisses = counter.stop();
+
+    volatile std::size_t sink = 0;
+    for (std::size_t checksum : checksums)
+    {
+        sink += checksum;
+    }
+    (void) sink;
+
+    double ns = std::chrono::duration<double, std::nano>(finish - start).count();
+    return { ns / (sizes.size() * threadCount), cacheMisses, getPeakRssKb() - startRssKb };
+}
+
+/*
+ * Run a workload in a child process: peak RSS of a process never goes down, so a backend measured
+ * in the benchmark process itself would report the peak of the largest run before it.
+ * The workload runs in process if fork() fails.
+ */
+template<typename Backend>
+Measurement measure(const std::vector<std::size_t>& sizes, std::size_t cycleLength, std::size_t threadCount)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return runWorkloadOnce<Backend>(sizes, cycleLength, threadCount);
+    }
+    std::cout.flush(); /* the child must not repeat buffered output */
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Measurement measurement = runWorkloadOnce<Backend>(sizes, cycleLength, threadCount);
+        bool isWritten = write(fds[1], &measurement, sizeof(measurement)) == sizeof(measurement);
+        _exit(isWritten ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0)
+    {
+        close(fds[0]);
+        return runWorkloadOnce<Backend>(sizes, cycleLength, threadCount);
+    }
+    Measurement measurement = { 0, 0, 0 };
+    if (read(fds[0], &measurement, sizeof(measurement)) != sizeof(measurement))
+    {
+        std::cerr << "Measurement of " << Backend::name() << " failed" << std::endl;
+    }
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+    return measurement;
+}
+
+/* Print a row of the result table */
+void report(const char* workload, const char* backend, const Measurement& m, bool perfAvailable)
+{
+    std::cout << std::left << std::setw(14) << workload
+              << std::setw(18) << backend
+              << std::right << std::setw(12) << std::fixed << std::setprecision(2) << m.nsPerAlloc
+              << std::setw(16);
+    if (perfAvailable)
+    {
+        std::cout << m.cacheMisses;
+    }
+    else
+    {
+        std::cout << "n/a";
+    }
+    std::cout << std::setw(16) << m.peakRssKb << std::endl;
+}
+
+/* Run one workload on every backend */
+void runWorkload(const char* workload, const std::vector<std::size_t>& sizes, std::size_t cycleLength, std::size_t threadCount,
+                 bool perfAvailable)
+{
+    report(workload, LinearBackend::name(), measure<LinearBackend>(sizes, cycleLength, threadCount), perfAvailable);
+    report(workload, MallocBackend::name(), measure<MallocBackend>(sizes, cycleLength, threadCount), perfAvailable);
+    report(workload, NewBackend::name(), measure<NewBackend>(sizes, cycleLength, threadCount), perfAvailable);
+    report(workload, MonotonicBackend::name(), measure<MonotonicBackend>(sizes, cycleLength, threadCount), perfAvailable);
+}
+
+/* Benchmark suit */
+void runBenchmarks()
+{
+    bool perfAvailable = CacheMissCounter().isAvailable();
+    const std::vector<std::size_t> tinySizes = makeSizes(false);
+    const std::vector<std::size_t> mixedSizes = makeSizes(true);
+
+    std::cout << std::left << std::setw(14) << "workload" << std::setw(18) << "allocator"
+              << std::right << std::setw(12) << "ns/alloc" << std::setw(16) << "cache misses"
+              << std::setw(16) << "RSS growth, KB" << std::endl;
+    runWorkload("tiny", tinySizes, 0, 1, perfAvailable);
+    runWorkload("tiny+reset", tinySizes, CYCLE_LENGTH, 1, perfAvailable);
+    runWorkload("mixed", mixedSizes, 0, 1, perfAvailable);
+    runWorkload("mixed+reset", mixedSizes, CYCLE_LENGTH, 1, perfAvailable);
+    runWorkload("mixed+threads", mixedSizes, CYCLE_LENGTH, THREAD_COUNT, perfAvailable);
+    if (!perfAvailable)
+    {
+        std::cout << "perf_event_open is not available, cache misses are not measured." << std::endl;
+    }
+}
+
+/* Program entry point */
+int main(void) {
+    runBenchmarks();
+}
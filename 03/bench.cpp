@@ -0,0 +1,487 @@
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "observable.h"
+#include "saxparser.h"
+#include "saxtokens.h"
+#include "staticsaxparser.h"
+#include "utf8.h"
+#include "wordcounter.h"
+
+/*
+ * Parser throughput benchmark.
+ * Parses seeded corpora of several shapes with SaxParser and a varying listener count,
+ * compares the alternative consumers on a mixed corpus, the extended grammar and UTF-8 validation
+ * with the basic grammar, and measures the dispatch cost of Observable per listener count.
+ * Every parsing consumer computes the same checksum over the tokens, so the results are comparable;
+ * word counting consumers report the count of distinct words.
+ * The benchmark fails if the pull iterator is slower than the callbacks.
+ */
+
+const std::size_t CORPUS_SIZE = 32 << 20;   /* generated corpus size in bytes */
+const unsigned int SEED = 2019;             /* corpus generator seed */
+const std::size_t REPEAT_COUNT = 3;         /* runs per measurement, the best one is reported */
+const std::size_t EVENT_COUNT = 10000000;   /* events fired per dispatch measurement */
+
+/* Corpus generator, appends one token with its separator */
+typedef std::function<void(std::mt19937& generator, std::string& corpus)> TokenGenerator;
+
+/* Generate a corpus of CORPUS_SIZE bytes */
+std::string generateCorpus(const TokenGenerator& generateToken)
+{
+    std::mt19937 generator(SEED);
+    std::string corpus;
+    corpus.reserve(CORPUS_SIZE + 4096);
+    while (corpus.size() < CORPUS_SIZE)
+    {
+        generateToken(generator, corpus);
+    }
+    return corpus;
+}
+
+/* Append a word of lowercase latin letters */
+void appendWord(std::mt19937& generator, std::string& corpus)
+{
+    std::uniform_int_distribution<std::size_t> wordLength(1, 12);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::size_t length = wordLength(generator);
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        corpus += static_cast<char>(letter(generator));
+    }
+}
+
+/* Append an integer below a million */
+void appendNumber(std::mt19937& generator, std::string& corpus)
+{
+    std::uniform_int_distribution<unsigned long> number(0, 1000000);
+    corpus += std::to_string(number(generator));
+}
+
+/* Four tokens of five are latin words, the rest are integers */
+void generateMixedToken(std::mt19937& generator, std::string& corpus)
+{
+    std::uniform_int_distribution<int> kind(0, 4);
+    if (kind(generator))
+    {
+        appendWord(generator, corpus);
+    }
+    else
+    {
+        appendNumber(generator, corpus);
+    }
+    corpus += ' ';
+}
+
+/* Words only */
+void generateWordToken(std::mt19937& generator, std::string& corpus)
+{
+    appendWord(generator, corpus);
+    corpus += ' ';
+}
+
+/* Integers only, every fourth one has up to 20 digits */
+void generateNumberToken(std::mt19937& generator, std::string& corpus)
+{
+    std::uniform_int_distribution<int> kind(0, 3);
+    if (kind(generator))
+    {
+        appendNumber(generator, corpus);
+    }
+    else
+    {
+        std::uniform_int_distribution<unsigned long> number;
+        corpus += std::to_string(number(generator));
+    }
+    corpus += ' ';
+}
+
+/* Mixed tokens separated by runs of up to 200 spaces, tabs and newlines */
+void generateSparseToken(std::mt19937& generator, std::string& corpus)
+{
+    static const char SPACES[] = { ' ', '\t', '\n', ' ' };
+    std::uniform_int_distribution<std::size_t> runLength(1, 200);
+    std::uniform_int_distribution<std::size_t> space(0, sizeof(SPACES) - 1);
+    generateMixedToken(generator, corpus);
+    std::size_t length = runLength(generator);
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        corpus += SPACES[space(generator)];
+    }
+}
+
+/* Words of Cyrillic, Greek and CJK characters, multi-byte UTF-8 characters are letters for the parser */
+void generateUtf8Token(std::mt19937& generator, std::string& corpus)
+{
+    static const char* const LETTERS[] = { "а", "б", "в", "ж", "я", "α", "β", "λ", "ω", "字", "語", "文" };
+    std::uniform_int_distribution<std::size_t> wordLength(1, 8);
+    std::uniform_int_distribution<std::size_t> letter(0, sizeof(LETTERS) / sizeof(LETTERS[0]) - 1);
+    std::uniform_int_distribution<int> kind(0, 9);
+    if (kind(generator))
+    {
+        std::size_t length = wordLength(generator);
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            corpus += LETTERS[letter(generator)];
+        }
+    }
+    else
+    {
+        appendNumber(generator, corpus);
+    }
+    corpus += ' ';
+}
+
+/* Signed integers and decimal numbers of the extended grammar */
+void generateSignedToken(std::mt19937& generator, std::string& corpus)
+{
+    std::uniform_int_distribution<long> number(-1000000, 1000000);
+    std::uniform_int_distribution<int> kind(0, 1);
+    const long value = number(generator);
+    corpus += value < 0 ? "" : "+";
+    corpus += std::to_string(value);
+    if (kind(generator))
+    {
+        corpus += '.';
+        corpus += std::to_string(number(generator) & 0xFFF);
+    }
+    corpus += ' ';
+}
+
+std::size_t checksum = 0; /* token checksum of the callback consumers */
+
+void onWord(std::string_view word)
+{
+    checksum += word.size();
+}
+
+void onInt(unsigned long value)
+{
+    checksum += value;
+}
+
+/* Distinct listeners, so that an observable doesn't merge them */
+template<int I> void onWordN(std::string_view word)
+{
+    checksum += word.size();
+}
+
+template<int I> void onIntN(unsigned long value)
+{
+    checksum += value;
+}
+
+/* Handler of the static dispatch parser */
+struct ChecksumHandler
+{
+    std::size_t checksum = 0;
+
+    void onWord(std::string_view word)
+    {
+        checksum += word.size();
+    }
+    void onInt(unsigned long value)
+    {
+        checksum += value;
+    }
+};
+
+/* Count tokens of the corpus */
+std::size_t countTokens(const std::string& corpus)
+{
+    std::size_t count = 0;
+    for (const Token& token : SaxTokens(corpus))
+    {
+        static_cast<void>(token);
+        ++count;
+    }
+    return count;
+}
+
+/* Best time of several runs of a consumer, the consumer result is stored */
+template<typename Consumer>
+double measureSeconds(Consumer consumer, std::size_t& result)
+{
+    double bestSeconds = 0;
+    for (std::size_t i = 0; i < REPEAT_COUNT; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        result = consumer();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!i || seconds < bestSeconds)
+        {
+            bestSeconds = seconds;
+        }
+    }
+    return bestSeconds;
+}
+
+/* Run a consumer over the corpus several times, print and return the best throughput in MB/s */
+template<typename Consumer>
+double measure(const std::string& name, const std::string& corpus, std::size_t tokenCount, Consumer consumer)
+{
+    std::size_t result = 0;
+    double seconds = measureSeconds([&corpus, &consumer]() { return consumer(corpus); }, result);
+    double throughput = corpus.size() / seconds / 1e6;
+    std::cout << std::left << std::setw(24) << name
+              << std::right << std::setw(12) << std::fixed << std::setprecision(1) << throughput
+              << std::setw(14) << tokenCount / seconds / 1e6
+              << std::setw(24) << result << std::endl;
+    return throughput;
+}
+
+/* Print the header of a throughput table */
+void printThroughputHeader(const std::string& title, const std::string& corpus, std::size_t tokenCount)
+{
+    std::cout << std::endl << title << ": " << corpus.size() << " bytes, " << tokenCount << " tokens" << std::endl;
+    std::cout << std::left << std::setw(24) << "consumer" << std::right << std::setw(12) << "MB/s"
+              << std::setw(14) << "Mtokens/s" << std::setw(24) << "checksum" << std::endl;
+}
+
+/* Parse the corpus with SaxParser having listenerCount listeners on words and as many on integers */
+std::size_t parseWithListeners(const std::string& corpus, std::size_t listenerCount)
+{
+    typedef void (*WordListener)(std::string_view);
+    typedef void (*IntListener)(unsigned long);
+    static const WordListener WORD_LISTENERS[] = { onWordN<0>, onWordN<1>, onWordN<2>, onWordN<3>, onWordN<4> };
+    static const IntListener INT_LISTENERS[] = { onIntN<0>, onIntN<1>, onIntN<2>, onIntN<3>, onIntN<4> };
+    SaxParser parser;
+    for (std::size_t i = 0; i < listenerCount; ++i)
+    {
+        parser.addListenerOnWordParsed(WORD_LISTENERS[i]);
+        parser.addListenerOnIntParsed(INT_LISTENERS[i]);
+    }
+    checksum = 0;
+    parser.parse(corpus);
+    return checksum;
+}
+
+/* SaxParser throughput on corpora of different shapes */
+void runCorpusBenchmarks()
+{
+    const struct
+    {
+        const char* name;
+        TokenGenerator generateToken;
+    } corpora[] = {
+        { "word-heavy corpus", generateWordToken },
+        { "number-heavy corpus", generateNumberToken },
+        { "whitespace-run corpus", generateSparseToken },
+        { "UTF-8 corpus", generateUtf8Token },
+    };
+    for (const auto& corpusType : corpora)
+    {
+        const std::string corpus = generateCorpus(corpusType.generateToken);
+        const std::size_t tokenCount = countTokens(corpus);
+        printThroughputHeader(corpusType.name, corpus, tokenCount);
+        for (std::size_t listenerCount : { 0, 1, 5 })
+        {
+            measure("SaxParser, " + std::to_string(listenerCount) + " listeners", corpus, tokenCount,
+                    [listenerCount](const std::string& input)
+            {
+                return parseWithListeners(input, listenerCount);
+            });
+        }
+    }
+}
+
+/* Alternative consumers on the mixed corpus, return false if the pull iterator is slower than the callbacks */
+bool runConsumerBenchmarks()
+{
+    const std::string corpus = generateCorpus(generateMixedToken);
+    const std::size_t tokenCount = countTokens(corpus);
+    printThroughputHeader("mixed corpus", corpus, tokenCount);
+
+    double callbackThroughput = measure("callbacks", corpus, tokenCount, [](const std::string& input)
+    {
+        SaxParser parser;
+        parser.addListenerOnWordParsed(onWord);
+        parser.addListenerOnIntParsed(onInt);
+        checksum = 0;
+        parser.parse(input);
+        return checksum;
+    });
+    measure("async callbacks", corpus, tokenCount, [](const std::string& input)
+    {
+        SaxParser parser;
+        parser.setAsyncDispatch(1);
+        parser.addListenerOnWordParsed(onWord);
+        parser.addListenerOnIntParsed(onInt);
+        checksum = 0;
+        parser.parse(input);
+        return checksum;
+    });
+    measure("static dispatch", corpus, tokenCount, [](const std::string& input)
+    {
+        ChecksumHandler handler;
+        StaticSaxParser<ChecksumHandler> parser(handler);
+        parser.parse(input);
+        return handler.checksum;
+    });
+    double pullThroughput = measure("pull iterator", corpus, tokenCount, [](const std::string& input)
+    {
+        std::size_t sum = 0;
+        for (const Token& token : SaxTokens(input))
+        {
+            sum += token.type == TokenType::WORD ? token.length : token.value;
+        }
+        return sum;
+    });
+    measure("unordered_map count", corpus, tokenCount, [](const std::string& input)
+    {
+        std::unordered_map<std::string, std::size_t> counts;
+        for (const Token& token : SaxTokens(input))
+        {
+            if (token.type == TokenType::WORD)
+            {
+                ++counts[std::string(token.text, token.length)];
+            }
+        }
+        return counts.size();
+    });
+    measure("WordCounter count", corpus, tokenCount, [](const std::string& input)
+    {
+        WordCounter counter;
+        StaticSaxParser<WordCounter> parser(counter);
+        parser.parse(input);
+        return counter.size();
+    });
+    if (pullThroughput < callbackThroughput)
+    {
+        std::cerr << "FAILED: pull iterator is slower than callbacks, " << pullThroughput << " vs "
+                  << callbackThroughput << " MB/s" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void onSignedInt(long value)
+{
+    checksum += value;
+}
+
+void onDecimal(double value)
+{
+    checksum += static_cast<long>(value);
+}
+
+/* Parse the corpus with callbacks on every token type */
+std::size_t parseWithGrammar(const std::string& corpus, bool isExtended)
+{
+    SaxParser parser;
+    parser.setExtendedGrammar(isExtended);
+    parser.addListenerOnWordParsed(onWord);
+    parser.addListenerOnIntParsed(onInt);
+    parser.addListenerOnSignedIntParsed(onSignedInt);
+    parser.addListenerOnDecimalParsed(onDecimal);
+    checksum = 0;
+    parser.parse(corpus);
+    return checksum;
+}
+
+/* Cost of the extended grammar and of UTF-8 validation alone */
+void runGrammarBenchmarks()
+{
+    const std::string utf8Corpus = generateCorpus(generateUtf8Token);
+    const std::size_t utf8TokenCount = countTokens(utf8Corpus);
+    printThroughputHeader("UTF-8 corpus", utf8Corpus, utf8TokenCount);
+    measure("scalar validation", utf8Corpus, utf8TokenCount, [](const std::string& input)
+    {
+        return validateUtf8Scalar(input.data(), input.size());
+    });
+    measure("dispatched validation", utf8Corpus, utf8TokenCount, [](const std::string& input)
+    {
+        return validateUtf8(input.data(), input.size());
+    });
+    for (bool isExtended : { false, true })
+    {
+        measure(isExtended ? "extended grammar" : "basic grammar", utf8Corpus, utf8TokenCount,
+                [isExtended](const std::string& input)
+        {
+            return parseWithGrammar(input, isExtended);
+        });
+    }
+
+    const std::string signedCorpus = generateCorpus(generateSignedToken);
+    std::size_t signedTokenCount = 0;
+    for (char byte : signedCorpus)
+    {
+        signedTokenCount += byte == ' ';
+    }
+    printThroughputHeader("signed and decimal corpus", signedCorpus, signedTokenCount);
+    measure("extended grammar", signedCorpus, signedTokenCount, [](const std::string& input)
+    {
+        return parseWithGrammar(input, true);
+    });
+}
+
+/* Cost of firing an event through Observable with a varying listener count */
+void runDispatchBenchmarks()
+{
+    typedef void (*Listener)(unsigned long);
+    static const Listener LISTENERS[] = {
+        onIntN<0>, onIntN<1>, onIntN<2>, onIntN<3>, onIntN<4>, onIntN<5>, onIntN<6>, onIntN<7>, onIntN<8>, onIntN<9>
+    };
+    std::cout << std::endl << "Observable dispatch, " << EVENT_COUNT << " events" << std::endl;
+    std::cout << std::left << std::setw(24) << "listeners" << std::right << std::setw(16) << "fireEvent ns"
+              << std::setw(16) << "Reader ns" << std::setw(20) << "Reader ns/listener" << std::endl;
+    for (std::size_t listenerCount : { 0, 1, 2, 5, 10 })
+    {
+        Observable<unsigned long> observable;
+        for (std::size_t i = 0; i < listenerCount; ++i)
+        {
+            observable.addListener(LISTENERS[i]);
+        }
+        std::size_t result = 0;
+        double fireSeconds = measureSeconds([&observable]()
+        {
+            checksum = 0;
+            for (std::size_t i = 0; i < EVENT_COUNT; ++i)
+            {
+                observable.fireEvent(i);
+            }
+            return checksum;
+        }, result);
+        double readerSeconds = measureSeconds([&observable]()
+        {
+            checksum = 0;
+            Observable<unsigned long>::Reader reader(observable);
+            for (std::size_t i = 0; i < EVENT_COUNT; ++i)
+            {
+                reader.fireEvent(i);
+            }
+            return checksum;
+        }, result);
+        const double fireNs = fireSeconds / EVENT_COUNT * 1e9;
+        const double readerNs = readerSeconds / EVENT_COUNT * 1e9;
+        std::cout << std::left << std::setw(24) << listenerCount << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(16) << fireNs << std::setw(16) << readerNs;
+        if (listenerCount)
+        {
+            std::cout << std::setw(20) << readerNs / listenerCount;
+        }
+        std::cout << std::endl;
+    }
+}
+
+/* Benchmark suit, return false if a throughput requirement failed */
+bool runBenchmarks()
+{
+    std::cout << "classifier: " << getClassifierName() << std::endl;
+    runCorpusBenchmarks();
+    bool isPassed = runConsumerBenchmarks();
+    runGrammarBenchmarks();
+    runDispatchBenchmarks();
+    return isPassed;
+}
+
+/* Program entry point */
+int main(void) {
+    return runBenchmarks() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
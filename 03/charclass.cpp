@@ -0,0 +1,169 @@
+#include "charclass.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+/* Byte classes of the scalar classifier */
+enum ByteClass : unsigned char
+{
+    LETTER = 0,
+    SPACE = 1,
+    DIGIT = 2,
+    SPACE_LEAD = 3 /* letter that may start a Unicode whitespace character */
+};
+
+/* Lookup table of byte classes */
+struct ByteClassTable
+{
+    unsigned char classes[256];
+
+    ByteClassTable()
+    {
+        for (unsigned int i = 0; i < 256; ++i)
+        {
+            classes[i] = ByteClass::LETTER;
+        }
+        for (unsigned int i = '\t'; i <= '\r'; ++i)
+        {
+            classes[i] = ByteClass::SPACE;
+        }
+        classes[static_cast<unsigned char>(' ')] = ByteClass::SPACE;
+        for (unsigned int i = '0'; i <= '9'; ++i)
+        {
+            classes[i] = ByteClass::DIGIT;
+        }
+        classes[0xC2] = ByteClass::SPACE_LEAD;
+        for (unsigned int i = 0xE1; i <= 0xE3; ++i)
+        {
+            classes[i] = ByteClass::SPACE_LEAD;
+        }
+    }
+};
+
+const ByteClassTable BYTE_CLASSES;
+
+CharClassifier selectClassifier()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return classifyBlockAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return classifyBlockSse42;
+    }
+#endif
+    return classifyBlockScalar;
+}
+
+}
+
+CharMasks classifyTail(const char* data, std::size_t size)
+{
+    CharMasks masks = { 0, 0, 0 };
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        unsigned char byteClass = BYTE_CLASSES.classes[static_cast<unsigned char>(data[i])];
+        masks.space |= static_cast<std::uint64_t>(byteClass == ByteClass::SPACE) << i;
+        masks.digit |= static_cast<std::uint64_t>(byteClass == ByteClass::DIGIT) << i;
+        masks.spaceLead |= static_cast<std::uint64_t>(byteClass == ByteClass::SPACE_LEAD) << i;
+    }
+    return masks;
+}
+
+CharMasks classifyBlockScalar(const char* block)
+{
+    return classifyTail(block, CHAR_BLOCK_SIZE);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * Both vector classifiers use the same range test: byte b is in [lo, lo + n]
+ * iff min_epu8(b - lo, n) == b - lo, with wrapping subtraction.
+ */
+
+__attribute__((target("sse4.2")))
+CharMasks classifyBlockSse42(const char* block)
+{
+    const __m128i spaceChar = _mm_set1_epi8(' ');
+    const __m128i tabChar = _mm_set1_epi8('\t');
+    const __m128i tabRange = _mm_set1_epi8('\r' - '\t');
+    const __m128i zeroChar = _mm_set1_epi8('0');
+    const __m128i digitRange = _mm_set1_epi8(9);
+    const __m128i c2Byte = _mm_set1_epi8(static_cast<char>(0xC2));
+    const __m128i e1Byte = _mm_set1_epi8(static_cast<char>(0xE1));
+    const __m128i leadRange = _mm_set1_epi8(0xE3 - 0xE1);
+    CharMasks masks = { 0, 0, 0 };
+    for (std::size_t i = 0; i < CHAR_BLOCK_SIZE; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        __m128i fromTab = _mm_sub_epi8(bytes, tabChar);
+        __m128i space = _mm_or_si128(_mm_cmpeq_epi8(bytes, spaceChar),
+                                     _mm_cmpeq_epi8(_mm_min_epu8(fromTab, tabRange), fromTab));
+        __m128i fromZero = _mm_sub_epi8(bytes, zeroChar);
+        __m128i digit = _mm_cmpeq_epi8(_mm_min_epu8(fromZero, digitRange), fromZero);
+        masks.space |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(space))) << i;
+        __m128i fromE1 = _mm_sub_epi8(bytes, e1Byte);
+        __m128i spaceLead = _mm_or_si128(_mm_cmpeq_epi8(bytes, c2Byte),
+                                         _mm_cmpeq_epi8(_mm_min_epu8(fromE1, leadRange), fromE1));
+        masks.digit |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(digit))) << i;
+        masks.spaceLead |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(spaceLead))) << i;
+    }
+    return masks;
+}
+
+__attribute__((target("avx2")))
+CharMasks classifyBlockAvx2(const char* block)
+{
+    const __m256i spaceChar = _mm256_set1_epi8(' ');
+    const __m256i tabChar = _mm256_set1_epi8('\t');
+    const __m256i tabRange = _mm256_set1_epi8('\r' - '\t');
+    const __m256i zeroChar = _mm256_set1_epi8('0');
+    const __m256i digitRange = _mm256_set1_epi8(9);
+    const __m256i c2Byte = _mm256_set1_epi8(static_cast<char>(0xC2));
+    const __m256i e1Byte = _mm256_set1_epi8(static_cast<char>(0xE1));
+    const __m256i leadRange = _mm256_set1_epi8(0xE3 - 0xE1);
+    CharMasks masks = { 0, 0, 0 };
+    for (std::size_t i = 0; i < CHAR_BLOCK_SIZE; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        __m256i fromTab = _mm256_sub_epi8(bytes, tabChar);
+        __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, spaceChar),
+                                        _mm256_cmpeq_epi8(_mm256_min_epu8(fromTab, tabRange), fromTab));
+        __m256i fromZero = _mm256_sub_epi8(bytes, zeroChar);
+        __m256i digit = _mm256_cmpeq_epi8(_mm256_min_epu8(fromZero, digitRange), fromZero);
+        masks.space |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(space))) << i;
+        __m256i fromE1 = _mm256_sub_epi8(bytes, e1Byte);
+        __m256i spaceLead = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, c2Byte),
+                                            _mm256_cmpeq_epi8(_mm256_min_epu8(fromE1, leadRange), fromE1));
+        masks.digit |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(digit))) << i;
+        masks.spaceLead |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(spaceLead))) << i;
+    }
+    return masks;
+}
+
+#endif
+
+const CharClassifier classifyBlock = selectClassifier();
+
+const char* getClassifierName()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (classifyBlock == classifyBlockAvx2)
+    {
+        return "avx2";
+    }
+    if (classifyBlock == classifyBlockSse42)
+    {
+        return "sse4.2";
+    }
+#endif
+    return "scalar";
+}
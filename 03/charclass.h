@@ -0,0 +1,44 @@
+#ifndef CHARCLASS_H
+#define CHARCLASS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* Size of a block classified at once */
+const std::size_t CHAR_BLOCK_SIZE = 64;
+
+/**
+ * Character classes of a block of input, bit i describes byte i.
+ * Space and digit follow std::isspace and std::isdigit of the "C" locale,
+ * every other byte is a letter. Space lead bytes (0xC2, 0xE1..0xE3) are letters that may start
+ * a Unicode whitespace character, the extended grammar checks them.
+ */
+struct CharMasks
+{
+    std::uint64_t space;
+    std::uint64_t digit;
+    std::uint64_t spaceLead;
+};
+
+/* Block classifier, reads exactly CHAR_BLOCK_SIZE bytes */
+typedef CharMasks (*CharClassifier)(const char* block);
+
+/* Portable classifier */
+CharMasks classifyBlockScalar(const char* block);
+#if defined(__x86_64__) || defined(__i386__)
+/* SSE4.2 classifier */
+CharMasks classifyBlockSse42(const char* block);
+/* AVX2 classifier */
+CharMasks classifyBlockAvx2(const char* block);
+#endif
+
+/* The fastest classifier supported by the CPU, selected at startup */
+extern const CharClassifier classifyBlock;
+
+/* Name of the selected classifier */
+const char* getClassifierName();
+
+/* Classify a block shorter than CHAR_BLOCK_SIZE, bits past size are zero */
+CharMasks classifyTail(const char* data, std::size_t size);
+
+#endif /* CHARCLASS_H */
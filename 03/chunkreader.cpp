@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chunkreader.h"
+
+namespace
+{
+
+/* Double buffer shared by readChunks() and its reader thread */
+struct ChunkBuffers
+{
+    std::vector<char> buffers[2];  /* chunk i is read into buffers[i % 2] */
+    std::size_t sizes[2];          /* sizes of the chunks in the buffers */
+    std::size_t readCount;         /* count of read chunks, the last one is empty or failed */
+    std::size_t consumedCount;     /* count of consumed chunks, their buffers are free */
+    bool isStopped;                /* the consumer failed, the reader thread must quit */
+    std::exception_ptr error;      /* failure of the reader */
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    explicit ChunkBuffers(std::size_t chunkSize): buffers{ std::vector<char>(chunkSize), std::vector<char>(chunkSize) },
+        sizes{ 0, 0 }, readCount(0), consumedCount(0), isStopped(false)
+    {
+    }
+};
+
+/* Reader thread: fill a free buffer and pass it to the consumer until the end of input */
+void readAhead(const ChunkReader& reader, std::size_t chunkSize, ChunkBuffers& shared)
+{
+    for (std::size_t index = 0; ; ++index)
+    {
+        {
+            std::unique_lock<std::mutex> lock(shared.mutex);
+            shared.condition.wait(lock, [&shared, index]() { return shared.isStopped || index - shared.consumedCount < 2; });
+            if (shared.isStopped)
+            {
+                return;
+            }
+        }
+        std::size_t size = 0;
+        std::exception_ptr error;
+        try
+        {
+            size = reader(shared.buffers[index % 2].data(), chunkSize);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.sizes[index % 2] = size;
+            shared.error = error;
+            ++shared.readCount;
+        }
+        shared.condition.notify_all();
+        if (!size || error)
+        {
+            return;
+        }
+    }
+}
+
+/* Stops and joins the reader thread, also when the consumer throws */
+struct ReaderGuard
+{
+    ChunkBuffers& shared;
+    std::thread thread;
+
+    ~ReaderGuard()
+    {
+        {
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.isStopped = true;
+        }
+        shared.condition.notify_all();
+        thread.join();
+    }
+};
+
+}
+
+void readChunks(const ChunkReader& reader, std::size_t chunkSize, const ChunkConsumer& consumer)
+{
+    /* double buffering: one chunk is consumed while a single reader thread reads the other one */
+    ChunkBuffers shared(chunkSize);
+    ReaderGuard guard{ shared, std::thread(readAhead, std::cref(reader), chunkSize, std::ref(shared)) };
+
+    for (std::size_t index = 0; ; ++index)
+    {
+        std::size_t size;
+        {
+            std::unique_lock<std::mutex> lock(shared.mutex);
+            shared.condition.wait(lock, [&shared, index]() { return shared.readCount > index; });
+            /* the failed read is the last one, the chunks before it are consumed first */
+            if (shared.error && shared.readCount == index + 1)
+            {
+                std::rethrow_exception(shared.error);
+            }
+            size = shared.sizes[index % 2];
+        }
+        if (!size)
+        {
+            return;
+        }
+        consumer(shared.buffers[index % 2].data(), size);
+        {
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            ++shared.consumedCount;
+        }
+        shared.condition.notify_all();
+    }
+}
+
+ChunkReader makeStreamReader(std::istream& input)
+{
+    return [&input](char* buffer, std::size_t size) -> std::size_t
+    {
+        input.read(buffer, size);
+        return input.gcount();
+    };
+}
+
+ChunkReader makeFdReader(int fd)
+{
+    return [fd](char* buffer, std::size_t size) -> std::size_t
+    {
+        /* fill the whole chunk unless EOF is reached, so that small reads from pipes don't fragment the input */
+        std::size_t filled = 0;
+        while (filled < size)
+        {
+            ssize_t count = read(fd, buffer + filled, size - filled);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "SaxParser input read failed");
+            }
+            if (!count)
+            {
+                break;
+            }
+            filled += count;
+        }
+        return filled;
+    };
+}
+
+namespace
+{
+
+/* Owner of a file descriptor */
+struct FileGuard
+{
+    int fd;
+
+    ~FileGuard()
+    {
+        close(fd);
+    }
+};
+
+/* Owner of a read-only file mapping */
+struct MappingGuard
+{
+    void* data;
+    std::size_t size;
+
+    ~MappingGuard()
+    {
+        munmap(data, size);
+    }
+};
+
+}
+
+void readFile(const std::string& path, std::size_t windowSize, const ChunkConsumer& consumer)
+{
+    int fd;
+    do
+    {
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "SaxParser input open failed: " + path);
+    }
+    FileGuard file{ fd };
+    struct stat status;
+    if (fstat(fd, &status))
+    {
+        throw std::system_error(errno, std::generic_category(), "SaxParser input stat failed: " + path);
+    }
+    if (!S_ISREG(status.st_mode))
+    {
+        readChunks(makeFdReader(fd), windowSize, consumer);
+        return;
+    }
+    const std::size_t size = status.st_size;
+    if (!size)
+    {
+        /* zero length mappings are not allowed */
+        return;
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        throw std::system_error(errno, std::generic_category(), "SaxParser input mapping failed: " + path);
+    }
+    MappingGuard mapping{ data, size };
+    /* hints only, a kernel may not support them for files */
+    madvise(data, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(data, size, MADV_HUGEPAGE);
+#endif
+
+    /* windows start at page boundaries, so that their pages can be dropped */
+    const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    windowSize = std::max(pageSize, windowSize / pageSize * pageSize);
+    const char* bytes = static_cast<const char*>(data);
+    for (std::size_t offset = 0; offset < size; offset += windowSize)
+    {
+        const std::size_t length = std::min(windowSize, size - offset);
+        consumer(bytes + offset, length);
+        /* clean pages of a read-only mapping are reloaded from the file if touched again */
+        madvise(const_cast<char*>(bytes) + offset, length, MADV_DONTNEED);
+    }
+}
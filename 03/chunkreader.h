@@ -0,0 +1,47 @@
+#ifndef CHUNKREADER_H
+#define CHUNKREADER_H
+
+#include <functional>
+#include <istream>
+#include <string>
+
+/**
+ * Source of input chunks for streaming parsing.
+ * Fills the buffer with at most size bytes and returns the number of bytes written,
+ * zero means end of input.
+ */
+typedef std::function<std::size_t(char* buffer, std::size_t size)> ChunkReader;
+
+/* Consumer of input chunks, the chunk is valid only during the call */
+typedef std::function<void(const char* data, std::size_t size)> ChunkConsumer;
+
+/* Default size of a chunk read from a stream */
+const std::size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+/* Default size of a window of a memory-mapped file */
+const std::size_t DEFAULT_MAP_WINDOW_SIZE = 64 << 20;
+
+/**
+ * Pass input to the consumer chunk by chunk until the reader is exhausted.
+ * Memory consumption is two chunk buffers: next chunk is read on a reader thread
+ * while the current one is consumed. The reader thread lives for the whole call, the buffers are
+ * handed over under a mutex. Exceptions of the reader are rethrown after the chunks before the failure.
+ */
+void readChunks(const ChunkReader& reader, std::size_t chunkSize, const ChunkConsumer& consumer);
+
+/**
+ * Pass file contents to the consumer window by window.
+ * A regular file is memory-mapped with sequential access and huge page hints and windows point
+ * straight into the mapping, so no input byte is copied. Pages of a consumed window are dropped,
+ * so resident memory stays about one window however large the file is.
+ * Other files (pipes, devices) are read with readChunks() in chunks of windowSize.
+ * The file must not be truncated while it is read. Throws std::system_error if it can't be opened or mapped.
+ */
+void readFile(const std::string& path, std::size_t windowSize, const ChunkConsumer& consumer);
+
+/* Reader of an input stream */
+ChunkReader makeStreamReader(std::istream& input);
+
+/* Reader of a file descriptor, reads until EOF */
+ChunkReader makeFdReader(int fd);
+
+#endif /* CHUNKREADER_H */
@@ -0,0 +1,300 @@
+#ifndef EXTENDEDTOKENIZER_H
+#define EXTENDEDTOKENIZER_H
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "charclass.h"
+#include "numparse.h"
+#include "parsererror.h"
+#include "utf8.h"
+
+/**
+ * Incremental tokenizer of the extended grammar.
+ *
+ * Tokens are separated by ASCII whitespace and by Unicode whitespace characters (see getUnicodeSpaceLength).
+ * A token starting with a digit, or with a sign followed by a digit, is a number:
+ *     unsigned integer  [0-9]+                             fits unsigned long
+ *     signed integer    [+-][0-9]+                         fits long
+ *     decimal           [+-]?[0-9]+ then '.' or exponent   std::from_chars grammar, fits double
+ * Any other token is a word, it may contain any UTF-8 characters except ASCII digits.
+ * Input must be valid UTF-8: it is validated chunk by chunk before tokenizing (see utf8.h),
+ * the first invalid sequence is reported as INVALID_UTF8 after all tokens preceding it.
+ * Handler must provide the methods of a Tokenizer handler and
+ *     void onSignedInt(long value, std::size_t offset, std::size_t length);
+ *     void onDecimal(double value, std::size_t offset, std::size_t length);
+ * Word views follow the rules of Tokenizer.
+ */
+template<typename Handler> class ExtendedTokenizer
+{
+private:
+    Handler& m_handler;               /* token consumer */
+    Utf8StreamValidator m_validator;  /* validator of the input fed so far */
+    bool m_isInRun;                   /* a run of non-space bytes is being read */
+    bool m_runHasDigit;               /* the run contains a digit */
+    bool m_runHasSpaceLead;           /* the run contains a byte that may start Unicode whitespace */
+    std::string m_carry;              /* beginning of the run split by a chunk boundary */
+    std::size_t m_position;           /* offset of the current chunk from the beginning of input */
+    std::size_t m_runOffset;          /* offset of the run being read from the beginning of input */
+
+    static bool isDigit(char byte)
+    {
+        return static_cast<unsigned char>(byte - '0') < 10;
+    }
+    /* Check if the byte may start a Unicode whitespace character */
+    static bool isUnicodeSpaceLead(char byte)
+    {
+        const unsigned char value = byte;
+        return value == 0xC2 || (value >= 0xE1 && value <= 0xE3);
+    }
+    /* Note classes of the run bytes from index from to index to of a classified block */
+    void noteRun(const CharMasks& masks, std::size_t from, std::size_t to)
+    {
+        const std::uint64_t range = (to == CHAR_BLOCK_SIZE ? ~0ULL : (1ULL << to) - 1) & (~0ULL << from);
+        m_runHasDigit |= (masks.digit & range) != 0;
+        m_runHasSpaceLead |= (masks.spaceLead & range) != 0;
+    }
+    /* Tokenize a chunk of valid input */
+    void scan(const char* data, std::size_t size, bool isLast);
+    /* Split the current run of non-space bytes at Unicode whitespace and fire its tokens */
+    void fireRun(std::string_view run, std::size_t offset);
+    /* Fire a token which contains no whitespace, a token without digits is a word */
+    void fireToken(std::string_view token, std::size_t offset, bool hasDigit);
+    /* Fire a number token starting at a digit or a sign */
+    void fireNumber(std::string_view token, std::size_t offset);
+    /* Fire the run which starts at runStartIdx of the chunk, or in the carry-over buffer */
+    void fireRunEndingAt(const char* data, std::size_t runStartIdx, std::size_t runEndIdx)
+    {
+        if (m_carry.empty())
+        {
+            fireRun(std::string_view(data + runStartIdx, runEndIdx - runStartIdx), m_runOffset);
+        }
+        else
+        {
+            m_carry.append(data + runStartIdx, runEndIdx - runStartIdx);
+            fireRun(m_carry, m_runOffset);
+            m_carry.clear();
+        }
+    }
+public:
+    explicit ExtendedTokenizer(Handler& handler, std::size_t position = 0): m_handler(handler), m_validator(position),
+        m_isInRun(false), m_runHasDigit(false), m_runHasSpaceLead(false), m_position(position), m_runOffset(0)
+    {
+    }
+    /** Offset of the next chunk from the beginning of input */
+    std::size_t getPosition() const
+    {
+        return m_position;
+    }
+    /**
+     * Validate and parse next chunk of input.
+     * If the chunk is known to be the last one, the trailing token is fired without copying.
+     */
+    void feed(const char* data, std::size_t size, bool isLast = false)
+    {
+        const std::size_t invalid = m_validator.feed(data, size, isLast);
+        if (invalid != Utf8StreamValidator::VALID)
+        {
+            /* tokens preceding the invalid sequence are fired, the one containing it is not */
+            scan(data, invalid > m_position ? invalid - m_position : 0, false);
+            throw ParserException(ParserErrorCode::INVALID_UTF8, invalid);
+        }
+        scan(data, size, isLast);
+    }
+    /** Flush the token that lasts until the end of input */
+    void finish()
+    {
+        const std::size_t invalid = m_validator.feed("", 0, true);
+        if (invalid != Utf8StreamValidator::VALID)
+        {
+            throw ParserException(ParserErrorCode::INVALID_UTF8, invalid);
+        }
+        if (m_isInRun)
+        {
+            fireRun(m_carry, m_runOffset);
+            m_carry.clear();
+            m_isInRun = false;
+        }
+    }
+};
+
+template<typename Handler>
+void ExtendedTokenizer<Handler>::scan(const char* data, std::size_t size, bool isLast)
+{
+    std::size_t runStartIdx = 0; /* a run continued from the previous chunk starts here */
+    for (std::size_t blockStart = 0; blockStart < size; blockStart += CHAR_BLOCK_SIZE)
+    {
+        const std::size_t blockSize = std::min(CHAR_BLOCK_SIZE, size - blockStart);
+        const CharMasks masks = blockSize == CHAR_BLOCK_SIZE
+            ? classifyBlock(data + blockStart)
+            : classifyTail(data + blockStart, blockSize);
+        const std::uint64_t valid = blockSize == CHAR_BLOCK_SIZE ? ~0ULL : (1ULL << blockSize) - 1;
+
+        /*
+         * Only ASCII whitespace is found with the masks, runs are split at Unicode whitespace later.
+         * Digits and space leads of a run are noted, so that most runs are fired without a byte loop.
+         */
+        std::size_t runFrom = 0; /* first byte of the run in the block */
+        std::size_t i = 0;
+        while (i < blockSize)
+        {
+            const std::uint64_t ahead = valid & (~0ULL << i);
+            const std::uint64_t boundary = (m_isInRun ? masks.space : ~masks.space) & ahead;
+            if (!boundary)
+            {
+                break;
+            }
+            i = __builtin_ctzll(boundary);
+            if (m_isInRun)
+            {
+                noteRun(masks, runFrom, i);
+                fireRunEndingAt(data, runStartIdx, blockStart + i);
+                m_isInRun = false;
+            }
+            else
+            {
+                runStartIdx = blockStart + i;
+                runFrom = i;
+                m_runOffset = m_position + runStartIdx;
+                m_runHasDigit = m_runHasSpaceLead = false;
+                m_isInRun = true;
+            }
+        }
+        if (m_isInRun)
+        {
+            noteRun(masks, runFrom, blockSize);
+        }
+    }
+    m_position += size;
+    if (m_isInRun)
+    {
+        if (isLast)
+        {
+            fireRunEndingAt(data, runStartIdx, size);
+            m_isInRun = false;
+        }
+        else
+        {
+            m_carry.append(data + runStartIdx, size - runStartIdx);
+        }
+    }
+}
+
+template<typename Handler>
+void ExtendedTokenizer<Handler>::fireRun(std::string_view run, std::size_t offset)
+{
+    if (!m_runHasSpaceLead)
+    {
+        fireToken(run, offset, m_runHasDigit);
+        return;
+    }
+    std::size_t tokenStart = 0;
+    for (std::size_t i = 0; i < run.size(); ++i)
+    {
+        if (isUnicodeSpaceLead(run[i]))
+        {
+            const std::size_t spaceLength = getUnicodeSpaceLength(run.data() + i, run.size() - i);
+            if (spaceLength)
+            {
+                if (i != tokenStart)
+                {
+                    fireToken(run.substr(tokenStart, i - tokenStart), offset + tokenStart, m_runHasDigit);
+                }
+                i += spaceLength - 1;
+                tokenStart = i + 1;
+            }
+        }
+    }
+    if (tokenStart != run.size())
+    {
+        fireToken(run.substr(tokenStart), offset + tokenStart, m_runHasDigit);
+    }
+}
+
+template<typename Handler>
+void ExtendedTokenizer<Handler>::fireToken(std::string_view token, std::size_t offset, bool hasDigit)
+{
+    if (!hasDigit)
+    {
+        m_handler.onWord(token, offset);
+        return;
+    }
+    if (isDigit(token[0]) || ((token[0] == '-' || token[0] == '+') && token.size() > 1 && isDigit(token[1])))
+    {
+        fireNumber(token, offset);
+        return;
+    }
+    for (std::size_t i = 1; i < token.size(); ++i)
+    {
+        if (isDigit(token[i]))
+        {
+            throw ParserException(ParserErrorCode::TOKENS_NOT_SEPARATED, offset + i);
+        }
+    }
+    m_handler.onWord(token, offset);
+}
+
+template<typename Handler>
+void ExtendedTokenizer<Handler>::fireNumber(std::string_view token, std::size_t offset)
+{
+    const bool hasSign = !isDigit(token[0]);
+    std::size_t digitsEnd = hasSign;
+    while (digitsEnd < token.size() && isDigit(token[digitsEnd]))
+    {
+        ++digitsEnd;
+    }
+    if (digitsEnd < token.size() && (token[digitsEnd] == '.' || token[digitsEnd] == 'e' || token[digitsEnd] == 'E'))
+    {
+        /* std::from_chars is exact and uses the Eisel-Lemire fast path, it doesn't accept a plus sign */
+        const char* begin = token.data() + (token[0] == '+');
+        double value;
+        const std::from_chars_result result = std::from_chars(begin, token.data() + token.size(), value);
+        if (result.ec == std::errc::result_out_of_range)
+        {
+            throw ParserException(ParserErrorCode::INPUT_OVERFLOW, offset);
+        }
+        if (result.ptr != token.data() + token.size())
+        {
+            throw ParserException(ParserErrorCode::TOKENS_NOT_SEPARATED, offset + (result.ptr - token.data()));
+        }
+        m_handler.onDecimal(value, offset, token.size());
+        return;
+    }
+    if (!hasSign)
+    {
+        unsigned long value = 0;
+        appendDigits(value, token.data(), digitsEnd, offset);
+        if (digitsEnd < token.size())
+        {
+            throw ParserException(ParserErrorCode::TOKENS_NOT_SEPARATED, offset + digitsEnd);
+        }
+        m_handler.onInt(value, offset, token.size());
+        return;
+    }
+    const bool isNegative = token[0] == '-';
+    const unsigned long limit = isNegative ? static_cast<unsigned long>(LONG_MAX) + 1 : LONG_MAX;
+    unsigned long magnitude = 0;
+    for (std::size_t i = 1; i < digitsEnd; ++i)
+    {
+        const unsigned long digit = token[i] - '0';
+        if (magnitude > (limit - digit) / 10)
+        {
+            throw ParserException(ParserErrorCode::INPUT_OVERFLOW, offset + i);
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+    if (digitsEnd < token.size())
+    {
+        throw ParserException(ParserErrorCode::TOKENS_NOT_SEPARATED, offset + digitsEnd);
+    }
+    /* the magnitude of LONG_MIN is not a long, negate in unsigned arithmetic */
+    const long value = isNegative ? static_cast<long>(0UL - magnitude) : static_cast<long>(magnitude);
+    m_handler.onSignedInt(value, offset, token.size());
+}
+
+#endif /* EXTENDEDTOKENIZER_H */
@@ -0,0 +1,108 @@
+#ifndef NUMPARSE_H
+#define NUMPARSE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "parsererror.h"
+
+/*
+ * SWAR (SIMD within a register) decimal digit conversion.
+ * Eight ASCII digits are loaded into one 64-bit word and combined pairwise in three
+ * multiply-shift steps: 8 x 1 digit -> 4 x 2 digits -> 2 x 4 digits -> 1 x 8 digits.
+ * Byte order is little-endian, the first digit ends up in the lowest byte;
+ * big-endian targets use a plain loop.
+ */
+
+/* Number of digits converted in one SWAR step */
+const std::size_t SWAR_DIGIT_COUNT = 8;
+
+/* Powers of ten up to 10^8 */
+const std::uint32_t POWERS_OF_TEN[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+/* Convert exactly eight ASCII digits */
+inline std::uint32_t parseEightDigits(const char* digits)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::uint32_t result = 0;
+    for (std::size_t i = 0; i < SWAR_DIGIT_COUNT; ++i)
+    {
+        result = result * 10 + (digits[i] - '0');
+    }
+    return result;
+#else
+    std::uint64_t value;
+    std::memcpy(&value, digits, sizeof(value));
+    value -= 0x3030303030303030ULL;
+    value = (value * 10 + (value >> 8)) & 0x00FF00FF00FF00FFULL;
+    value = (value * 100 + (value >> 16)) & 0x0000FFFF0000FFFFULL;
+    value = (value * 10000 + (value >> 32)) & 0x00000000FFFFFFFFULL;
+    return static_cast<std::uint32_t>(value);
+#endif
+}
+
+/* Convert up to eight ASCII digits without reading past them */
+inline std::uint32_t parseDigits(const char* digits, std::size_t count)
+{
+    /* left-pad with zeros, a leading zero doesn't change the value */
+    char padded[SWAR_DIGIT_COUNT];
+    std::memset(padded, '0', SWAR_DIGIT_COUNT);
+    std::memcpy(padded + SWAR_DIGIT_COUNT - count, digits, count);
+    return parseEightDigits(padded);
+}
+
+/**
+ * Append digits to an integer, digits start at given input offset.
+ * Throws INPUT_OVERFLOW at the offset of the first digit that doesn't fit into unsigned long.
+ */
+inline void appendDigits(unsigned long& value, const char* digits, std::size_t count, std::size_t offset)
+{
+    /*
+     * Below this value eight more digits never overflow:
+     * (10^11 - 1) * 10^8 + 99999999 < 10^19 < 2^64.
+     * Above it fall back to the exact digit by digit check, so overflow is raised at the same digit.
+     */
+    const unsigned long swarLimit = 100000000000UL;
+    std::size_t i = 0;
+    while (i < count && value < swarLimit)
+    {
+        std::size_t stepCount = std::min(count - i, SWAR_DIGIT_COUNT);
+        std::uint32_t stepValue = stepCount == SWAR_DIGIT_COUNT
+            ? parseEightDigits(digits + i)
+            : parseDigits(digits + i, stepCount);
+        value = value * POWERS_OF_TEN[stepCount] + stepValue;
+        i += stepCount;
+    }
+    for (; i < count; ++i)
+    {
+        unsigned int digit = digits[i] - '0';
+        if (value < (std::numeric_limits<unsigned long>::max() - 9) / 10)
+        {
+            value = 10 * value + digit;
+        }
+        else
+        {
+            if (value <= std::numeric_limits<unsigned long>::max() / 10)
+            {
+                value *= 10;
+                if (value <= std::numeric_limits<unsigned long>::max() - digit)
+                {
+                    value += digit;
+                }
+                else
+                {
+                    throw ParserException(ParserErrorCode::INPUT_OVERFLOW, offset + i);
+                }
+            }
+            else
+            {
+                throw ParserException(ParserErrorCode::INPUT_OVERFLOW, offset + i);
+            }
+        }
+    }
+}
+
+#endif /* NUMPARSE_H */
@@ -1,54 +1,387 @@
 #ifndef OBSERVABLE_H
 #define OBSERVABLE_H
 
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
-/** 
+/**
  * A simple observable template.
- * 
+ *
  * It is as simple as possible:
  * issues arising with observers deleted before observable are omitted.
  * no possibility of setting listener priority.
+ *
+ * Listeners may be added and removed from any thread while events are fired.
+ * The listener list is a copy-on-write snapshot (RCU style): fireEvent takes the current
+ * snapshot without locks or allocations, writers publish a new snapshot under a mutex.
+ * Removal only marks the listener entry, the snapshot is compacted when marked entries
+ * outnumber live ones, so removal by handle is O(1) amortized.
+ * A fireEvent running concurrently with removal may still call the removed listener once.
+ * Every reader announces the snapshot it uses in a reader slot (a hazard pointer), old snapshots
+ * not announced in any slot are freed by a writer or by a reader switching snapshots, so readers
+ * that are always in progress, like pinned Readers on consumer threads, don't hold all of them back.
+ *
+ * Observable is not copyable, the snapshots and the writer lock are owned by one instance.
+ * Classes holding observables, like SaxParser, are not copyable either.
  */
 template<typename ...A> class Observable
 {
     typedef void(*EventListener)(A...);  /* Listener callback type */
 private:
-    std::unordered_set<EventListener> m_listeners; /* Collection of listeners */
-    std::vector<EventListener> m_listenerQueue;    /* Call queue of listeners */
+    /* Registered listener */
+    struct Entry
+    {
+        const EventListener listener;
+        const std::size_t id;        /* registration number */
+        std::atomic<bool> isRemoved;
+
+        Entry(EventListener listener, std::size_t id): listener(listener), id(id), isRemoved(false)
+        {
+        }
+    };
+    /* Immutable call queue of listeners */
+    typedef std::vector<Entry*> Snapshot;
+    /* Announcement of the snapshot used by a reader */
+    struct ReaderSlot
+    {
+        std::atomic<const Snapshot*> snapshot; /* used snapshot, null if none */
+        std::atomic<bool> isTaken;             /* the slot belongs to a reader */
+        ReaderSlot* next;                      /* next slot in the list, immutable once published */
+
+        ReaderSlot(): snapshot(nullptr), isTaken(true), next(nullptr)
+        {
+        }
+    };
+    /* Replaced snapshot and the number of entries removed with it */
+    struct Retired
+    {
+        Snapshot* snapshot; /* null once freed */
+        std::size_t entryCount;
+    };
+public:
+    /* Handle of a registered listener */
+    typedef const Entry* ListenerHandle;
+private:
+    std::atomic<Snapshot*> m_snapshot;                  /* Call queue of listeners */
+    std::atomic<ReaderSlot*> m_slots;                  /* Reader slots, only ever grows */
+    std::atomic<std::size_t> m_liveCount;              /* Number of listeners not removed */
+    std::mutex m_mutex;                                /* Writer lock, guards the fields below */
+    std::unordered_map<EventListener, Entry*> m_listeners; /* Collection of listeners */
+    std::size_t m_removedCount;                        /* Removed entries left in the snapshot */
+    std::size_t m_nextId;                              /* Registration number of the next entry */
+    std::vector<Retired> m_retiredSnapshots;           /* Replaced snapshots waiting for readers, oldest first */
+    std::vector<Entry*> m_retiredEntries;              /* Removed entries waiting for readers, in order of the snapshots */
+    std::vector<const Snapshot*> m_hazards;            /* Snapshots announced in the slots, scratch space of reclaim */
+    std::atomic<bool> m_hasRetired;                    /* Retired snapshots or entries are waiting */
+
+    /* Take a free reader slot or add a new one */
+    ReaderSlot* acquireSlot()
+    {
+        for (ReaderSlot* slot = m_slots.load(); slot; slot = slot->next)
+        {
+            if (!slot->isTaken.load(std::memory_order_relaxed) && !slot->isTaken.exchange(true, std::memory_order_acquire))
+            {
+                return slot;
+            }
+        }
+        ReaderSlot* slot = new ReaderSlot();
+        ReaderSlot* head = m_slots.load();
+        do
+        {
+            slot->next = head;
+        }
+        while (!m_slots.compare_exchange_weak(head, slot));
+        return slot;
+    }
+    /*
+     * Announce the current snapshot in the slot and return it. The snapshot is safe to use once it is still
+     * current after the announcement: a writer replaces it before scanning the slots, so the scan sees it.
+     */
+    const Snapshot* protect(ReaderSlot* slot)
+    {
+        const Snapshot* snapshot = m_snapshot.load();
+        for (;;)
+        {
+            slot->snapshot.store(snapshot);
+            const Snapshot* current = m_snapshot.load();
+            if (current == snapshot)
+            {
+                return snapshot;
+            }
+            snapshot = current;
+        }
+    }
+    /*
+     * Free what the reader no longer uses. Readers switching snapshots free the retired ones, so they don't
+     * pile up behind long-lived readers until the next writer call. A writer holding the lock frees them itself.
+     */
+    void collect()
+    {
+        if (m_hasRetired.load())
+        {
+            std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+            if (lock.owns_lock())
+            {
+                reclaim();
+            }
+        }
+    }
+    /* Withdraw the announcement and return the slot */
+    void releaseSlot(ReaderSlot* slot)
+    {
+        /* a late withdrawal only delays freeing, it needs no ordering with the writer's scan */
+        slot->snapshot.store(nullptr, std::memory_order_release);
+        slot->isTaken.store(false, std::memory_order_release);
+        collect();
+    }
+
+    /* Reader slot that survives a throwing listener */
+    struct ReadGuard
+    {
+        Observable& observable;
+        ReaderSlot* const slot;
+
+        explicit ReadGuard(Observable& observable): observable(observable), slot(observable.acquireSlot())
+        {
+        }
+        ~ReadGuard()
+        {
+            observable.releaseSlot(slot);
+        }
+    };
+
+    /* Publish a copy of the snapshot without removed entries and optionally with a new one; the writer lock must be held */
+    void publish(Entry* added)
+    {
+        Snapshot* current = m_snapshot.load();
+        const std::size_t entryStart = m_retiredEntries.size();
+        Snapshot* next = new Snapshot();
+        next->reserve(current->size() - m_removedCount + 1);
+        for (Entry* entry : *current)
+        {
+            if (entry->isRemoved.load(std::memory_order_relaxed))
+            {
+                m_retiredEntries.push_back(entry);
+            }
+            else
+            {
+                next->push_back(entry);
+            }
+        }
+        if (added)
+        {
+            next->push_back(added);
+        }
+        m_snapshot.store(next);
+        m_retiredSnapshots.push_back({ current, m_retiredEntries.size() - entryStart });
+        m_hasRetired.store(true);
+        m_removedCount = 0;
+        reclaim();
+    }
+    /*
+     * Free the retired snapshots not announced in any reader slot; the writer lock must be held.
+     * The slots are scanned after the snapshots were replaced, so a reader announcing one later fails
+     * its check and moves on to the current snapshot.
+     * A removed entry is still reachable from older snapshots, so it is freed once the snapshot it was
+     * removed with and all older ones are freed.
+     */
+    void reclaim()
+    {
+        m_hazards.clear();
+        for (ReaderSlot* slot = m_slots.load(); slot; slot = slot->next)
+        {
+            if (const Snapshot* snapshot = slot->snapshot.load())
+            {
+                m_hazards.push_back(snapshot);
+            }
+        }
+        std::size_t keptCount = 0;
+        std::size_t keptEntryCount = 0;
+        std::size_t entryIndex = 0;
+        bool isOlderFreed = true;
+        for (const Retired& retired : m_retiredSnapshots)
+        {
+            Snapshot* snapshot = retired.snapshot;
+            if (snapshot && std::find(m_hazards.begin(), m_hazards.end(), snapshot) == m_hazards.end())
+            {
+                delete snapshot;
+                snapshot = nullptr;
+            }
+            isOlderFreed = isOlderFreed && !snapshot;
+            if (isOlderFreed)
+            {
+                for (std::size_t i = 0; i < retired.entryCount; ++i)
+                {
+                    delete m_retiredEntries[entryIndex + i];
+                }
+            }
+            else
+            {
+                std::copy(m_retiredEntries.begin() + entryIndex, m_retiredEntries.begin() + entryIndex + retired.entryCount,
+                          m_retiredEntries.begin() + keptEntryCount);
+                keptEntryCount += retired.entryCount;
+                m_retiredSnapshots[keptCount++] = { snapshot, retired.entryCount };
+            }
+            entryIndex += retired.entryCount;
+        }
+        m_retiredSnapshots.resize(keptCount);
+        m_retiredEntries.resize(keptEntryCount);
+        m_hasRetired.store(keptCount != 0);
+    }
+    /* Mark entry removed, compact the snapshot if removed entries prevail; the writer lock must be held */
+    void removeEntry(Entry* entry)
+    {
+        if (!entry || entry->isRemoved.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        entry->isRemoved.store(true);
+        m_listeners.erase(entry->listener);
+        m_liveCount.fetch_sub(1);
+        if (++m_removedCount > m_liveCount.load())
+        {
+            publish(nullptr);
+        }
+    }
 public:
-    /** Add event listener callback */
-    void addListener(EventListener listener)
+    Observable(): m_snapshot(new Snapshot()), m_slots(nullptr), m_liveCount(0), m_removedCount(0),
+        m_nextId(0), m_hasRetired(false)
     {
-        if (m_listeners.insert(listener).second)
+    }
+    Observable(const Observable&) = delete;
+    Observable& operator=(const Observable&) = delete;
+    ~Observable()
+    {
+        Snapshot* snapshot = m_snapshot.load();
+        for (Entry* entry : *snapshot)
+        {
+            delete entry;
+        }
+        delete snapshot;
+        for (const Retired& retired : m_retiredSnapshots)
+        {
+            delete retired.snapshot;
+        }
+        for (Entry* entry : m_retiredEntries)
         {
-            m_listenerQueue.push_back(listener);
+            delete entry;
+        }
+        for (ReaderSlot* slot = m_slots.load(); slot;)
+        {
+            ReaderSlot* next = slot->next;
+            delete slot;
+            slot = next;
         }
     }
+    /** Add event listener callback, adding a registered listener returns its handle */
+    ListenerHandle addListener(EventListener listener)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_listeners.find(listener);
+        if (it != m_listeners.end())
+        {
+            return it->second;
+        }
+        Entry* entry = new Entry(listener, m_nextId++);
+        m_listeners.emplace(listener, entry);
+        publish(entry);
+        m_liveCount.fetch_add(1);
+        return entry;
+    }
+    /** Remove event listener callback by its handle, the handle is invalid afterwards */
+    void removeListener(ListenerHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        removeEntry(const_cast<Entry*>(handle));
+    }
     /** Remove event listener callback */
     void removeListener(EventListener listener)
     {
-        std::size_t listenerCount = m_listeners.size();
-        m_listeners.erase(listener);
-        if (listenerCount != m_listeners.size())
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_listeners.find(listener);
+        if (it != m_listeners.end())
+        {
+            removeEntry(it->second);
+        }
+    }
+    /** Check if there is any listener */
+    bool hasListeners() const
+    {
+        return m_liveCount.load() != 0;
+    }
+    /** Get the number of retired snapshots and entries not freed yet */
+    std::size_t getRetiredCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_retiredSnapshots.size() + m_retiredEntries.size();
+    }
+    /**
+     * Pinned listener snapshot for firing many events in a row.
+     * Takes a reader slot once instead of on every event and re-reads the snapshot
+     * every refreshPeriod events, so added listeners are picked up with that delay
+     * and the replaced snapshots can be freed.
+     * Removed listeners stop being called immediately.
+     * A reader may serve only a part of listeners: with partCount readers on different threads
+     * every listener is called by exactly one of them, chosen by its registration number.
+     */
+    class Reader
+    {
+    private:
+        Observable& m_observable;      /* Source of snapshots */
+        ReaderSlot* const m_slot;      /* Announcement of the pinned call queue */
+        const Snapshot* m_snapshot;    /* Pinned call queue */
+        const std::size_t m_refreshPeriod; /* Events between snapshot re-reads */
+        std::size_t m_countdown;       /* Events left until the next re-read */
+        const std::size_t m_partIndex; /* Served part of listeners */
+        const std::size_t m_partCount;
+    public:
+        explicit Reader(Observable& observable, std::size_t refreshPeriod = 1024, std::size_t partIndex = 0,
+                        std::size_t partCount = 1):
+            m_observable(observable), m_slot(observable.acquireSlot()), m_snapshot(observable.protect(m_slot)),
+            m_refreshPeriod(refreshPeriod), m_countdown(refreshPeriod), m_partIndex(partIndex), m_partCount(partCount)
+        {
+        }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        ~Reader()
+        {
+            m_observable.releaseSlot(m_slot);
+        }
+        /** Fire event, call all listeners in order of their registration */
+        void fireEvent(A... args)
         {
-            for(auto it = m_listenerQueue.begin(); it != m_listenerQueue.end(); ++it)
+            if (!--m_countdown)
             {
-                if(*it == listener)
+                /* the previous snapshot is no longer announced, free it unless another reader uses it */
+                m_snapshot = m_observable.protect(m_slot);
+                m_observable.collect();
+                m_countdown = m_refreshPeriod;
+            }
+            for (auto it = m_snapshot->begin(); it != m_snapshot->end(); ++it)
+            {
+                if (!(*it)->isRemoved.load(std::memory_order_relaxed)
+                    && (m_partCount == 1 || (*it)->id % m_partCount == m_partIndex))
                 {
-                    m_listenerQueue.erase(it);
-                    break;
+                    (*it)->listener(args...);
                 }
             }
         }
-    }
+    };
+
     /** Fire event, call all listeners in order of their registration */
     void fireEvent(A... args)
     {
-        for (auto it = m_listenerQueue.begin(); it != m_listenerQueue.end(); ++it)
+        ReadGuard guard(*this);
+        const Snapshot* snapshot = protect(guard.slot);
+        for (auto it = snapshot->begin(); it != snapshot->end(); ++it)
         {
-            (*it)(args...);
+            if (!(*it)->isRemoved.load(std::memory_order_relaxed))
+            {
+                (*it)->listener(args...);
+            }
         }
     }
 };
@@ -0,0 +1,27 @@
+#ifndef PARSERERROR_H
+#define PARSERERROR_H
+
+#include <cstddef>
+#include <exception>
+
+/* Possible error codes of the parser */
+enum ParserErrorCode {
+    INPUT_OVERFLOW = 0,       /* Read number is beyond domain of its type (unsigned long, long or double) */
+    TOKENS_NOT_SEPARATED = 1, /* Unseparated word and number encountered */
+    INVALID_UTF8 = 2          /* Malformed UTF-8 sequence encountered, extended grammar only */
+};
+
+/* Object wrapper over ParserErrorCode */
+struct ParserException : public std::exception {
+    const ParserErrorCode errorCode;
+    const std::size_t offset; /* position of the offending byte from the beginning of input */
+
+    ParserException(ParserErrorCode errorCode, std::size_t offset = 0): errorCode(errorCode), offset(offset) { }
+
+    const char* what() const noexcept override
+    {
+        return "Parser exception";
+    }
+};
+
+#endif /* PARSERERROR_H */
@@ -1,97 +1,627 @@
-#include <limits>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+#include "extendedtokenizer.h"
 #include "saxparser.h"
+#include "spscqueue.h"
+#include "tokenizer.h"
 
-void SaxParser::parse(const std::string& input) {
-    /* parser state */
-    enum CharType
+struct SaxParser::BatchDispatcher
+{
+    SaxParser& parser;
+
+    void operator()(const Token* tokens, std::size_t count)
+    {
+        parser.m_onTokensParsed.fireEvent(tokens, count);
+        parser.m_onTokensParsedUnordered.fireEvent(tokens, count);
+    }
+};
+
+struct SaxParser::EventDispatcher
+{
+    TokenBatcher<BatchDispatcher>* batcher; /* nullptr if nobody listens to batches */
+    /* per-token events are fired through pinned snapshots, see Observable::Reader */
+    Observable<std::string_view>::Reader onWordParsed;
+    Observable<unsigned long>::Reader onIntParsed;
+    Observable<long>::Reader onSignedIntParsed;
+    Observable<double>::Reader onDecimalParsed;
+
+    EventDispatcher(SaxParser& parser, TokenBatcher<BatchDispatcher>* batcher):
+        batcher(batcher), onWordParsed(parser.m_onWordParsed), onIntParsed(parser.m_onIntParsed),
+        onSignedIntParsed(parser.m_onSignedIntParsed), onDecimalParsed(parser.m_onDecimalParsed)
+    {
+    }
+    void onWord(std::string_view word, std::size_t offset)
+    {
+        onWordParsed.fireEvent(word);
+        if (batcher)
+        {
+            batcher->onWord(word, offset);
+        }
+    }
+    void onInt(unsigned long value, std::size_t offset, std::size_t length)
+    {
+        onIntParsed.fireEvent(value);
+        if (batcher)
+        {
+            batcher->onInt(value, offset, length);
+        }
+    }
+    void onSignedInt(long value, std::size_t offset, std::size_t length)
+    {
+        onSignedIntParsed.fireEvent(value);
+        if (batcher)
+        {
+            batcher->onSignedInt(value, offset, length);
+        }
+    }
+    void onDecimal(double value, std::size_t offset, std::size_t length)
+    {
+        onDecimalParsed.fireEvent(value);
+        if (batcher)
+        {
+            batcher->onDecimal(value, offset, length);
+        }
+    }
+};
+
+struct SaxParser::TokenReplayer
+{
+    Observable<std::string_view>::Reader onWordParsed;
+    Observable<unsigned long>::Reader onIntParsed;
+    Observable<long>::Reader onSignedIntParsed;
+    Observable<double>::Reader onDecimalParsed;
+
+    /* Fire listeners of the part only, see Observable::Reader */
+    explicit TokenReplayer(SaxParser& parser, std::size_t partIndex = 0, std::size_t partCount = 1):
+        onWordParsed(parser.m_onWordParsed, 1024, partIndex, partCount),
+        onIntParsed(parser.m_onIntParsed, 1024, partIndex, partCount),
+        onSignedIntParsed(parser.m_onSignedIntParsed, 1024, partIndex, partCount),
+        onDecimalParsed(parser.m_onDecimalParsed, 1024, partIndex, partCount)
+    {
+    }
+    void operator()(const Token& token)
+    {
+        switch (token.type)
+        {
+            case TokenType::WORD:
+                onWordParsed.fireEvent(std::string_view(token.text, token.length));
+                break;
+            case TokenType::INT:
+                onIntParsed.fireEvent(token.value);
+                break;
+            case TokenType::SIGNED_INT:
+                onSignedIntParsed.fireEvent(token.signedValue);
+                break;
+            case TokenType::DECIMAL:
+                onDecimalParsed.fireEvent(token.decimalValue);
+                break;
+        }
+    }
+};
+
+/* Tokens of a batch with their word texts, owned by the async queue */
+struct AsyncBatch
+{
+    std::vector<Token> tokens;
+    std::string text; /* word characters, token texts point here */
+};
+
+class SaxParser::AsyncDispatcher
+{
+private:
+    /* Listener thread with its queue */
+    struct Consumer
     {
-        NONE,
-        DIGIT,
-        LETTER
+        SpscQueue<AsyncBatch> queue;
+        std::thread thread;
+        std::exception_ptr error; /* exception thrown by a listener */
+
+        explicit Consumer(std::size_t capacity): queue(capacity)
+        {
+        }
     };
 
-    m_onStart.fireEvent();
-    CharType charType = CharType::NONE;
-    unsigned long intValue;
-    std::size_t wordStartIdx;
-    for (std::size_t i = 0; i < input.size(); ++i)
+    SaxParser& m_parser;
+    const bool m_isUnorderedFired;  /* unordered batch listeners are served by consumers */
+    std::vector<std::unique_ptr<Consumer>> m_consumers;
+
+    /* Call listeners of the given part on every queued batch until the queue is closed */
+    void consume(std::size_t partIndex)
+    {
+        const std::size_t partCount = m_consumers.size();
+        Consumer& consumer = *m_consumers[partIndex];
+        TokenReplayer replay(m_parser, partIndex, partCount);
+        Observable<const Token*, std::size_t>::Reader onTokensParsed(m_parser.m_onTokensParsed, 1024, partIndex,
+                                                                     partCount);
+        Observable<const Token*, std::size_t>::Reader onTokensParsedUnordered(m_parser.m_onTokensParsedUnordered,
+                                                                              1024, partIndex, partCount);
+        while (AsyncBatch* batch = consumer.queue.acquireRead())
+        {
+            /* after a listener failure the queue is still drained, so the parser never blocks */
+            if (!consumer.error)
+            {
+                try
+                {
+                    for (const Token& token : batch->tokens)
+                    {
+                        replay(token);
+                    }
+                    onTokensParsed.fireEvent(batch->tokens.data(), batch->tokens.size());
+                    if (m_isUnorderedFired)
+                    {
+                        onTokensParsedUnordered.fireEvent(batch->tokens.data(), batch->tokens.size());
+                    }
+                }
+                catch (...)
+                {
+                    consumer.error = std::current_exception();
+                }
+            }
+            consumer.queue.commitRead();
+        }
+    }
+public:
+    AsyncDispatcher(SaxParser& parser, bool isUnorderedFired): m_parser(parser), m_isUnorderedFired(isUnorderedFired)
+    {
+        for (std::size_t i = 0; i < parser.m_asyncConsumerCount; ++i)
+        {
+            m_consumers.emplace_back(new Consumer(parser.m_asyncQueueCapacity));
+        }
+        for (std::size_t i = 0; i < m_consumers.size(); ++i)
+        {
+            m_consumers[i]->thread = std::thread(&AsyncDispatcher::consume, this, i);
+        }
+    }
+    AsyncDispatcher(const AsyncDispatcher&) = delete;
+    AsyncDispatcher& operator=(const AsyncDispatcher&) = delete;
+    ~AsyncDispatcher()
+    {
+        drain();
+    }
+    /* Copy tokens with their texts into the queue of every consumer, waits while a queue is full */
+    void operator()(const Token* tokens, std::size_t count)
     {
-        char ch = input[i];
-        if (std::isspace(ch))
+        /*
+         * Words of a batch usually point into one input chunk at distances equal to their offsets,
+         * then the input span they cover is copied at once instead of word by word.
+         */
+        const Token* firstWord = nullptr;
+        std::size_t textSize = 0;
+        bool isSpan = true;
+        for (std::size_t i = 0; i < count; ++i)
         {
-            switch (charType)
+            const Token& token = tokens[i];
+            if (token.text)
             {
-                case CharType::DIGIT:
-                    m_onIntParsed.fireEvent(intValue);
-                    charType = CharType::NONE;
-                    break;
-                case CharType::LETTER:
-                    m_onWordParsed.fireEvent(input.substr(wordStartIdx, i - wordStartIdx));
-                    charType = CharType::NONE;
-                    break;
+                if (!firstWord)
+                {
+                    firstWord = &token;
+                }
+                else if (reinterpret_cast<std::uintptr_t>(token.text) - reinterpret_cast<std::uintptr_t>(firstWord->text)
+                    != token.offset - firstWord->offset)
+                {
+                    isSpan = false;
+                }
+                textSize = isSpan ? token.offset + token.length - firstWord->offset : textSize + token.length;
             }
         }
-        else if (std::isdigit(ch))
+        for (std::unique_ptr<Consumer>& consumer : m_consumers)
         {
-            switch (charType)
+            AsyncBatch& batch = consumer->queue.acquireWrite();
+            batch.tokens.assign(tokens, tokens + count);
+            batch.text.clear();
+            if (isSpan && firstWord)
             {
-                case CharType::NONE:
-                    intValue = ch - '0';
-                    charType = CharType::DIGIT;
-                    break;
-                case CharType::DIGIT:
-                    if (intValue < (std::numeric_limits<unsigned long>::max() - 9) / 10)
-                    {
-                        intValue = 10 * intValue + (ch - '0');
-                    }
-                    else
+                batch.text.append(firstWord->text, textSize);
+            }
+            else
+            {
+                /* reserved text is not reallocated, so the pointers stay valid */
+                batch.text.reserve(textSize);
+            }
+            for (Token& token : batch.tokens)
+            {
+                if (token.text)
+                {
+                    std::size_t textOffset = token.offset - firstWord->offset;
+                    if (!isSpan)
                     {
-                        if (intValue <= std::numeric_limits<unsigned long>::max() / 10)
-                        {
-                            intValue *= 10;
-                            if (intValue <= std::numeric_limits<unsigned long>::max() - (ch - '0'))
-                            {
-                                intValue += ch - '0';
-                            } 
-                            else
-                            {
-                                throw ParserException(ErrorCode::INPUT_OVERFLOW);
-                            }
-                        }
-                        else
-                        {
-                            throw ParserException(ErrorCode::INPUT_OVERFLOW);
-                        }
+                        textOffset = batch.text.size();
+                        batch.text.append(token.text, token.length);
                     }
-                    break;
-                case CharType::LETTER:
-                    throw ParserException(ErrorCode::TOKENS_NOT_SEPARATED);
+                    token.text = batch.text.data() + textOffset;
+                }
+            }
+            consumer->queue.commitWrite();
+        }
+    }
+    /* Wait until listeners handle all queued batches and stop the listener threads */
+    void drain()
+    {
+        for (std::unique_ptr<Consumer>& consumer : m_consumers)
+        {
+            if (consumer->thread.joinable())
+            {
+                consumer->queue.close();
+                consumer->thread.join();
+            }
+        }
+    }
+    /* Rethrow the first exception thrown by a listener */
+    void rethrowListenerError() const
+    {
+        for (const std::unique_ptr<Consumer>& consumer : m_consumers)
+        {
+            if (consumer->error)
+            {
+                std::rethrow_exception(consumer->error);
             }
         }
-        else
+    }
+};
+
+template<typename Feed> void SaxParser::parseAsync(const Feed& feed) {
+    AsyncDispatcher dispatcher(*this, true);
+    TokenBatcher<AsyncDispatcher> batcher(dispatcher);
+    try
+    {
+        feed(batcher);
+    }
+    catch (...)
+    {
+        /* listeners get the tokens preceding the error before it is reported */
+        batcher.flush();
+        dispatcher.drain();
+        throw;
+    }
+    batcher.flush();
+    dispatcher.drain();
+    dispatcher.rethrowListenerError();
+}
+
+template<template<typename> class TokenizerType> void SaxParser::tokenizeString(const std::string& input) {
+    m_onStart.fireEvent();
+    if (m_asyncConsumerCount)
+    {
+        parseAsync([&input](TokenBatcher<AsyncDispatcher>& batcher)
+        {
+            TokenizerType<TokenBatcher<AsyncDispatcher>> tokenizer(batcher);
+            batcher.beginChunk(input.data(), input.size());
+            tokenizer.feed(input.data(), input.size(), true);
+        });
+        m_onEnd.fireEvent();
+        return;
+    }
+    BatchDispatcher batchDispatcher{ *this };
+    TokenBatcher<BatchDispatcher> batcher(batchDispatcher);
+    EventDispatcher dispatcher(*this, hasBatchListeners() ? &batcher : nullptr);
+    TokenizerType<EventDispatcher> tokenizer(dispatcher);
+
+    batcher.beginChunk(input.data(), input.size());
+    tokenizer.feed(input.data(), input.size(), true);
+    batcher.flush();
+    m_onEnd.fireEvent();
+}
+
+void SaxParser::parse(const std::string& input) {
+    if (m_isExtendedGrammar)
+    {
+        tokenizeString<ExtendedTokenizer>(input);
+    }
+    else
+    {
+        tokenizeString<Tokenizer>(input);
+    }
+}
+
+template<template<typename> class TokenizerType, typename Source>
+void SaxParser::tokenizeChunks(const Source& source) {
+    m_onStart.fireEvent();
+    if (m_asyncConsumerCount)
+    {
+        parseAsync([&source](TokenBatcher<AsyncDispatcher>& batcher)
+        {
+            TokenizerType<TokenBatcher<AsyncDispatcher>> tokenizer(batcher);
+            source([&tokenizer, &batcher](const char* data, std::size_t size)
+            {
+                batcher.beginChunk(data, size);
+                tokenizer.feed(data, size);
+                batcher.flush();
+            });
+            tokenizer.finish();
+        });
+        m_onEnd.fireEvent();
+        return;
+    }
+    BatchDispatcher batchDispatcher{ *this };
+    TokenBatcher<BatchDispatcher> batcher(batchDispatcher);
+    EventDispatcher dispatcher(*this, hasBatchListeners() ? &batcher : nullptr);
+    TokenizerType<EventDispatcher> tokenizer(dispatcher);
+
+    source([&tokenizer, &batcher](const char* data, std::size_t size)
+    {
+        batcher.beginChunk(data, size);
+        tokenizer.feed(data, size);
+        /* the chunk buffer is reused after return */
+        batcher.flush();
+    });
+    tokenizer.finish();
+    batcher.flush();
+    m_onEnd.fireEvent();
+}
+
+template<typename Source> void SaxParser::parseChunks(const Source& source) {
+    if (m_isExtendedGrammar)
+    {
+        tokenizeChunks<ExtendedTokenizer>(source);
+    }
+    else
+    {
+        tokenizeChunks<Tokenizer>(source);
+    }
+}
+
+void SaxParser::parse(const ChunkReader& reader, std::size_t chunkSize) {
+    parseChunks([&reader, chunkSize](const ChunkConsumer& consumer)
+    {
+        readChunks(reader, chunkSize, consumer);
+    });
+}
+
+void SaxParser::parse(std::istream& input, std::size_t chunkSize) {
+    parse(makeStreamReader(input), chunkSize);
+}
+
+void SaxParser::parseFd(int fd, std::size_t chunkSize) {
+    parse(makeFdReader(fd), chunkSize);
+}
+
+void SaxParser::parseFile(const std::string& path, std::size_t windowSize) {
+    parseChunks([&path, windowSize](const ChunkConsumer& consumer)
+    {
+        readFile(path, windowSize, consumer);
+    });
+}
+
+namespace
+{
+
+/* Tokenizer handler that stores tokens of an input segment */
+struct SegmentCollector
+{
+    std::vector<Token>& tokens;
+
+    void onWord(std::string_view word, std::size_t offset)
+    {
+        tokens.push_back({ TokenType::WORD, offset, word.size(), 0, word.data() });
+    }
+    void onInt(unsigned long value, std::size_t offset, std::size_t length)
+    {
+        tokens.push_back({ TokenType::INT, offset, length, value, nullptr });
+    }
+    void onSignedInt(long value, std::size_t offset, std::size_t length)
+    {
+        Token token = { TokenType::SIGNED_INT, offset, length, 0, nullptr };
+        token.signedValue = value;
+        tokens.push_back(token);
+    }
+    void onDecimal(double value, std::size_t offset, std::size_t length)
+    {
+        Token token = { TokenType::DECIMAL, offset, length, 0, nullptr };
+        token.decimalValue = value;
+        tokens.push_back(token);
+    }
+};
+
+/* Tokenize a whole input segment starting at given input offset */
+template<template<typename> class TokenizerType>
+void tokenizeSegment(SegmentCollector& collector, const char* data, std::size_t size, std::size_t position)
+{
+    TokenizerType<SegmentCollector> tokenizer(collector, position);
+    tokenizer.feed(data, size, true);
+}
+
+/* Tokenized input segment */
+struct Segment
+{
+    std::vector<Token> tokens;   /* tokens in document order */
+    bool isReady = false;        /* tokenization finished */
+    std::exception_ptr error;    /* tokenization or an unordered listener failed, rethrown at the segment turn */
+};
+
+/* Pass tokens of a contiguous input span to the sink in batches cut the way TokenBatcher cuts them */
+template<typename Sink> void splitBatches(const Token* tokens, std::size_t count, Sink& sink)
+{
+    std::size_t batchStart = 0;
+    for (std::size_t i = 0; i <= count; ++i)
+    {
+        if (i == count || i - batchStart == TOKEN_BATCH_CAPACITY
+            || tokens[i].offset - tokens[batchStart].offset >= TOKEN_BATCH_INPUT_SIZE)
         {
-            switch (charType)
+            if (i != batchStart)
             {
-                case CharType::NONE:
-                    wordStartIdx = i;
-                    charType = CharType::LETTER;
-                    break;
-                case CharType::DIGIT:
-                    throw ParserException(ErrorCode::TOKENS_NOT_SEPARATED);
-            } 
+                sink(tokens + batchStart, i - batchStart);
+            }
+            batchStart = i;
         }
     }
+}
 
-    switch (charType)
+}
+
+void SaxParser::parseParallel(const std::string& input, std::size_t threadCount, std::size_t segmentSize) {
+    if (!threadCount)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const std::vector<std::size_t> bounds = splitAtWhitespace(input, std::max<std::size_t>(segmentSize, 1));
+    const std::size_t segmentCount = bounds.size() - 1;
+    if (threadCount == 1 || segmentCount == 1)
     {
-        case CharType::DIGIT:
-            m_onIntParsed.fireEvent(intValue);
-            break;
-        case CharType::LETTER:
-            m_onWordParsed.fireEvent(input.substr(wordStartIdx, input.size() - wordStartIdx));
-            break;
+        parse(input);
+        return;
     }
 
+    /*
+     * Workers take segments in order and tokenize them into slots of a ring,
+     * the calling thread replays ready slots in document order.
+     * A worker may run at most slotCount segments ahead of the replay, this bounds the memory.
+     */
+    const std::size_t slotCount = 2 * threadCount;
+    std::vector<Segment> slots(slotCount);
+    std::mutex mutex;
+    std::condition_variable slotReady;
+    std::condition_variable slotFree;
+    std::size_t nextSegment = 0;     /* next segment to be taken by a worker */
+    std::size_t replayedCount = 0;   /* segments already replayed */
+    bool isStopped = false;          /* replay failed, workers must quit */
+    const bool hasUnorderedListeners = m_onTokensParsedUnordered.hasListeners();
+
+    auto work = [&]()
+    {
+        std::vector<Token> tokens;
+        while (true)
+        {
+            std::size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slotFree.wait(lock, [&]() { return isStopped || nextSegment < replayedCount + slotCount; });
+                if (isStopped || nextSegment == segmentCount)
+                {
+                    return;
+                }
+                index = nextSegment++;
+                /* reuse the storage left in the slot */
+                tokens.swap(slots[index % slotCount].tokens);
+            }
+            tokens.clear();
+            Segment segment;
+            SegmentCollector collector{ tokens };
+            try
+            {
+                /* segments are split at ASCII whitespace, which is a token and UTF-8 sequence boundary in both grammars */
+                if (m_isExtendedGrammar)
+                {
+                    tokenizeSegment<ExtendedTokenizer>(collector, input.data() + bounds[index],
+                                                       bounds[index + 1] - bounds[index], bounds[index]);
+                }
+                else
+                {
+                    tokenizeSegment<Tokenizer>(collector, input.data() + bounds[index],
+                                               bounds[index + 1] - bounds[index], bounds[index]);
+                }
+            }
+            catch (...)
+            {
+                segment.error = std::current_exception();
+            }
+            if (hasUnorderedListeners && !tokens.empty())
+            {
+                /* the listener sees the tokens before a parser error, so its failure comes first like in parse() */
+                try
+                {
+                    m_onTokensParsedUnordered.fireEvent(tokens.data(), tokens.size());
+                }
+                catch (...)
+                {
+                    segment.error = std::current_exception();
+                }
+            }
+            segment.tokens.swap(tokens);
+            segment.isReady = true;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slots[index % slotCount] = std::move(segment);
+            }
+            slotReady.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    auto stopWorkers = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopped = true;
+        }
+        slotFree.notify_all();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    };
+
+    m_onStart.fireEvent();
+    /* unordered batches are fired by the workers */
+    std::unique_ptr<AsyncDispatcher> asyncDispatcher(m_asyncConsumerCount ? new AsyncDispatcher(*this, false) : nullptr);
+    for (std::size_t i = 0; i < std::min(threadCount, segmentCount); ++i)
+    {
+        workers.emplace_back(work);
+    }
+    try
+    {
+        const bool hasBatchListeners = m_onTokensParsed.hasListeners();
+        auto fireBatch = [this](const Token* tokens, std::size_t count)
+        {
+            m_onTokensParsed.fireEvent(tokens, count);
+        };
+        TokenReplayer replay(*this);
+        for (std::size_t index = 0; index < segmentCount; ++index)
+        {
+            Segment* segment = &slots[index % slotCount];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slotReady.wait(lock, [segment]() { return segment->isReady; });
+            }
+            if (asyncDispatcher)
+            {
+                splitBatches(segment->tokens.data(), segment->tokens.size(), *asyncDispatcher);
+            }
+            else
+            {
+                for (const Token& token : segment->tokens)
+                {
+                    replay(token);
+                }
+                if (hasBatchListeners)
+                {
+                    splitBatches(segment->tokens.data(), segment->tokens.size(), fireBatch);
+                }
+            }
+            if (segment->error)
+            {
+                /* the handler below stops the workers before the exception leaves */
+                std::rethrow_exception(segment->error);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                segment->isReady = false;
+                ++replayedCount;
+            }
+            slotFree.notify_all();
+        }
+    }
+    catch (...)
+    {
+        stopWorkers();
+        if (asyncDispatcher)
+        {
+            asyncDispatcher->drain();
+        }
+        throw;
+    }
+    stopWorkers();
+    if (asyncDispatcher)
+    {
+        asyncDispatcher->drain();
+        asyncDispatcher->rethrowListenerError();
+    }
     m_onEnd.fireEvent();
 }
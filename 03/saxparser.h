@@ -1,26 +1,122 @@
 #ifndef SAXPARSER_H
 #define SAXPARSER_H
 
-#include <exception>
+#include <istream>
 #include <string>
+#include <string_view>
 
+#include "chunkreader.h"
 #include "observable.h"
+#include "parsererror.h"
+#include "tokenbatch.h"
 
-/* Event driven string parser */
+/* Event driven string parser, not copyable since its listener observables are not */
 class SaxParser {
     private:
         /* Event observables */
         Observable<> m_onStart;
         Observable<> m_onEnd;
-        Observable<const std::string&> m_onWordParsed; // std::string_view is better
+        Observable<std::string_view> m_onWordParsed;   /* word is a view into the parsed input */
         Observable<unsigned long> m_onIntParsed;
+        Observable<long> m_onSignedIntParsed;
+        Observable<double> m_onDecimalParsed;
+        Observable<const Token*, std::size_t> m_onTokensParsed;
+        Observable<const Token*, std::size_t> m_onTokensParsedUnordered;
+        std::size_t m_asyncConsumerCount;  /* listener threads of the async dispatch, zero if disabled */
+        std::size_t m_asyncQueueCapacity;  /* batches buffered per listener thread */
+        bool m_isExtendedGrammar;          /* tokenize with ExtendedTokenizer */
+
+        /* Tokenizer handler that fires parser events */
+        struct EventDispatcher;
+        /* Batch sink that fires batch events */
+        struct BatchDispatcher;
+        /* Batch sink that passes tokens to listener threads */
+        class AsyncDispatcher;
+        /* Per-token listeners fired from collected tokens */
+        struct TokenReplayer;
+
+        /* Check if there is any batch listener */
+        bool hasBatchListeners() const
+        {
+            return m_onTokensParsed.hasListeners() || m_onTokensParsedUnordered.hasListeners();
+        }
+        /* Tokenize input with the async dispatcher, feed passes the input to a tokenizer of batcher */
+        template<typename Feed> void parseAsync(const Feed& feed);
+        /* Tokenize input string with a Tokenizer or ExtendedTokenizer */
+        template<template<typename> class TokenizerType> void tokenizeString(const std::string& input);
+        /* Tokenize chunks passed by source, a callable taking a ChunkConsumer */
+        template<template<typename> class TokenizerType, typename Source> void tokenizeChunks(const Source& source);
+        /* Tokenize chunks passed by source with the tokenizer of the grammar */
+        template<typename Source> void parseChunks(const Source& source);
     public:
+        /* Source of input chunks for streaming parsing */
+        typedef ::ChunkReader ChunkReader;
+
+        /* Default count of batches buffered per listener thread in async dispatch */
+        static const std::size_t DEFAULT_ASYNC_QUEUE_CAPACITY = 64;
+
+        SaxParser(): m_asyncConsumerCount(0), m_asyncQueueCapacity(DEFAULT_ASYNC_QUEUE_CAPACITY),
+            m_isExtendedGrammar(false)
+        {
+        }
+        /**
+         * Switch between the basic grammar (words and unsigned integers separated by ASCII whitespace)
+         * and the extended one: signed integers, decimal numbers and UTF-8 words separated by ASCII
+         * or Unicode whitespace, input is validated as UTF-8. See ExtendedTokenizer.
+         */
+        void setExtendedGrammar(bool isExtended)
+        {
+            m_isExtendedGrammar = isExtended;
+        }
+        /**
+         * Call word, integer and batch listeners on separate threads, so that tokenizing overlaps with
+         * slow listeners. Tokens are copied into a bounded queue of batches per listener thread,
+         * the parser waits when a queue is full. Every listener is served by one of consumerCount threads
+         * and sees its events in document order. Start and end listeners are called on the parsing thread,
+         * end listeners after all queued events are handled, and so are parser errors reported.
+         * An exception thrown by a listener stops event delivery and is rethrown by the parse call.
+         * Zero consumerCount restores synchronous dispatch.
+         */
+        void setAsyncDispatch(std::size_t consumerCount, std::size_t queueCapacity = DEFAULT_ASYNC_QUEUE_CAPACITY)
+        {
+            m_asyncConsumerCount = consumerCount;
+            m_asyncQueueCapacity = queueCapacity;
+        }
+
         /** 
          * Parse input string.
          * Finite automata that pulls tokens one by one from the lexer until EOL.
          */
         void parse(const std::string& input);
-        
+        /**
+         * Parse input read chunk by chunk.
+         * Memory consumption is constant: two chunk buffers and a carry-over buffer
+         * for a word split by a chunk boundary. Next chunk is read while the current one is parsed.
+         */
+        void parse(const ChunkReader& reader, std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+        /** Parse input stream chunk by chunk */
+        void parse(std::istream& input, std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+        /** Parse input read from file descriptor chunk by chunk until EOF */
+        void parseFd(int fd, std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+        /**
+         * Parse file without copying it: a regular file is memory-mapped and tokenized in place
+         * window by window, word views point into the mapping. See readFile().
+         */
+        void parseFile(const std::string& path, std::size_t windowSize = DEFAULT_MAP_WINDOW_SIZE);
+
+        /* Default size of an input segment tokenized by one thread in a parallel parse */
+        static const std::size_t DEFAULT_SEGMENT_SIZE = 1 << 20;
+
+        /**
+         * Parse large input string on several threads.
+         * Input is split at whitespace into segments of about segmentSize bytes, segments are
+         * tokenized concurrently and events are replayed to listeners in document order
+         * on the calling thread, or on the listener threads if async dispatch is set. Errors are reported at the same offset and after the same events
+         * as by parse(). Zero threadCount means hardware concurrency.
+         */
+        void parseParallel(const std::string& input, std::size_t threadCount = 0,
+                           std::size_t segmentSize = DEFAULT_SEGMENT_SIZE);
+
 
         /** Add listener callback on parsing started */
         void addListenerOnParseStart(void (* listener)())
@@ -42,13 +138,16 @@ class SaxParser {
         {
             m_onEnd.removeListener(listener);
         }
-        /** Add listener callback on word encountered */
-        void addListenerOnWordParsed(void (* listener)(const std::string&))
+        /**
+         * Add listener callback on word encountered.
+         * The word view is valid only during the callback, copy it to keep it.
+         */
+        void addListenerOnWordParsed(void (* listener)(std::string_view))
         {
             m_onWordParsed.addListener(listener);
         }
         /** Remove listener callback on word encountered  */
-        void removeListenerOnWordParsed(void (* listener)(const std::string&))
+        void removeListenerOnWordParsed(void (* listener)(std::string_view))
         {
             m_onWordParsed.removeListener(listener);
         }
@@ -62,24 +161,60 @@ class SaxParser {
         {
             m_onIntParsed.removeListener(listener);
         }
+        /** Add listener callback on signed integer encountered, extended grammar only */
+        void addListenerOnSignedIntParsed(void (* listener)(long))
+        {
+            m_onSignedIntParsed.addListener(listener);
+        }
+        /** Remove listener callback on signed integer encountered */
+        void removeListenerOnSignedIntParsed(void (* listener)(long))
+        {
+            m_onSignedIntParsed.removeListener(listener);
+        }
+        /** Add listener callback on decimal number encountered, extended grammar only */
+        void addListenerOnDecimalParsed(void (* listener)(double))
+        {
+            m_onDecimalParsed.addListener(listener);
+        }
+        /** Remove listener callback on decimal number encountered */
+        void removeListenerOnDecimalParsed(void (* listener)(double))
+        {
+            m_onDecimalParsed.removeListener(listener);
+        }
+        /**
+         * Add listener callback on a batch of tokens parsed.
+         * Batches cover about TOKEN_BATCH_INPUT_SIZE bytes of input and come in document order,
+         * word texts are valid only during the callback.
+         * Batch listeners may be used together with per-token listeners.
+         */
+        void addListenerOnTokensParsed(void (* listener)(const Token*, std::size_t))
+        {
+            m_onTokensParsed.addListener(listener);
+        }
+        /** Remove listener callback on a batch of tokens parsed */
+        void removeListenerOnTokensParsed(void (* listener)(const Token*, std::size_t))
+        {
+            m_onTokensParsed.removeListener(listener);
+        }
+        /**
+         * Add listener callback on a batch of tokens parsed, batch order is not guaranteed.
+         * In parseParallel() it is called concurrently from the tokenizing threads, so it must be thread-safe;
+         * it may also receive tokens that follow a parser error.
+         */
+        void addListenerOnTokensParsedUnordered(void (* listener)(const Token*, std::size_t))
+        {
+            m_onTokensParsedUnordered.addListener(listener);
+        }
+        /** Remove unordered listener callback on a batch of tokens parsed */
+        void removeListenerOnTokensParsedUnordered(void (* listener)(const Token*, std::size_t))
+        {
+            m_onTokensParsedUnordered.removeListener(listener);
+        }
         
-    /* Possible error codes of the parser */
-    enum ErrorCode {
-        INPUT_OVERFLOW = 0,       /* Read number is beyond domain of unsigned long type */
-        TOKENS_NOT_SEPARATED = 1  /* Unseparated word and number encountered */
-    };
-
-    /* Object wrapper over ErrorCode */
-    struct ParserException : public std::exception {
-        const ErrorCode errorCode;
-    
-        ParserException(ErrorCode errorCode): errorCode(errorCode) { }
-    
-    	const char* what() noexcept 
-    	{
-            return "Parser exception";
-    	}
-	};
+        /* Possible error codes of the parser */
+        typedef ParserErrorCode ErrorCode;
+        /* Object wrapper over ErrorCode */
+        typedef ::ParserException ParserException;
 };
 
 
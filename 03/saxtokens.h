@@ -0,0 +1,219 @@
+#ifndef SAXTOKENS_H
+#define SAXTOKENS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#include "charclass.h"
+#include "numparse.h"
+#include "parsererror.h"
+#include "tokenbatch.h"
+
+/**
+ * Pull-based token sequence over an in-memory input:
+ *     for (const Token& token : SaxTokens(input)) { ... }
+ * Tokens are found lazily when the iterator advances, nothing is allocated,
+ * so a consumer may stop early and keep its state on the stack.
+ * Grammar and errors are the same as of SaxParser; ParserException is thrown by the
+ * iterator increment (or begin()) that reaches the offending token.
+ * Word texts point into the input, which must outlive the iterators.
+ */
+class SaxTokens
+{
+private:
+    std::string_view m_input; /* parsed input */
+public:
+    /* Forward iterator over tokens */
+    class Iterator
+    {
+    private:
+        const char* m_data;       /* input */
+        std::size_t m_size;       /* input size */
+        std::size_t m_position;   /* scanning starts here on the next increment */
+        std::size_t m_blockStart; /* start of the block containing the last token end */
+        std::uint64_t m_space;    /* whitespace bits of that block */
+        std::uint64_t m_digit;    /* digit bits of that block */
+        std::uint64_t m_valid;    /* bits of that block inside the input */
+        Token m_token;            /* current token */
+        bool m_isEnd;             /* past the last token */
+
+        /* Classify the block starting at blockStart */
+        void classify(std::size_t blockStart, std::uint64_t& space, std::uint64_t& digit, std::uint64_t& valid) const
+        {
+            const std::size_t blockSize = m_size - blockStart;
+            const CharMasks masks = blockSize >= CHAR_BLOCK_SIZE
+                ? classifyBlock(m_data + blockStart)
+                : classifyTail(m_data + blockStart, blockSize);
+            space = masks.space;
+            digit = masks.digit;
+            valid = blockSize >= CHAR_BLOCK_SIZE ? ~0ULL : (1ULL << blockSize) - 1;
+        }
+        /* Find the next token */
+        void advance();
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Token value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Token* pointer;
+        typedef const Token& reference;
+
+        /* End iterator */
+        Iterator(): m_data(nullptr), m_size(0), m_position(0), m_blockStart(0), m_space(0), m_digit(0), m_valid(0), m_token{},
+            m_isEnd(true)
+        {
+        }
+        /* Iterator at the first token of the input */
+        explicit Iterator(std::string_view input): m_data(input.data()), m_size(input.size()), m_position(0),
+            m_blockStart(0), m_space(0), m_digit(0), m_valid(0), m_token{}, m_isEnd(false)
+        {
+            if (m_size)
+            {
+                classify(0, m_space, m_digit, m_valid);
+            }
+            advance();
+        }
+        reference operator*() const
+        {
+            return m_token;
+        }
+        pointer operator->() const
+        {
+            return &m_token;
+        }
+        Iterator& operator++()
+        {
+            advance();
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator result = *this;
+            advance();
+            return result;
+        }
+        bool operator==(const Iterator& other) const
+        {
+            return m_isEnd == other.m_isEnd && (m_isEnd || m_token.offset == other.m_token.offset);
+        }
+        bool operator!=(const Iterator& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    explicit SaxTokens(std::string_view input): m_input(input)
+    {
+    }
+    Iterator begin() const
+    {
+        return Iterator(m_input);
+    }
+    Iterator end() const
+    {
+        return Iterator();
+    }
+};
+
+/*
+ * Like Tokenizer::feed(), the masks of the current block are kept in locals and token boundaries are
+ * found with bit scans over them, a block is classified only when the scan crosses into it.
+ * The masks are stored as separate words: copying CharMasks in and out per token stalls on store forwarding.
+ */
+inline void SaxTokens::Iterator::advance()
+{
+    std::size_t blockStart = m_blockStart;
+    std::uint64_t space = m_space;
+    std::uint64_t digit = m_digit;
+    std::uint64_t valid = m_valid;
+    std::size_t i = m_position - blockStart;
+
+    /* skip whitespace up to the token start */
+    for (;;)
+    {
+        if (i < CHAR_BLOCK_SIZE)
+        {
+            const std::uint64_t boundary = ~space & valid & (~0ULL << i);
+            if (boundary)
+            {
+                i = __builtin_ctzll(boundary);
+                break;
+            }
+        }
+        if (blockStart + CHAR_BLOCK_SIZE >= m_size)
+        {
+            m_isEnd = true;
+            m_position = m_size;
+            m_blockStart = blockStart;
+            m_space = space;
+            m_digit = digit;
+            m_valid = valid;
+            return;
+        }
+        blockStart += CHAR_BLOCK_SIZE;
+        classify(blockStart, space, digit, valid);
+        i = 0;
+    }
+
+    const std::size_t start = blockStart + i;
+    if (digit >> i & 1)
+    {
+        unsigned long value = 0;
+        for (;;)
+        {
+            const std::uint64_t boundary = ~digit & valid & (~0ULL << i);
+            const std::size_t end = boundary ? __builtin_ctzll(boundary) : std::min(CHAR_BLOCK_SIZE, m_size - blockStart);
+            appendDigits(value, m_data + blockStart + i, end - i, blockStart + i);
+            i = end;
+            if (boundary)
+            {
+                if (!(space >> i & 1))
+                {
+                    throw ParserException(ParserErrorCode::TOKENS_NOT_SEPARATED, blockStart + i);
+                }
+                break;
+            }
+            if (blockStart + CHAR_BLOCK_SIZE >= m_size)
+            {
+                break;
+            }
+            blockStart += CHAR_BLOCK_SIZE;
+            classify(blockStart, space, digit, valid);
+            i = 0;
+        }
+        m_token = { TokenType::INT, start, blockStart + i - start, value, nullptr };
+    }
+    else
+    {
+        for (;;)
+        {
+            const std::uint64_t boundary = (space | digit) & valid & (~0ULL << i);
+            if (boundary)
+            {
+                i = __builtin_ctzll(boundary);
+                if (digit >> i & 1)
+                {
+                    throw ParserException(ParserErrorCode::TOKENS_NOT_SEPARATED, blockStart + i);
+                }
+                break;
+            }
+            if (blockStart + CHAR_BLOCK_SIZE >= m_size)
+            {
+                i = m_size - blockStart;
+                break;
+            }
+            blockStart += CHAR_BLOCK_SIZE;
+            classify(blockStart, space, digit, valid);
+            i = 0;
+        }
+        m_token = { TokenType::WORD, start, blockStart + i - start, 0, m_data + start };
+    }
+    m_position = blockStart + i;
+    m_blockStart = blockStart;
+    m_space = space;
+    m_digit = digit;
+    m_valid = valid;
+}
+
+#endif /* SAXTOKENS_H */
@@ -0,0 +1,99 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/**
+ * Bounded single-producer single-consumer ring buffer.
+ *
+ * Slots are preallocated and reused, so the producer fills a slot in place:
+ *     T& item = queue.acquireWrite(); ...fill item...; queue.commitWrite();
+ * and the consumer reads it the same way with acquireRead()/commitRead().
+ * The producer blocks while the ring is full (backpressure), the consumer blocks while it is empty.
+ * Positions are exchanged with atomics, the mutex is only taken to sleep and to wake a sleeping side.
+ */
+template<typename T> class SpscQueue
+{
+private:
+    std::vector<T> m_slots;                       /* ring storage */
+    alignas(64) std::atomic<std::size_t> m_head;  /* count of read items, written by the consumer */
+    alignas(64) std::atomic<std::size_t> m_tail;  /* count of written items, written by the producer */
+    std::atomic<bool> m_isClosed;                 /* producer will write no more */
+    std::atomic<bool> m_isProducerWaiting;
+    std::atomic<bool> m_isConsumerWaiting;
+    std::mutex m_mutex;                           /* guards sleeping */
+    std::condition_variable m_condition;
+
+    /* Wake the other side if it sleeps; the waiting flag is checked after the position is published */
+    void wake(std::atomic<bool>& isWaiting)
+    {
+        if (isWaiting.load())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_condition.notify_all();
+        }
+    }
+    /* Sleep until the predicate holds */
+    template<typename Predicate> void wait(std::atomic<bool>& isWaiting, Predicate predicate)
+    {
+        if (predicate())
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        isWaiting.store(true);
+        m_condition.wait(lock, predicate);
+        isWaiting.store(false);
+    }
+public:
+    explicit SpscQueue(std::size_t capacity): m_slots(capacity ? capacity : 1), m_head(0), m_tail(0),
+        m_isClosed(false), m_isProducerWaiting(false), m_isConsumerWaiting(false)
+    {
+    }
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    /** Wait for a free slot, called by the producer */
+    T& acquireWrite()
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        wait(m_isProducerWaiting, [this, tail]() { return tail - m_head.load() < m_slots.size(); });
+        return m_slots[tail % m_slots.size()];
+    }
+    /** Pass the slot returned by acquireWrite() to the consumer */
+    void commitWrite()
+    {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1);
+        wake(m_isConsumerWaiting);
+    }
+    /** Signal that nothing more will be written, called by the producer */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isClosed.store(true);
+        }
+        m_condition.notify_all();
+    }
+    /** Wait for an item, called by the consumer; nullptr if the queue is closed and drained */
+    T* acquireRead()
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        wait(m_isConsumerWaiting, [this, head]() { return m_tail.load() != head || m_isClosed.load(); });
+        if (m_tail.load() == head)
+        {
+            return nullptr;
+        }
+        return &m_slots[head % m_slots.size()];
+    }
+    /** Return the slot returned by acquireRead() to the producer */
+    void commitRead()
+    {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1);
+        wake(m_isProducerWaiting);
+    }
+};
+
+#endif /* SPSCQUEUE_H */
@@ -0,0 +1,82 @@
+#ifndef STATICOBSERVABLE_H
+#define STATICOBSERVABLE_H
+
+#include <functional>
+#include <tuple>
+#include <utility>
+
+/**
+ * Observable with listeners fixed at compile time.
+ *
+ * Listeners are any callables: functors with state, lambdas, StaticListener and MemberListener.
+ * They are stored by value in a tuple and called directly, so the compiler can inline them
+ * into the firing code. Use std::ref to keep a listener owned elsewhere.
+ * For listeners changed at runtime use Observable.
+ */
+template<typename ...Listeners> class StaticObservable
+{
+private:
+    std::tuple<Listeners...> m_listeners; /* Listeners in order of calls */
+public:
+    StaticObservable() = default;
+    explicit StaticObservable(Listeners... listeners): m_listeners(std::move(listeners)...)
+    {
+    }
+    /** Fire event, call all listeners in order of their declaration */
+    template<typename ...A>
+    void fireEvent(const A&... args)
+    {
+        std::apply([&args...](auto&... listeners)
+        {
+            (std::invoke(listeners, args...), ...);
+        }, m_listeners);
+    }
+    /** Access listener by its position */
+    template<std::size_t I>
+    auto& getListener()
+    {
+        return std::get<I>(m_listeners);
+    }
+};
+
+/** Make a static observable deducing listener types */
+template<typename ...Listeners>
+StaticObservable<Listeners...> makeStaticObservable(Listeners... listeners)
+{
+    return StaticObservable<Listeners...>(std::move(listeners)...);
+}
+
+/** Free function listener known at compile time */
+template<auto Function> struct StaticListener
+{
+    template<typename ...A>
+    void operator()(const A&... args) const
+    {
+        Function(args...);
+    }
+};
+
+/** Member function listener, the method is known at compile time */
+template<auto Method, typename Object> class MemberListener
+{
+private:
+    Object* m_object; /* listening object */
+public:
+    explicit MemberListener(Object& object): m_object(&object)
+    {
+    }
+    template<typename ...A>
+    void operator()(const A&... args) const
+    {
+        (m_object->*Method)(args...);
+    }
+};
+
+/** Make a member function listener, usage: bindMember<&Foo::onEvent>(foo) */
+template<auto Method, typename Object>
+MemberListener<Method, Object> bindMember(Object& object)
+{
+    return MemberListener<Method, Object>(object);
+}
+
+#endif /* STATICOBSERVABLE_H */
@@ -0,0 +1,191 @@
+#ifndef STATICSAXPARSER_H
+#define STATICSAXPARSER_H
+
+#include <istream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "chunkreader.h"
+#include "tokenbatch.h"
+#include "tokenizer.h"
+
+/**
+ * Event driven string parser with compile-time listener dispatch.
+ *
+ * Same grammar and events as SaxParser, but events go straight to the handler methods
+ * instead of runtime observables, so they can be inlined into the tokenizer loop.
+ * Handler may provide any subset of
+ *     void onStart();
+ *     void onEnd();
+ *     void onWord(std::string_view word);  (or const std::string&, then every word is copied)
+ *     void onInt(unsigned long value);
+ *     void onTokens(const Token* tokens, std::size_t count);
+ * Missing methods mean the event is ignored, an onWord accepting neither argument is a compile error.
+ * onTokens receives batches of tokens, see SaxParser::addListenerOnTokensParsed. A handler may hold
+ * StaticObservable members to fan an event out to several listeners.
+ */
+template<typename Handler> class StaticSaxParser
+{
+private:
+    template<typename T, typename = void> struct HasOnStart : std::false_type {};
+    template<typename T> struct HasOnStart<T, std::void_t<decltype(std::declval<T&>().onStart())>> : std::true_type {};
+    template<typename T, typename = void> struct HasOnEnd : std::false_type {};
+    template<typename T> struct HasOnEnd<T, std::void_t<decltype(std::declval<T&>().onEnd())>> : std::true_type {};
+    template<typename T, typename = void> struct HasOnWord : std::false_type {};
+    template<typename T> struct HasOnWord<T, std::void_t<decltype(std::declval<T&>().onWord(std::string_view()))>> : std::true_type {};
+    template<typename T, typename = void> struct HasOnWordString : std::false_type {};
+    template<typename T> struct HasOnWordString<T, std::void_t<decltype(std::declval<T&>().onWord(
+        std::declval<const std::string&>()))>> : std::true_type {};
+    template<typename T, typename = void> struct HasOnWordMember : std::false_type {};
+    template<typename T> struct HasOnWordMember<T, std::void_t<decltype(&T::onWord)>> : std::true_type {};
+    template<typename T, typename = void> struct HasOnInt : std::false_type {};
+    template<typename T> struct HasOnInt<T, std::void_t<decltype(std::declval<T&>().onInt(0UL))>> : std::true_type {};
+    template<typename T, typename = void> struct HasOnTokens : std::false_type {};
+    template<typename T> struct HasOnTokens<T, std::void_t<decltype(std::declval<T&>().onTokens(
+        static_cast<const Token*>(nullptr), std::size_t()))>> : std::true_type {};
+
+    /* Batch sink that calls Handler::onTokens */
+    struct BatchDispatcher
+    {
+        Handler& handler;
+
+        void operator()(const Token* tokens, std::size_t count)
+        {
+            if constexpr (HasOnTokens<Handler>::value)
+            {
+                handler.onTokens(tokens, count);
+            }
+        }
+    };
+
+    /* Tokenizer handler that skips events missing in Handler */
+    struct EventDispatcher
+    {
+        Handler& handler;
+        TokenBatcher<BatchDispatcher>& batcher;
+
+        void onWord(std::string_view word, std::size_t offset)
+        {
+            if constexpr (HasOnWord<Handler>::value)
+            {
+                handler.onWord(word);
+            }
+            else if constexpr (HasOnWordString<Handler>::value)
+            {
+                handler.onWord(std::string(word));
+            }
+            else
+            {
+                static_assert(!HasOnWordMember<Handler>::value,
+                              "Handler::onWord must accept std::string_view or const std::string&");
+            }
+            if constexpr (HasOnTokens<Handler>::value)
+            {
+                batcher.onWord(word, offset);
+            }
+        }
+        void onInt(unsigned long value, std::size_t offset, std::size_t length)
+        {
+            if constexpr (HasOnInt<Handler>::value)
+            {
+                handler.onInt(value);
+            }
+            if constexpr (HasOnTokens<Handler>::value)
+            {
+                batcher.onInt(value, offset, length);
+            }
+        }
+    };
+
+    Handler& m_handler; /* event target */
+
+    void fireStart()
+    {
+        if constexpr (HasOnStart<Handler>::value)
+        {
+            m_handler.onStart();
+        }
+    }
+    void fireEnd()
+    {
+        if constexpr (HasOnEnd<Handler>::value)
+        {
+            m_handler.onEnd();
+        }
+    }
+    /* Tokenize chunks passed by source, a callable taking a ChunkConsumer */
+    template<typename Source> void parseChunks(const Source& source)
+    {
+        BatchDispatcher batchDispatcher{ m_handler };
+        TokenBatcher<BatchDispatcher> batcher(batchDispatcher);
+        EventDispatcher dispatcher{ m_handler, batcher };
+        Tokenizer<EventDispatcher> tokenizer(dispatcher);
+
+        fireStart();
+        source([&tokenizer, &batcher](const char* data, std::size_t size)
+        {
+            batcher.beginChunk(data, size);
+            tokenizer.feed(data, size);
+            /* the chunk buffer is reused after return */
+            batcher.flush();
+        });
+        tokenizer.finish();
+        batcher.flush();
+        fireEnd();
+    }
+public:
+    explicit StaticSaxParser(Handler& handler): m_handler(handler)
+    {
+    }
+    /** Parse input string */
+    void parse(std::string_view input)
+    {
+        BatchDispatcher batchDispatcher{ m_handler };
+        TokenBatcher<BatchDispatcher> batcher(batchDispatcher);
+        EventDispatcher dispatcher{ m_handler, batcher };
+        Tokenizer<EventDispatcher> tokenizer(dispatcher);
+
+        fireStart();
+        batcher.beginChunk(input.data(), input.size());
+        tokenizer.feed(input.data(), input.size(), true);
+        batcher.flush();
+        fireEnd();
+    }
+    /** Parse input read chunk by chunk, see SaxParser::parse(const ChunkReader&, std::size_t) */
+    void parse(const ChunkReader& reader, std::size_t chunkSize = DEFAULT_CHUNK_SIZE)
+    {
+        parseChunks([&reader, chunkSize](const ChunkConsumer& consumer)
+        {
+            readChunks(reader, chunkSize, consumer);
+        });
+    }
+    /** Parse input stream chunk by chunk */
+    void parse(std::istream& input, std::size_t chunkSize = DEFAULT_CHUNK_SIZE)
+    {
+        parse(makeStreamReader(input), chunkSize);
+    }
+    /** Parse input read from file descriptor chunk by chunk until EOF */
+    void parseFd(int fd, std::size_t chunkSize = DEFAULT_CHUNK_SIZE)
+    {
+        parse(makeFdReader(fd), chunkSize);
+    }
+    /** Parse file without copying it, see SaxParser::parseFile() */
+    void parseFile(const std::string& path, std::size_t windowSize = DEFAULT_MAP_WINDOW_SIZE)
+    {
+        parseChunks([&path, windowSize](const ChunkConsumer& consumer)
+        {
+            readFile(path, windowSize, consumer);
+        });
+    }
+};
+
+/** Make a static parser deducing handler type */
+template<typename Handler>
+StaticSaxParser<Handler> makeStaticSaxParser(Handler& handler)
+{
+    return StaticSaxParser<Handler>(handler);
+}
+
+#endif /* STATICSAXPARSER_H */
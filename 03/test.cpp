@@ -1,10 +1,30 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <chrono>
+#include <cctype>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
 #include <vector>
 #include <utility>
 
+#include <unistd.h>
+
+#include "charclass.h"
+#include "chunkreader.h"
+#include "numparse.h"
 #include "saxparser.h"
+#include "saxtokens.h"
+#include "staticobservable.h"
+#include "staticsaxparser.h"
+#include "utf8.h"
+#include "wordcounter.h"
 
 /* basic tests for the Observable helper class */
 
@@ -93,6 +113,230 @@ bool testObservable()
     return true;
 }
 
+std::atomic<std::size_t> concurrentCounter1(0);
+std::atomic<std::size_t> concurrentCounter2(0);
+void concurrentListener1(std::size_t value)
+{
+    concurrentCounter1 += value;
+}
+void concurrentListener2(std::size_t value)
+{
+    concurrentCounter2 += value;
+}
+
+/* Test adding and removing listeners from another thread while events are fired */
+bool testObservableConcurrency()
+{
+    const std::size_t fireCount = 100000;
+    Observable<std::size_t> observable;
+    concurrentCounter1 = 0;
+    concurrentCounter2 = 0;
+    observable.addListener(concurrentListener1);
+    std::atomic<bool> isFiring(true);
+
+    std::thread mutator([&observable, &isFiring]()
+    {
+        while (isFiring)
+        {
+            auto handle = observable.addListener(concurrentListener2);
+            observable.removeListener(handle);
+            observable.addListener(concurrentListener2);
+            observable.removeListener(concurrentListener2);
+        }
+    });
+    for (std::size_t i = 0; i < fireCount; ++i)
+    {
+        observable.fireEvent(1);
+    }
+    {
+        Observable<std::size_t>::Reader reader(observable, 16);
+        for (std::size_t i = 0; i < fireCount; ++i)
+        {
+            reader.fireEvent(1);
+        }
+    }
+    isFiring = false;
+    mutator.join();
+
+    /* the permanent listener sees every event, the removed one no more after removal */
+    std::size_t count2 = concurrentCounter2;
+    observable.fireEvent(1);
+    return concurrentCounter1 == 2 * fireCount + 1 && concurrentCounter2 == count2 && observable.hasListeners();
+}
+
+/*
+ * Test that two pinned Readers with overlapping refresh windows, like readers on two consumer threads,
+ * don't hold back all replaced snapshots while listeners are added and removed
+ */
+bool testObservableOverlappingReaders()
+{
+    const std::size_t roundCount = 10000;
+    Observable<std::size_t> observable;
+    concurrentCounter1 = 0;
+    observable.addListener(concurrentListener1);
+    Observable<std::size_t>::Reader reader1(observable, 2);
+    Observable<std::size_t>::Reader reader2(observable, 3);
+    std::size_t maxRetiredCount = 0;
+    for (std::size_t i = 0; i < roundCount; ++i)
+    {
+        reader1.fireEvent(1);
+        auto handle = observable.addListener(concurrentListener2);
+        reader2.fireEvent(1);
+        observable.removeListener(handle);
+        maxRetiredCount = std::max(maxRetiredCount, observable.getRetiredCount());
+    }
+    /* at most the pinned snapshots and the entries removed since the older one was current */
+    return concurrentCounter1 == 2 * roundCount && maxRetiredCount <= 16;
+}
+
+/* Test O(1) removal by handle and compaction of removed listeners */
+bool testObservableHandles()
+{
+    Observable<> observable;
+    auto handle1 = observable.addListener(listener1);
+    auto handle2 = observable.addListener(listener2);
+    if (observable.addListener(listener1) != handle1)
+    {
+        return false;
+    }
+    counter = 0;
+    observable.removeListener(handle1);
+    observable.fireEvent();
+    if (counter != 5)
+    {
+        return false;
+    }
+    observable.removeListener(handle2);
+    observable.fireEvent();
+    if (counter != 5 || observable.hasListeners())
+    {
+        return false;
+    }
+    /* re-added listeners go after the removed entries, which must not be called */
+    observable.addListener(listener2);
+    observable.addListener(listener1);
+    counter = 0;
+    observable.fireEvent();
+    return counter == 18;
+}
+
+/* Stateful functor listener */
+struct CountingListener
+{
+    int count = 0;
+
+    void operator()()
+    {
+        ++count;
+    }
+};
+
+/* Object with a member function listener */
+struct MultiplyingListener
+{
+    int factor;
+
+    void onEvent()
+    {
+        counter *= factor;
+    }
+};
+
+/* basic tests for the StaticObservable helper class */
+bool testStaticObservable()
+{
+    counter = 0;
+    auto observable = makeStaticObservable(StaticListener<listener1>(), StaticListener<listener2>());
+    observable.fireEvent();
+    if (counter != 20)
+    {
+        return false;
+    }
+
+    counter = 1;
+    CountingListener external;
+    MultiplyingListener multiplier{ 7 };
+    auto mixed = makeStaticObservable(CountingListener(), std::ref(external),
+                                      bindMember<&MultiplyingListener::onEvent>(multiplier),
+                                      [](){ counter += 1; });
+    mixed.fireEvent();
+    mixed.fireEvent();
+    return mixed.getListener<0>().count == 2 && external.count == 2 && counter == 57;
+}
+
+/* Check a block classifier against std::isspace, std::isdigit and Unicode space leads on every byte value */
+bool testClassifier(CharClassifier classifier)
+{
+    char block[CHAR_BLOCK_SIZE];
+    for (unsigned int offset = 0; offset < 256; offset += CHAR_BLOCK_SIZE)
+    {
+        for (std::size_t i = 0; i < CHAR_BLOCK_SIZE; ++i)
+        {
+            block[i] = static_cast<char>(offset + i);
+        }
+        CharMasks masks = classifier(block);
+        CharMasks tailMasks = classifyTail(block, CHAR_BLOCK_SIZE - 1);
+        for (std::size_t i = 0; i < CHAR_BLOCK_SIZE; ++i)
+        {
+            unsigned char ch = static_cast<unsigned char>(block[i]);
+            bool isSpace = std::isspace(ch) != 0;
+            bool isDigit = std::isdigit(ch) != 0;
+            bool isSpaceLead = ch == 0xC2 || (ch >= 0xE1 && ch <= 0xE3);
+            if ((masks.space >> i & 1) != isSpace || (masks.digit >> i & 1) != isDigit
+                || (masks.spaceLead >> i & 1) != isSpaceLead)
+            {
+                return false;
+            }
+            bool inTail = i < CHAR_BLOCK_SIZE - 1;
+            if ((tailMasks.space >> i & 1) != (inTail && isSpace) || (tailMasks.digit >> i & 1) != (inTail && isDigit)
+                || (tailMasks.spaceLead >> i & 1) != (inTail && isSpaceLead))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Test all block classifiers supported by the CPU */
+bool testClassifiers()
+{
+    bool result = testClassifier(classifyBlockScalar) && testClassifier(classifyBlock);
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        result = result && testClassifier(classifyBlockSse42);
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        result = result && testClassifier(classifyBlockAvx2);
+    }
+#endif
+    return result;
+}
+
+/* Test SWAR digit conversion against std::stoul on every digit count */
+bool testDigitConversion()
+{
+    const char* digits = "9876543210123456";
+    for (std::size_t offset = 0; offset < 8; ++offset)
+    {
+        for (std::size_t count = 1; count <= SWAR_DIGIT_COUNT; ++count)
+        {
+            unsigned long expected = std::stoul(std::string(digits + offset, count));
+            if (parseDigits(digits + offset, count) != expected)
+            {
+                return false;
+            }
+        }
+        if (parseEightDigits(digits + offset) != std::stoul(std::string(digits + offset, SWAR_DIGIT_COUNT)))
+        {
+            return false;
+        }
+    }
+    return parseEightDigits("00000000") == 0 && parseEightDigits("99999999") == 99999999;
+}
+
 struct Word
 {
     const unsigned int idx;
@@ -290,6 +534,54 @@ const  ExpressionTestCase FIXTURES[] =
         {}, 
         true, SaxParser::ErrorCode::INPUT_OVERFLOW  
     },
+    {
+        "max, leading zeros", "000000000000000000000000018446744073709551615", 
+        {
+            { 0, 18446744073709551615UL }
+        },
+        {}, 
+        true, SaxParser::ErrorCode::INPUT_OVERFLOW  
+    },
+    {
+        "max + 1, leading zeros", "000000000000000000000000018446744073709551616", 
+        {},
+        {}, 
+        false, SaxParser::ErrorCode::INPUT_OVERFLOW  
+    },
+    {
+        "20 nines", "99999999999999999999", 
+        {},
+        {}, 
+        false, SaxParser::ErrorCode::INPUT_OVERFLOW  
+    },
+    {
+        "21 digits", "100000000000000000000", 
+        {},
+        {}, 
+        false, SaxParser::ErrorCode::INPUT_OVERFLOW  
+    },
+    {
+        "10^19", "10000000000000000000", 
+        {
+            { 0, 10000000000000000000UL }
+        },
+        {}, 
+        true, SaxParser::ErrorCode::INPUT_OVERFLOW  
+    },
+    {
+        "8 and 16 digits", "12345678 1234567890123456", 
+        {
+            { 0, 12345678 }, { 1, 1234567890123456 }
+        },
+        {}, 
+        true, SaxParser::ErrorCode::INPUT_OVERFLOW  
+    },
+    {
+        "Overflow before separation error", "18446744073709551616abc", 
+        {},
+        {}, 
+        false, SaxParser::ErrorCode::INPUT_OVERFLOW  
+    },
     {
         "Syntax error-0", "abba0", 
         {},
@@ -339,6 +631,32 @@ const  ExpressionTestCase FIXTURES[] =
     
 };
 
+/* Long input with tokens and whitespace runs of varying length, crossing many block and chunk boundaries */
+ExpressionTestCase createLongFixture()
+{
+    std::string input;
+    std::vector<Integer> integers;
+    std::vector<Word> words;
+    unsigned long value = 1;
+    for (unsigned int idx = 0; idx < 2000; ++idx)
+    {
+        input.append(idx % 7 ? idx % 5 + 1 : 70, idx % 3 ? ' ' : '\n');
+        if (idx % 2)
+        {
+            value = value * 7 + idx;
+            integers.push_back({ idx, value });
+            input += std::to_string(value);
+        }
+        else
+        {
+            std::string word(idx % 97 + 1, static_cast<char>('a' + idx % 26));
+            words.push_back({ idx, word });
+            input += word;
+        }
+    }
+    return { "Long input", input, integers, words, true, SaxParser::ErrorCode::INPUT_OVERFLOW };
+}
+
 /* Test state, essentually a closure for holding test results */
 struct TestState {
     bool onStartFired;
@@ -375,7 +693,7 @@ void onEnd()
     testState.onEndFired = true;
 }
 
-void onWordParsed(const std::string& word)
+void onWordParsed(std::string_view word)
 {
     for(auto it = testState.words->begin(); it != testState.words->end(); ++it)
     {
@@ -403,15 +721,18 @@ void onIntegerParsed(unsigned long value)
     return;
 }
 
+/** Parse method under test */
+typedef std::function<void(SaxParser&, const std::string&)> ParseMethod;
+
 /** Test an expression parsing */
-bool runExpressionTest(SaxParser& parser, const ExpressionTestCase& fixture)
+bool runExpressionTest(SaxParser& parser, const ExpressionTestCase& fixture, const ParseMethod& parse)
 {
     testState.clear();
     testState.words = &fixture.words;
     testState.integers = &fixture.integers;
     try 
     {
-        parser.parse(fixture.input);
+        parse(parser, fixture.input);
         return fixture.success && testState.isValid();
     } 
     catch (const SaxParser::ParserException& e)
@@ -420,12 +741,850 @@ bool runExpressionTest(SaxParser& parser, const ExpressionTestCase& fixture)
     }
 }
 
+/* Parse the whole string at once */
+void parseString(SaxParser& parser, const std::string& input)
+{
+    parser.parse(input);
+}
+
+/* Handler of the static parser, forwards events to the test listeners */
+struct TestHandler
+{
+    void onStart() { ::onStart(); }
+    void onEnd() { ::onEnd(); }
+    void onWord(std::string_view word) { onWordParsed(word); }
+    void onInt(unsigned long value) { onIntegerParsed(value); }
+};
+
+/* Parse the whole string with the static dispatch parser */
+void parseStatic(SaxParser&, const std::string& input)
+{
+    TestHandler handler;
+    StaticSaxParser<TestHandler> parser(handler);
+    parser.parse(input);
+}
+
+/* Handler with the word callback signature of SaxParser listeners */
+struct TestStringHandler
+{
+    void onStart() { ::onStart(); }
+    void onEnd() { ::onEnd(); }
+    void onWord(const std::string& word) { onWordParsed(word); }
+    void onInt(unsigned long value) { onIntegerParsed(value); }
+};
+
+/* Parse the whole string with the static dispatch parser and a std::string word handler */
+void parseStaticString(SaxParser&, const std::string& input)
+{
+    TestStringHandler handler;
+    StaticSaxParser<TestStringHandler> parser(handler);
+    parser.parse(input);
+}
+
+/* Pull tokens with the lazy iterator and pass them to the test listeners */
+void parsePull(SaxParser&, const std::string& input)
+{
+    onStart();
+    for (const Token& token : SaxTokens(input))
+    {
+        if (token.type == TokenType::WORD)
+        {
+            onWordParsed(std::string_view(token.text, token.length));
+        }
+        else
+        {
+            onIntegerParsed(token.value);
+        }
+    }
+    onEnd();
+}
+
+/* Test that the pull iterator stops early without touching the rest of input */
+bool testPullEarlyStop()
+{
+    const std::string input = "find the 42 answer and never reach 1x";
+    std::size_t wordCount = 0;
+    for (const Token& token : SaxTokens(input))
+    {
+        if (token.type == TokenType::INT)
+        {
+            return wordCount == 2 && token.value == 42 && token.offset == 9 && token.length == 2;
+        }
+        ++wordCount;
+    }
+    return false;
+}
+
+/* Parse a string stream with tiny chunks, so that tokens get split by chunk boundaries */
+ParseMethod parseStream(std::size_t chunkSize)
+{
+    return [chunkSize](SaxParser& parser, const std::string& input)
+    {
+        std::istringstream stream(input);
+        parser.parse(stream, chunkSize);
+    };
+}
+
+/* Parse input written to a pipe */
+void parsePipe(SaxParser& parser, const std::string& input)
+{
+    int fds[2];
+    if (pipe(fds))
+    {
+        throw std::runtime_error("Failed to create pipe");
+    }
+    /* fixtures are far smaller than the pipe buffer, so the write doesn't block */
+    bool written = write(fds[1], input.data(), input.size()) == static_cast<ssize_t>(input.size());
+    close(fds[1]);
+    try
+    {
+        if (written)
+        {
+            parser.parseFd(fds[0], 3);
+        }
+    }
+    catch (...)
+    {
+        close(fds[0]);
+        throw;
+    }
+    close(fds[0]);
+    if (!written)
+    {
+        throw std::runtime_error("Failed to write to pipe");
+    }
+}
+
+/* Parse input written to a temporary file with memory-mapped windows of given size */
+ParseMethod parseFile(std::size_t windowSize)
+{
+    return [windowSize](SaxParser& parser, const std::string& input)
+    {
+        char path[] = "/tmp/saxparserXXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to create temporary file");
+        }
+        bool written = write(fd, input.data(), input.size()) == static_cast<ssize_t>(input.size());
+        close(fd);
+        try
+        {
+            if (written)
+            {
+                parser.parseFile(path, windowSize);
+            }
+        }
+        catch (...)
+        {
+            unlink(path);
+            throw;
+        }
+        unlink(path);
+        if (!written)
+        {
+            throw std::runtime_error("Failed to write temporary file");
+        }
+    };
+}
+
+/* Parse input written to a pipe opened by path, so that it is read instead of mapped */
+void parsePipePath(SaxParser& parser, const std::string& input)
+{
+    int fds[2];
+    if (pipe(fds))
+    {
+        throw std::runtime_error("Failed to create pipe");
+    }
+    bool written = write(fds[1], input.data(), input.size()) == static_cast<ssize_t>(input.size());
+    close(fds[1]);
+    try
+    {
+        if (written)
+        {
+            parser.parseFile("/dev/fd/" + std::to_string(fds[0]), 3);
+        }
+    }
+    catch (...)
+    {
+        close(fds[0]);
+        throw;
+    }
+    close(fds[0]);
+    if (!written)
+    {
+        throw std::runtime_error("Failed to write to pipe");
+    }
+}
+
+/* Test that a missing file is reported */
+bool testMissingFile()
+{
+    SaxParser parser;
+    try
+    {
+        parser.parseFile("/nonexistent/saxparser/input");
+        return false;
+    }
+    catch (const std::system_error& e)
+    {
+        return e.code().value() == ENOENT;
+    }
+}
+
+/* Test that chunks come in order from a single reader thread and that failures on both sides are reported */
+bool testReadChunks()
+{
+    const std::size_t chunkCount = 100;
+    std::size_t readCount = 0;
+    std::thread::id readerThread;
+    bool isSingleThread = true;
+    ChunkReader reader = [&](char* buffer, std::size_t size) -> std::size_t
+    {
+        if (readCount == 0)
+            readerThread = std::this_thread::get_id();
+        isSingleThread = isSingleThread && readerThread == std::this_thread::get_id();
+        if (readCount == chunkCount)
+            return 0;
+        std::fill(buffer, buffer + size, static_cast<char>(readCount++));
+        return size;
+    };
+    std::size_t consumedCount = 0;
+    bool isOrdered = true;
+    readChunks(reader, 16, [&](const char* data, std::size_t size)
+    {
+        isOrdered = isOrdered && size == 16 && data[0] == static_cast<char>(consumedCount) && data[15] == data[0];
+        ++consumedCount;
+    });
+    if (consumedCount != chunkCount || !isOrdered || !isSingleThread || readerThread == std::this_thread::get_id())
+        return false;
+
+    /* the chunks before a failed read are consumed, then the failure is rethrown */
+    readCount = 0;
+    consumedCount = 0;
+    ChunkReader failingReader = [&](char*, std::size_t size) -> std::size_t
+    {
+        if (readCount++ == 3)
+            throw std::runtime_error("read failed");
+        return size;
+    };
+    try
+    {
+        readChunks(failingReader, 4, [&](const char*, std::size_t) { ++consumedCount; });
+        return false;
+    }
+    catch (const std::runtime_error&)
+    {
+        if (consumedCount != 3)
+            return false;
+    }
+
+    /* a failed consumer stops the reader thread */
+    readCount = 0;
+    try
+    {
+        readChunks(failingReader, 4, [](const char*, std::size_t) { throw std::logic_error("consume failed"); });
+        return false;
+    }
+    catch (const std::logic_error&)
+    {
+    }
+    return readCount <= 2;
+}
+
+/* Tokens received in batches with their texts copied */
+struct BatchedToken
+{
+    Token token;
+    std::string text;
+};
+std::vector<BatchedToken> batchedTokens;
+bool wrongBatch = false;
+
+void onTokensParsed(const Token* tokens, std::size_t count)
+{
+    if (!count || tokens[count - 1].offset - tokens[0].offset >= TOKEN_BATCH_INPUT_SIZE)
+    {
+        wrongBatch = true;
+    }
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const Token& token = tokens[i];
+        batchedTokens.push_back({ token, token.text ? std::string(token.text, token.length) : std::string() });
+    }
+}
+
+/* Test that batches contain every token in order with correct offsets */
+bool testBatches(const ExpressionTestCase& fixture, const ParseMethod& parse)
+{
+    SaxParser parser;
+    parser.addListenerOnTokensParsed(onTokensParsed);
+    batchedTokens.clear();
+    wrongBatch = false;
+    parse(parser, fixture.input);
+    if (wrongBatch || batchedTokens.size() != fixture.words.size() + fixture.integers.size())
+    {
+        return false;
+    }
+    for (const Word& word : fixture.words)
+    {
+        const BatchedToken& batched = batchedTokens[word.idx];
+        if (batched.token.type != TokenType::WORD || batched.text != word.value
+            || fixture.input.compare(batched.token.offset, batched.token.length, word.value))
+        {
+            return false;
+        }
+    }
+    for (const Integer& integer : fixture.integers)
+    {
+        const BatchedToken& batched = batchedTokens[integer.idx];
+        if (batched.token.type != TokenType::INT || batched.token.value != integer.value
+            || fixture.input.compare(batched.token.offset, batched.token.length, std::to_string(integer.value)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Parse the string on several threads with tiny segments */
+ParseMethod parseParallel(std::size_t threadCount, std::size_t segmentSize)
+{
+    return [threadCount, segmentSize](SaxParser& parser, const std::string& input)
+    {
+        parser.parseParallel(input, threadCount, segmentSize);
+    };
+}
+
+/* Test that errors are reported at the offset of the offending byte */
+bool testErrorOffsets(const ParseMethod& parse)
+{
+    const struct
+    {
+        const char* input;
+        SaxParser::ErrorCode errorCode;
+        std::size_t offset;
+    } cases[] = {
+        { "abba0", SaxParser::ErrorCode::TOKENS_NOT_SEPARATED, 4 },
+        { "word 12 17x", SaxParser::ErrorCode::TOKENS_NOT_SEPARATED, 10 },
+        { "18446744073709551616", SaxParser::ErrorCode::INPUT_OVERFLOW, 19 },
+        { "a b c d e f g h i j k l m n o p 0 1844674407370955161500", SaxParser::ErrorCode::INPUT_OVERFLOW, 54 },
+    };
+    SaxParser parser;
+    for (const auto& testCase : cases)
+    {
+        try
+        {
+            parse(parser, testCase.input);
+            return false;
+        }
+        catch (const SaxParser::ParserException& e)
+        {
+            if (e.errorCode != testCase.errorCode || e.offset != testCase.offset)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::atomic<std::size_t> unorderedTokenCount(0);
+
+void onTokensParsedUnordered(const Token*, std::size_t count)
+{
+    unorderedTokenCount += count;
+}
+
+/* Test that unordered batch listeners receive every token */
+bool testUnorderedBatches(const ExpressionTestCase& fixture)
+{
+    SaxParser parser;
+    parser.addListenerOnTokensParsedUnordered(onTokensParsedUnordered);
+    unorderedTokenCount = 0;
+    parser.parseParallel(fixture.input, 4, 100);
+    if (unorderedTokenCount != fixture.words.size() + fixture.integers.size())
+    {
+        return false;
+    }
+    unorderedTokenCount = 0;
+    parser.parse(fixture.input);
+    return unorderedTokenCount == fixture.words.size() + fixture.integers.size();
+}
+
+std::size_t unorderedFailureOffset = 0;
+
+/* Unordered batch listener that fails on a batch reaching unorderedFailureOffset */
+void onTokensParsedUnorderedThrowing(const Token* tokens, std::size_t count)
+{
+    if (tokens[count - 1].offset >= unorderedFailureOffset)
+    {
+        throw std::runtime_error("Unordered listener failed");
+    }
+}
+
+/* Test that an exception of an unordered batch listener reaches the caller of the parallel parser like of parse() */
+bool testThrowingUnorderedListener(const ExpressionTestCase& fixture)
+{
+    SaxParser parser;
+    parser.addListenerOnTokensParsedUnordered(onTokensParsedUnorderedThrowing);
+    unorderedFailureOffset = fixture.input.size() / 2;
+    for (const ParseMethod& method : { ParseMethod(parseString), parseParallel(4, 100) })
+    {
+        try
+        {
+            method(parser, fixture.input);
+            return false;
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+    }
+    return true;
+}
+
+/* Handler of the static parser that only listens to batches */
+struct BatchHandler
+{
+    void onTokens(const Token* tokens, std::size_t count) { onTokensParsed(tokens, count); }
+};
+
+/* Parse the whole string with the static dispatch parser delivering batches */
+void parseStaticBatches(SaxParser&, const std::string& input)
+{
+    BatchHandler handler;
+    StaticSaxParser<BatchHandler> parser(handler);
+    parser.parse(input);
+}
+
+/* Parse with listeners called on separate threads through a tiny queue */
+ParseMethod parseAsync(std::size_t consumerCount, const ParseMethod& parse)
+{
+    return [consumerCount, parse](SaxParser& parser, const std::string& input)
+    {
+        parser.setAsyncDispatch(consumerCount, 2);
+        try
+        {
+            parse(parser, input);
+        }
+        catch (...)
+        {
+            parser.setAsyncDispatch(0);
+            throw;
+        }
+        parser.setAsyncDispatch(0);
+    };
+}
+
+std::size_t slowTokenCount = 0;
+
+void onSlowWordParsed(std::string_view word)
+{
+    if (word == "stop")
+    {
+        throw std::runtime_error("listener failure");
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+    ++slowTokenCount;
+}
+
+/* Test that async dispatch waits for a slow listener and rethrows its exception */
+bool testAsyncListeners(const ExpressionTestCase& fixture)
+{
+    SaxParser parser;
+    parser.setAsyncDispatch(2, 1);
+    parser.addListenerOnWordParsed(onSlowWordParsed);
+    slowTokenCount = 0;
+    parser.parse(fixture.input);
+    if (slowTokenCount != fixture.words.size())
+    {
+        return false;
+    }
+    try
+    {
+        parser.parse(fixture.input + " stop " + fixture.input);
+        return false;
+    }
+    catch (const std::runtime_error& e)
+    {
+        return std::string(e.what()) == "listener failure";
+    }
+}
+
+std::vector<WordCounter::WordId> countedIds;
+
+void onWordCounted(WordCounter::WordId id)
+{
+    countedIds.push_back(id);
+}
+
+/* Test that counts of a word counter match the fixture words */
+bool checkWordCounts(const WordCounter& counter, const ExpressionTestCase& fixture)
+{
+    std::map<std::string, std::uint64_t> expected;
+    for (const Word& word : fixture.words)
+    {
+        ++expected[word.value];
+    }
+    if (counter.size() != expected.size() || counter.getTotalCount() != fixture.words.size())
+    {
+        return false;
+    }
+    for (const auto& word : expected)
+    {
+        WordCounter::WordId id = counter.find(word.first);
+        if (id == WordCounter::NO_WORD || counter.getWord(id) != word.first || counter.getCount(id) != word.second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Test word interning, counting, merging and top-K extraction */
+bool testWordCounter(const ExpressionTestCase& fixture)
+{
+    WordCounter counter;
+    countedIds.clear();
+    counter.addListenerOnWordCounted(onWordCounted);
+    StaticSaxParser<WordCounter> parser(counter);
+    parser.parse(fixture.input);
+    if (!checkWordCounts(counter, fixture) || countedIds.size() != fixture.words.size())
+    {
+        return false;
+    }
+    /* ids are dense and given in order of first occurrence */
+    WordCounter::WordId nextId = 0;
+    for (std::size_t i = 0; i < countedIds.size(); ++i)
+    {
+        if (countedIds[i] > nextId || counter.getWord(countedIds[i]) != fixture.words[i].value)
+        {
+            return false;
+        }
+        nextId = std::max(nextId, countedIds[i] + 1);
+    }
+    if (counter.find("absent") != WordCounter::NO_WORD || counter.getCount("absent"))
+    {
+        return false;
+    }
+
+    /* many distinct words make the table grow, long ones go to separate arena blocks */
+    WordCounter grown;
+    std::string longWord(100000, 'x');
+    for (unsigned long i = 0; i < 20000; ++i)
+    {
+        grown.add(std::to_string(i), i % 3 + 1);
+        grown.add(longWord);
+    }
+    if (grown.size() != 20001 || grown.getCount("19999") != 2 || grown.getCount(longWord) != 20000
+        || grown.getWord(grown.find("12345")) != "12345")
+    {
+        return false;
+    }
+
+    WordCounter left;
+    left.add("b", 2);
+    left.add("a", 2);
+    left.add("c");
+    WordCounter right;
+    right.add("d", 3);
+    right.add("c", 2);
+    left.merge(right);
+    std::vector<WordCounter::WordId> top = left.top(3);
+    if (left.find("b") != 0 || top.size() != 3 || left.getWord(top[0]) != "c" || left.getWord(top[1]) != "d"
+        || left.getWord(top[2]) != "a" || left.top(10).size() != 4 || left.getTotalCount() != 10)
+    {
+        return false;
+    }
+
+    for (std::size_t threadCount : { 1, 2, 3, 8 })
+    {
+        if (!checkWordCounts(WordCounter::countParallel(fixture.input, threadCount), fixture))
+        {
+            return false;
+        }
+    }
+    std::vector<WordCounter> parts(5);
+    for (std::size_t i = 0; i < fixture.words.size(); ++i)
+    {
+        parts[i % parts.size()].add(fixture.words[i].value);
+    }
+    WordCounter::mergeAll(parts, 2);
+    if (parts.size() != 1 || !checkWordCounts(parts.front(), fixture))
+    {
+        return false;
+    }
+    try
+    {
+        WordCounter::countParallel(fixture.input + " 12 17x " + fixture.input + " 3y", 4);
+        return false;
+    }
+    catch (const ParserException& e)
+    {
+        return e.errorCode == ParserErrorCode::TOKENS_NOT_SEPARATED && e.offset == fixture.input.size() + 6;
+    }
+}
+
 /** Test suit */
+/* Test the vectorized and the streaming UTF-8 validators against the scalar one */
+bool testUtf8Validation()
+{
+    const std::string padding(40, 'a');
+    const struct
+    {
+        std::string input;
+        std::size_t invalidOffset; /* size if valid */
+    } cases[] = {
+        { "", 0 },
+        { "plain ascii", 11 },
+        { "\xC3\xA4 \xE6\x97\xA5\xE6\x9C\xAC \xF0\x9F\x98\x80", 14 },
+        { "\xFF", 0 },
+        { "\x80 stray continuation", 0 },
+        { "caf\xC3", 3 },
+        { "a \xE2\x82 b", 2 },
+        { "\xC0\xAF overlong", 0 },
+        { "\xE0\x80\xAF overlong", 0 },
+        { "\xF0\x80\x80\xAF overlong", 0 },
+        { "\xED\xA0\x80 surrogate", 0 },
+        { "\xF4\x90\x80\x80 too large", 0 },
+        { "\xF5\x80\x80\x80", 0 },
+        { padding + "\xE6\x97\xA5\xE6\x9C\xAC" + padding, 86 },
+        { padding + "\xE6\x97\xA5\xE6\x9C", 43 },
+        { padding + "\xE6\x97\xA5\x9C" + padding, 43 },
+        { padding + padding + "\xF0\x9F\x98\x80\xC3", 84 },
+    };
+    for (const auto& testCase : cases)
+    {
+        const char* data = testCase.input.data();
+        const std::size_t size = testCase.input.size();
+        if (validateUtf8Scalar(data, size) != testCase.invalidOffset || validateUtf8(data, size) != testCase.invalidOffset)
+        {
+            return false;
+        }
+        for (std::size_t chunkSize : { 1, 2, 3, 5, 16 })
+        {
+            Utf8StreamValidator validator;
+            std::size_t invalid = Utf8StreamValidator::VALID;
+            for (std::size_t i = 0; i < size && invalid == Utf8StreamValidator::VALID; i += chunkSize)
+            {
+                invalid = validator.feed(data + i, std::min(chunkSize, size - i));
+            }
+            if (invalid == Utf8StreamValidator::VALID)
+            {
+                invalid = validator.feed("", 0, true);
+            }
+            if (invalid != (testCase.invalidOffset == size ? Utf8StreamValidator::VALID : testCase.invalidOffset))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Expected token of the extended grammar */
+struct ExtendedToken
+{
+    TokenType type;
+    std::size_t offset;
+    std::string text; /* token characters, numbers are checked against their conversion */
+};
+
+/* Input of the extended grammar with expected tokens */
+struct ExtendedTestCase
+{
+    std::string input;
+    std::vector<ExtendedToken> tokens;
+};
+
+/* Long input with signed and decimal numbers, UTF-8 words and Unicode whitespace */
+ExtendedTestCase createExtendedFixture()
+{
+    const char* separators[] = { " ", "\n", "\xC2\xA0", "\xE3\x80\x80", "\xE2\x80\xA8", " \xE2\x80\x89\t" };
+    const char* words[] = { "\xC3\xA4rger", "\xE6\x97\xA5\xE6\x9C\xAC", "\xD0\xBC\xD0\xB8\xD1\x80", "plain",
+                            "\xF0\x9F\x98\x80", "-", "+", "-dash", "e", "inf" };
+    const char* numbers[] = { "0", "18446744073709551615", "-9223372036854775808", "+9223372036854775807", "-0",
+                              "3.25", "-0.5", "+1e10", "6.02214076e23", "1.", "2E-3", "-1.7976931348623157e308" };
+    ExtendedTestCase fixture;
+    for (std::size_t idx = 0; idx < 600; ++idx)
+    {
+        fixture.input += separators[idx % 6];
+        const std::size_t offset = fixture.input.size();
+        if (idx % 3)
+        {
+            const std::string word = words[idx % 10];
+            fixture.tokens.push_back({ TokenType::WORD, offset, word });
+            fixture.input += word;
+        }
+        else
+        {
+            const std::string number = numbers[idx / 3 % 12];
+            const bool isDecimal = number.find_first_of(".eE") != std::string::npos;
+            const bool isSigned = number[0] == '-' || number[0] == '+';
+            fixture.tokens.push_back({ isDecimal ? TokenType::DECIMAL : isSigned ? TokenType::SIGNED_INT : TokenType::INT,
+                                       offset, number });
+            fixture.input += number;
+        }
+    }
+    return fixture;
+}
+
+std::vector<long> signedValues;
+std::vector<double> decimalValues;
+
+void onSignedIntParsed(long value)
+{
+    signedValues.push_back(value);
+}
+
+void onDecimalParsed(double value)
+{
+    decimalValues.push_back(value);
+}
+
+/* Check that a batched token carries the expected value */
+bool isExpectedToken(const BatchedToken& batched, const ExtendedToken& expected)
+{
+    const Token& token = batched.token;
+    if (token.type != expected.type || token.offset != expected.offset || token.length != expected.text.size())
+    {
+        return false;
+    }
+    switch (token.type)
+    {
+        case TokenType::WORD:
+            return batched.text == expected.text;
+        case TokenType::INT:
+            return token.value == std::stoul(expected.text);
+        case TokenType::SIGNED_INT:
+            return token.signedValue == std::stol(expected.text);
+        case TokenType::DECIMAL:
+            return token.decimalValue == std::strtod(expected.text.c_str(), nullptr);
+    }
+    return false;
+}
+
+/* Test that the extended grammar yields every token in order, in batches and to per-token listeners */
+bool testExtendedGrammar(const ExtendedTestCase& fixture, const ParseMethod& parse)
+{
+    SaxParser parser;
+    parser.setExtendedGrammar(true);
+    parser.addListenerOnTokensParsed(onTokensParsed);
+    parser.addListenerOnSignedIntParsed(onSignedIntParsed);
+    parser.addListenerOnDecimalParsed(onDecimalParsed);
+    batchedTokens.clear();
+    signedValues.clear();
+    decimalValues.clear();
+    wrongBatch = false;
+    parse(parser, fixture.input);
+    if (wrongBatch || batchedTokens.size() != fixture.tokens.size())
+    {
+        return false;
+    }
+    std::size_t signedCount = 0;
+    std::size_t decimalCount = 0;
+    for (std::size_t i = 0; i < fixture.tokens.size(); ++i)
+    {
+        const Token& token = batchedTokens[i].token;
+        if (!isExpectedToken(batchedTokens[i], fixture.tokens[i])
+            || (token.type == TokenType::SIGNED_INT
+                && (signedCount >= signedValues.size() || signedValues[signedCount++] != token.signedValue))
+            || (token.type == TokenType::DECIMAL
+                && (decimalCount >= decimalValues.size() || decimalValues[decimalCount++] != token.decimalValue)))
+        {
+            return false;
+        }
+    }
+    return signedCount == signedValues.size() && decimalCount == decimalValues.size();
+}
+
+std::atomic<std::size_t> extendedTokenCount(0);
+
+void onExtendedWordParsed(std::string_view)
+{
+    ++extendedTokenCount;
+}
+
+void onExtendedNumberParsed(long)
+{
+    ++extendedTokenCount;
+}
+
+void onExtendedDecimalParsed(double)
+{
+    ++extendedTokenCount;
+}
+
+/* Test that extended grammar errors are reported at the offending byte after the preceding tokens */
+bool testExtendedErrorOffsets(const ParseMethod& parse)
+{
+    const std::string padding(100, 'a');
+    const struct
+    {
+        std::string input;
+        SaxParser::ErrorCode errorCode;
+        std::size_t offset;
+        std::size_t tokenCount; /* tokens preceding the error */
+    } cases[] = {
+        { "caf\xC3", SaxParser::ErrorCode::INVALID_UTF8, 3, 0 },
+        { "ok \xFF bad", SaxParser::ErrorCode::INVALID_UTF8, 3, 1 },
+        { "a \xE2\x82 b", SaxParser::ErrorCode::INVALID_UTF8, 2, 1 },
+        { "x \xED\xA0\x80", SaxParser::ErrorCode::INVALID_UTF8, 2, 1 },
+        { padding + " -1.5 \xE6\x97\xA5 word\xC0\xAF", SaxParser::ErrorCode::INVALID_UTF8, 114, 3 },
+        { "-9223372036854775809", SaxParser::ErrorCode::INPUT_OVERFLOW, 19, 0 },
+        { "+18446744073709551616", SaxParser::ErrorCode::INPUT_OVERFLOW, 20, 0 },
+        { "-1 1e400", SaxParser::ErrorCode::INPUT_OVERFLOW, 3, 1 },
+        { "w 1.5x", SaxParser::ErrorCode::TOKENS_NOT_SEPARATED, 5, 1 },
+        { "-12ab", SaxParser::ErrorCode::TOKENS_NOT_SEPARATED, 3, 0 },
+        { "\xD0\xBC\xD0\xB8\xD1\x80" "1", SaxParser::ErrorCode::TOKENS_NOT_SEPARATED, 6, 0 },
+    };
+    SaxParser parser;
+    parser.setExtendedGrammar(true);
+    parser.addListenerOnWordParsed(onExtendedWordParsed);
+    parser.addListenerOnSignedIntParsed(onExtendedNumberParsed);
+    parser.addListenerOnDecimalParsed(onExtendedDecimalParsed);
+    for (const auto& testCase : cases)
+    {
+        extendedTokenCount = 0;
+        try
+        {
+            parse(parser, testCase.input);
+            return false;
+        }
+        catch (const SaxParser::ParserException& e)
+        {
+            if (e.errorCode != testCase.errorCode || e.offset != testCase.offset
+                || extendedTokenCount != testCase.tokenCount)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 void runTests() {
     std::cout << "Test run started." << std::endl;
     if (!testObservable())
         std::cout << "Observable template test failed" << std::endl;
     
+    if (!testObservableHandles())
+        std::cout << "Observable handle test failed" << std::endl;
+    if (!testObservableConcurrency())
+        std::cout << "Observable concurrency test failed" << std::endl;
+    if (!testObservableOverlappingReaders())
+        std::cout << "Observable overlapping readers test failed" << std::endl;
+    if (!testStaticObservable())
+        std::cout << "StaticObservable template test failed" << std::endl;
+    if (!testDigitConversion())
+        std::cout << "Digit conversion test failed" << std::endl;
+    if (!testClassifiers())
+        std::cout << "Character classifier test failed" << std::endl;
+    if (!testUtf8Validation())
+        std::cout << "UTF-8 validation test failed" << std::endl;
+    if (!testReadChunks())
+        std::cout << "Chunk reader test failed" << std::endl;
+
     TestState testState;
     
     SaxParser parser;
@@ -435,8 +1594,97 @@ void runTests() {
     parser.addListenerOnIntParsed(onIntegerParsed);
 
     for (ExpressionTestCase fixture : FIXTURES)
-        if(!runExpressionTest(parser, fixture))
+        if(!runExpressionTest(parser, fixture, parseString))
             std::cout << "Expression test \"" << fixture.name << "\" failed." << std::endl;
+    const ExpressionTestCase longFixture = createLongFixture();
+    if(!runExpressionTest(parser, longFixture, parseString))
+        std::cout << "Expression test \"" << longFixture.name << "\" failed." << std::endl;
+    for (std::size_t chunkSize : { 1, 63, 64, 100, 4096 })
+        if(!runExpressionTest(parser, longFixture, parseStream(chunkSize)))
+            std::cout << "Stream test \"" << longFixture.name << "\" with chunk size " << chunkSize << " failed." << std::endl;
+    for (ExpressionTestCase fixture : FIXTURES)
+        if(!runExpressionTest(parser, fixture, parsePull))
+            std::cout << "Pull iterator test \"" << fixture.name << "\" failed." << std::endl;
+    if(!runExpressionTest(parser, longFixture, parsePull))
+        std::cout << "Pull iterator test \"" << longFixture.name << "\" failed." << std::endl;
+    if (!testErrorOffsets(parsePull))
+        std::cout << "Pull iterator error offset test failed." << std::endl;
+    if (!testPullEarlyStop())
+        std::cout << "Pull iterator early stop test failed." << std::endl;
+    for (ExpressionTestCase fixture : FIXTURES)
+        if(!runExpressionTest(parser, fixture, parseStatic))
+            std::cout << "Static parser test \"" << fixture.name << "\" failed." << std::endl;
+    for (ExpressionTestCase fixture : FIXTURES)
+        if(!runExpressionTest(parser, fixture, parseStaticString))
+            std::cout << "Static parser std::string handler test \"" << fixture.name << "\" failed." << std::endl;
+    if (!testBatches(longFixture, parseString) || !testBatches(longFixture, parseStaticBatches))
+        std::cout << "Token batch test failed." << std::endl;
+    for (std::size_t chunkSize : { 1, 7, 4096, 5000 })
+        if (!testBatches(longFixture, parseStream(chunkSize)))
+            std::cout << "Token batch test with chunk size " << chunkSize << " failed." << std::endl;
+    for (std::size_t segmentSize : { 1, 7, 100 })
+    {
+        for (ExpressionTestCase fixture : FIXTURES)
+            if(!runExpressionTest(parser, fixture, parseParallel(4, segmentSize)))
+                std::cout << "Parallel test \"" << fixture.name << "\" with segment size " << segmentSize << " failed." << std::endl;
+        if(!runExpressionTest(parser, longFixture, parseParallel(4, segmentSize)))
+            std::cout << "Parallel test \"" << longFixture.name << "\" with segment size " << segmentSize << " failed." << std::endl;
+        if (!testBatches(longFixture, parseParallel(3, segmentSize)))
+            std::cout << "Parallel token batch test with segment size " << segmentSize << " failed." << std::endl;
+    }
+    if (!testUnorderedBatches(longFixture))
+        std::cout << "Unordered token batch test failed." << std::endl;
+    if (!testThrowingUnorderedListener(longFixture))
+        std::cout << "Throwing unordered listener test failed." << std::endl;
+    if (!testErrorOffsets(parseString) || !testErrorOffsets(parseStream(3)) || !testErrorOffsets(parseParallel(4, 2)))
+        std::cout << "Error offset test failed." << std::endl;
+    for (ExpressionTestCase fixture : FIXTURES)
+        if(!runExpressionTest(parser, fixture, parseFile(DEFAULT_MAP_WINDOW_SIZE)) || !runExpressionTest(parser, fixture, parsePipePath))
+            std::cout << "File test \"" << fixture.name << "\" failed." << std::endl;
+    if(!runExpressionTest(parser, longFixture, parseFile(1)) || !testBatches(longFixture, parseFile(1))
+        || !runExpressionTest(parser, longFixture, parseAsync(2, parseFile(1))))
+        std::cout << "File test \"" << longFixture.name << "\" with page-sized windows failed." << std::endl;
+    if (!testErrorOffsets(parseFile(1)) || !testMissingFile())
+        std::cout << "File error test failed." << std::endl;
+    for (std::size_t consumerCount : { 1, 2 })
+    {
+        for (ExpressionTestCase fixture : FIXTURES)
+            if(!runExpressionTest(parser, fixture, parseAsync(consumerCount, parseString)))
+                std::cout << "Async test \"" << fixture.name << "\" with " << consumerCount << " threads failed." << std::endl;
+        if(!runExpressionTest(parser, longFixture, parseAsync(consumerCount, parseStream(7)))
+            || !runExpressionTest(parser, longFixture, parseAsync(consumerCount, parseParallel(3, 100))))
+            std::cout << "Async test \"" << longFixture.name << "\" with " << consumerCount << " threads failed." << std::endl;
+        if (!testBatches(longFixture, parseAsync(consumerCount, parseString))
+            || !testBatches(longFixture, parseAsync(consumerCount, parseStream(7)))
+            || !testBatches(longFixture, parseAsync(consumerCount, parseParallel(3, 7))))
+            std::cout << "Async token batch test with " << consumerCount << " threads failed." << std::endl;
+        if (!testErrorOffsets(parseAsync(consumerCount, parseString))
+            || !testErrorOffsets(parseAsync(consumerCount, parseParallel(4, 2))))
+            std::cout << "Async error offset test with " << consumerCount << " threads failed." << std::endl;
+    }
+    if (!testWordCounter(longFixture))
+        std::cout << "Word counter test failed." << std::endl;
+    if (!testAsyncListeners(longFixture))
+        std::cout << "Async listener test failed." << std::endl;
+    const ExtendedTestCase extendedFixture = createExtendedFixture();
+    for (const ParseMethod& parse : { ParseMethod(parseString), parseStream(1), parseStream(3), parseStream(64),
+                                      parseFile(1), ParseMethod(parsePipe), parseParallel(4, 7),
+                                      parseAsync(2, parseStream(7)), parseAsync(2, parseParallel(3, 7)) })
+    {
+        if (!testExtendedGrammar(extendedFixture, parse))
+            std::cout << "Extended grammar test failed." << std::endl;
+    }
+    if (!testExtendedErrorOffsets(parseString) || !testExtendedErrorOffsets(parseStream(1))
+        || !testExtendedErrorOffsets(parseStream(3)) || !testExtendedErrorOffsets(parseFile(1))
+        || !testExtendedErrorOffsets(parseParallel(4, 2)) || !testExtendedErrorOffsets(parseAsync(2, parseString)))
+        std::cout << "Extended grammar error offset test failed." << std::endl;
+    for (std::size_t chunkSize : { 1, 2, 5, 64 })
+        for (ExpressionTestCase fixture : FIXTURES)
+            if(!runExpressionTest(parser, fixture, parseStream(chunkSize)))
+                std::cout << "Stream test \"" << fixture.name << "\" with chunk size " << chunkSize << " failed." << std::endl;
+    for (ExpressionTestCase fixture : FIXTURES)
+        if(!runExpressionTest(parser, fixture, parsePipe))
+            std::cout << "Pipe test \"" << fixture.name << "\" failed." << std::endl;
     std::cout << "Test run completed." << std::endl;
 }
 
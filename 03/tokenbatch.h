@@ -0,0 +1,114 @@
+#ifndef TOKENBATCH_H
+#define TOKENBATCH_H
+
+#include <cstdint>
+#include <string_view>
+
+/* Type of a parsed token */
+enum class TokenType : std::uint8_t
+{
+    WORD,
+    INT,
+    SIGNED_INT, /* extended grammar only */
+    DECIMAL     /* extended grammar only */
+};
+
+/* Parsed token as an element of a batch */
+struct Token
+{
+    TokenType type;
+    std::size_t offset;  /* position of the token from the beginning of input */
+    std::size_t length;  /* token length in bytes */
+    union
+    {
+        unsigned long value; /* integer value, zero for words */
+        long signedValue;    /* value of a signed integer */
+        double decimalValue; /* value of a decimal number */
+    };
+    const char* text;    /* word characters, nullptr for numbers; valid during the batch callback */
+};
+
+/* Input span covered by one batch */
+const std::size_t TOKEN_BATCH_INPUT_SIZE = 4096;
+/* Maximal token count in a batch */
+const std::size_t TOKEN_BATCH_CAPACITY = 1024;
+
+/**
+ * Tokenizer handler that collects tokens into batches.
+ *
+ * A batch is passed to the sink, a callable (const Token* tokens, std::size_t count),
+ * when it covers TOKEN_BATCH_INPUT_SIZE bytes of input or gets full.
+ * Word texts point into the input chunk, so the owner must call flush()
+ * before the chunk buffer is reused. Words collected from a carry-over buffer
+ * are flushed immediately for the same reason.
+ */
+template<typename Sink> class TokenBatcher
+{
+private:
+    Sink& m_sink;                         /* batch consumer */
+    Token m_tokens[TOKEN_BATCH_CAPACITY]; /* current batch */
+    std::size_t m_count;                  /* token count in the current batch */
+    std::size_t m_batchOffset;            /* input offset of the first token of the current batch */
+    const char* m_chunkBegin;             /* current input chunk */
+    const char* m_chunkEnd;
+
+    void push(const Token& token)
+    {
+        if (m_count == TOKEN_BATCH_CAPACITY || (m_count && token.offset - m_batchOffset >= TOKEN_BATCH_INPUT_SIZE))
+        {
+            flush();
+        }
+        if (!m_count)
+        {
+            m_batchOffset = token.offset;
+        }
+        m_tokens[m_count++] = token;
+    }
+public:
+    explicit TokenBatcher(Sink& sink): m_sink(sink), m_count(0), m_batchOffset(0), m_chunkBegin(nullptr), m_chunkEnd(nullptr)
+    {
+    }
+    TokenBatcher(const TokenBatcher&) = delete;
+    TokenBatcher& operator=(const TokenBatcher&) = delete;
+    /** Set the input chunk words will point into */
+    void beginChunk(const char* data, std::size_t size)
+    {
+        m_chunkBegin = data;
+        m_chunkEnd = data + size;
+    }
+    /** Pass collected tokens to the sink */
+    void flush()
+    {
+        if (m_count)
+        {
+            m_sink(static_cast<const Token*>(m_tokens), m_count);
+            m_count = 0;
+        }
+    }
+    void onWord(std::string_view word, std::size_t offset)
+    {
+        push({ TokenType::WORD, offset, word.size(), 0, word.data() });
+        if (word.data() < m_chunkBegin || word.data() >= m_chunkEnd)
+        {
+            flush();
+        }
+    }
+    void onInt(unsigned long value, std::size_t offset, std::size_t length)
+    {
+        push({ TokenType::INT, offset, length, value, nullptr });
+    }
+    void onSignedInt(long value, std::size_t offset, std::size_t length)
+    {
+        Token token = { TokenType::SIGNED_INT, offset, length, 0, nullptr };
+        token.signedValue = value;
+        push(token);
+    }
+    void onDecimal(double value, std::size_t offset, std::size_t length)
+    {
+        Token token = { TokenType::DECIMAL, offset, length, 0, nullptr };
+        token.decimalValue = value;
+        push(token);
+    }
+};
+
+#endif /* TOKENBATCH_H */
@@ -0,0 +1,226 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "charclass.h"
+#include "numparse.h"
+#include "parsererror.h"
+
+/**
+ * Incremental tokenizer.
+ *
+ * Input may be fed in chunks of arbitrary size, the tokenizer keeps its state between them.
+ * Every 64-byte block is classified at once (see charclass.h), token boundaries are found
+ * with bit scans over the class masks instead of a per-byte state switch.
+ * Found tokens are passed to a handler which must provide
+ *     void onWord(std::string_view word, std::size_t offset);
+ *     void onInt(unsigned long value, std::size_t offset, std::size_t length);
+ * where offset is the position of the token from the beginning of the whole input.
+ * A word view points into the fed chunk, or into the carry-over buffer if the word
+ * was split by a chunk boundary. It is valid only during the handler call.
+ */
+template<typename Handler> class Tokenizer
+{
+private:
+    /* tokenizer state */
+    enum CharType
+    {
+        NONE,
+        DIGIT,
+        LETTER
+    };
+
+    Handler& m_handler;      /* token consumer */
+    CharType m_charType;     /* type of the token being read */
+    unsigned long m_intValue; /* value of the integer being read */
+    std::string m_carry;     /* beginning of the word split by a chunk boundary */
+    std::size_t m_position;  /* offset of the current chunk from the beginning of input */
+    std::size_t m_tokenOffset; /* offset of the token being read from the beginning of input */
+
+    /* Fire word which ends at end of the chunk prefix */
+    void fireWord(const char* data, std::size_t wordStartIdx, std::size_t wordEndIdx)
+    {
+        if (m_carry.empty())
+        {
+            m_handler.onWord(std::string_view(data + wordStartIdx, wordEndIdx - wordStartIdx), m_tokenOffset);
+        }
+        else
+        {
+            m_carry.append(data + wordStartIdx, wordEndIdx - wordStartIdx);
+            m_handler.onWord(m_carry, m_tokenOffset);
+            m_carry.clear();
+        }
+    }
+public:
+    explicit Tokenizer(Handler& handler, std::size_t position = 0): m_handler(handler), m_charType(CharType::NONE),
+        m_intValue(0), m_position(position), m_tokenOffset(0)
+    {
+    }
+    /** Drop the state left by a previous input, next chunk starts at given input offset */
+    void reset(std::size_t position = 0)
+    {
+        m_charType = CharType::NONE;
+        m_carry.clear();
+        m_position = position;
+    }
+    /** Offset of the next chunk from the beginning of input */
+    std::size_t getPosition() const
+    {
+        return m_position;
+    }
+    /**
+     * Parse next chunk of input.
+     * If the chunk is known to be the last one, the trailing token is fired without copying.
+     */
+    void feed(const char* data, std::size_t size, bool isLast = false);
+    /** Flush the token that lasts until the end of input */
+    void finish()
+    {
+        switch (m_charType)
+        {
+            case CharType::DIGIT:
+                m_handler.onInt(m_intValue, m_tokenOffset, m_position - m_tokenOffset);
+                break;
+            case CharType::LETTER:
+                m_handler.onWord(m_carry, m_tokenOffset);
+                m_carry.clear();
+                break;
+            default:
+                break;
+        }
+        m_charType = CharType::NONE;
+    }
+};
+
+/**
+ * Split input into segments of about segmentSize bytes that may be tokenized independently.
+ * Returns segment bounds, the first one is zero and the last one is the input size;
+ * every inner bound is the offset of a whitespace byte.
+ */
+inline std::vector<std::size_t> splitAtWhitespace(std::string_view input, std::size_t segmentSize)
+{
+    std::vector<std::size_t> bounds = { 0 };
+    std::size_t position = segmentSize;
+    while (position < input.size())
+    {
+        while (position < input.size() && !std::isspace(static_cast<unsigned char>(input[position])))
+        {
+            ++position;
+        }
+        if (position >= input.size())
+        {
+            break;
+        }
+        bounds.push_back(position);
+        position += segmentSize;
+    }
+    bounds.push_back(input.size());
+    return bounds;
+}
+
+template<typename Handler>
+void Tokenizer<Handler>::feed(const char* data, std::size_t size, bool isLast)
+{
+    std::size_t wordStartIdx = 0; /* a word continued from the previous chunk starts here */
+    for (std::size_t blockStart = 0; blockStart < size; blockStart += CHAR_BLOCK_SIZE)
+    {
+        const std::size_t blockSize = std::min(CHAR_BLOCK_SIZE, size - blockStart);
+        const CharMasks masks = blockSize == CHAR_BLOCK_SIZE
+            ? classifyBlock(data + blockStart)
+            : classifyTail(data + blockStart, blockSize);
+        const std::uint64_t valid = blockSize == CHAR_BLOCK_SIZE ? ~0ULL : (1ULL << blockSize) - 1;
+        const std::uint64_t letter = valid & ~masks.space & ~masks.digit;
+
+        /*
+         * Jump from one token boundary to the next one:
+         * the state defines which class ends the current run, the first set bit of that class
+         * at or after position i is the boundary.
+         */
+        std::size_t i = 0;
+        while (i < blockSize)
+        {
+            const std::uint64_t ahead = valid & (~0ULL << i);
+            std::uint64_t boundary;
+            switch (m_charType)
+            {
+                case CharType::NONE:
+                    boundary = ~masks.space & ahead;
+                    if (!boundary)
+                    {
+                        i = blockSize;
+                        break;
+                    }
+                    i = __builtin_ctzll(boundary);
+                    m_tokenOffset = m_position + blockStart + i;
+                    if (masks.digit >> i & 1)
+                    {
+                        m_intValue = 0;
+                        m_charType = CharType::DIGIT;
+                    }
+                    else
+                    {
+                        wordStartIdx = blockStart + i;
+                        m_charType = CharType::LETTER;
+                    }
+                    break;
+                case CharType::DIGIT:
+                {
+                    boundary = ~masks.digit & ahead;
+                    std::size_t end = boundary ? __builtin_ctzll(boundary) : blockSize;
+                    appendDigits(m_intValue, data + blockStart + i, end - i, m_position + blockStart + i);
+                    i = end;
+                    if (boundary)
+                    {
+                        if (letter >> i & 1)
+                        {
+                            throw ParserException(ParserErrorCode::TOKENS_NOT_SEPARATED, m_position + blockStart + i);
+                        }
+                        m_handler.onInt(m_intValue, m_tokenOffset, m_position + blockStart + i - m_tokenOffset);
+                        m_charType = CharType::NONE;
+                    }
+                    break;
+                }
+                case CharType::LETTER:
+                    boundary = (masks.space | masks.digit) & ahead;
+                    if (!boundary)
+                    {
+                        i = blockSize;
+                        break;
+                    }
+                    i = __builtin_ctzll(boundary);
+                    if (masks.digit >> i & 1)
+                    {
+                        throw ParserException(ParserErrorCode::TOKENS_NOT_SEPARATED, m_position + blockStart + i);
+                    }
+                    fireWord(data, wordStartIdx, blockStart + i);
+                    m_charType = CharType::NONE;
+                    break;
+            }
+        }
+    }
+    m_position += size;
+    if (m_charType == CharType::LETTER)
+    {
+        if (isLast)
+        {
+            fireWord(data, wordStartIdx, size);
+            m_charType = CharType::NONE;
+        }
+        else
+        {
+            m_carry.append(data + wordStartIdx, size - wordStartIdx);
+        }
+    }
+    else if (isLast)
+    {
+        finish();
+    }
+}
+
+#endif /* TOKENIZER_H */
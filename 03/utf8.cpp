@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <cstring>
+
+#include "utf8.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+Utf8Validator selectValidator()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return validateUtf8Sse42;
+    }
+#endif
+    return validateUtf8Scalar;
+}
+
+}
+
+std::size_t validateUtf8Scalar(const char* data, std::size_t size)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    std::size_t i = 0;
+    while (i < size)
+    {
+        const unsigned char lead = bytes[i];
+        if (lead < 0x80)
+        {
+            ++i;
+            continue;
+        }
+        /* continuation byte count and the range of the first continuation byte */
+        std::size_t count;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF)
+        {
+            count = 1;
+        }
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            count = 2;
+            low = lead == 0xE0 ? 0xA0 : 0x80;  /* overlong */
+            high = lead == 0xED ? 0x9F : 0xBF; /* surrogates */
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            count = 3;
+            low = lead == 0xF0 ? 0x90 : 0x80;  /* overlong */
+            high = lead == 0xF4 ? 0x8F : 0xBF; /* above U+10FFFF */
+        }
+        else
+        {
+            return i;
+        }
+        if (size - i <= count || bytes[i + 1] < low || bytes[i + 1] > high)
+        {
+            return i;
+        }
+        for (std::size_t j = 2; j <= count; ++j)
+        {
+            if ((bytes[i + j] & 0xC0) != 0x80)
+            {
+                return i;
+            }
+        }
+        i += count + 1;
+    }
+    return size;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * Lookup algorithm of Keiser and Lemire ("Validating UTF-8 in less than one instruction per byte").
+ * Every error of a two-byte window is a combination of the high nibble of the first byte,
+ * its low nibble and the high nibble of the second byte: three 16-entry tables are looked up
+ * with pshufb and and-ed, a non-zero bit is an error. Continuation bytes expected after
+ * three- and four-byte leads are checked with saturating subtractions of the bytes two and
+ * three positions back. Only whether a block is valid is found this way, the exact offset
+ * of an error is then found by the scalar validator.
+ */
+
+namespace
+{
+
+const std::uint8_t TOO_SHORT = 1 << 0;      /* lead not followed by a continuation */
+const std::uint8_t TOO_LONG = 1 << 1;       /* continuation after ASCII */
+const std::uint8_t OVERLONG_3 = 1 << 2;
+const std::uint8_t TOO_LARGE = 1 << 3;      /* above U+10FFFF */
+const std::uint8_t SURROGATE = 1 << 4;
+const std::uint8_t OVERLONG_2 = 1 << 5;
+const std::uint8_t TOO_LARGE_1000 = 1 << 6;
+const std::uint8_t OVERLONG_4 = 1 << 6;
+const std::uint8_t TWO_CONTS = 1 << 7;      /* continuation after continuation, unless expected */
+const std::uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+/* Find the exact error offset, restarting at a sequence boundary before the failed block */
+std::size_t locateError(const char* data, std::size_t size, std::size_t blockStart)
+{
+    if (blockStart < 16)
+    {
+        return validateUtf8Scalar(data, size);
+    }
+    /* the previous block is valid, so continuation bytes at its start end a valid sequence and may be skipped */
+    std::size_t restart = blockStart - 16;
+    for (std::size_t i = 0; i < 3 && (static_cast<unsigned char>(data[restart]) & 0xC0) == 0x80; ++i)
+    {
+        ++restart;
+    }
+    return restart + validateUtf8Scalar(data + restart, size - restart);
+}
+
+}
+
+__attribute__((target("sse4.2")))
+std::size_t validateUtf8Sse42(const char* data, std::size_t size)
+{
+    const __m128i byte1HighTable = _mm_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        static_cast<char>(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4));
+    const __m128i byte1LowTable = _mm_setr_epi8(
+        static_cast<char>(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+        static_cast<char>(CARRY | OVERLONG_2),
+        static_cast<char>(CARRY),
+        static_cast<char>(CARRY),
+        static_cast<char>(CARRY | TOO_LARGE),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000));
+    const __m128i byte2HighTable = _mm_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+    /* a lead byte in the last bytes of a block at or above these values is continued in the next block */
+    const __m128i incompleteLimit = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+    const __m128i thirdByteBound = _mm_set1_epi8(0xE0 - 0x80);
+    const __m128i fourthByteBound = _mm_set1_epi8(static_cast<char>(0xF0 - 0x80));
+    const __m128i highBit = _mm_set1_epi8(static_cast<char>(0x80));
+
+    __m128i previous = _mm_setzero_si128();   /* previous block */
+    __m128i incomplete = _mm_setzero_si128(); /* the previous block ends with an unfinished sequence */
+    for (std::size_t blockStart = 0; blockStart < size; blockStart += 16)
+    {
+        __m128i input;
+        if (size - blockStart >= 16)
+        {
+            input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + blockStart));
+        }
+        else
+        {
+            /* zero padding is ASCII, so a sequence truncated by the end of input is an error */
+            char tail[16] = { 0 };
+            std::memcpy(tail, data + blockStart, size - blockStart);
+            input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail));
+        }
+        __m128i error;
+        if (!_mm_movemask_epi8(input))
+        {
+            /* ASCII block: valid unless it cuts the previous sequence */
+            error = incomplete;
+            incomplete = _mm_setzero_si128();
+        }
+        else
+        {
+            const __m128i previous1 = _mm_alignr_epi8(input, previous, 15);
+            const __m128i byte1High = _mm_shuffle_epi8(byte1HighTable,
+                                                       _mm_and_si128(_mm_srli_epi16(previous1, 4), nibbleMask));
+            const __m128i byte1Low = _mm_shuffle_epi8(byte1LowTable, _mm_and_si128(previous1, nibbleMask));
+            const __m128i byte2High = _mm_shuffle_epi8(byte2HighTable,
+                                                       _mm_and_si128(_mm_srli_epi16(input, 4), nibbleMask));
+            const __m128i special = _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+            const __m128i previous2 = _mm_alignr_epi8(input, previous, 14);
+            const __m128i previous3 = _mm_alignr_epi8(input, previous, 13);
+            const __m128i mustBeContinuation = _mm_and_si128(
+                _mm_or_si128(_mm_subs_epu8(previous2, thirdByteBound), _mm_subs_epu8(previous3, fourthByteBound)),
+                highBit);
+            error = _mm_xor_si128(mustBeContinuation, special);
+            incomplete = _mm_subs_epu8(input, incompleteLimit);
+        }
+        if (!_mm_testz_si128(error, error))
+        {
+            return locateError(data, size, blockStart);
+        }
+        previous = input;
+    }
+    if (!_mm_testz_si128(incomplete, incomplete))
+    {
+        return locateError(data, size, size & ~static_cast<std::size_t>(15));
+    }
+    return size;
+}
+
+#endif
+
+const Utf8Validator validateUtf8 = selectValidator();
+
+std::size_t Utf8StreamValidator::feed(const char* data, std::size_t size, bool isLast)
+{
+    std::size_t start = 0;
+    if (m_pendingSize)
+    {
+        /* complete the sequence split by the previous chunk boundary */
+        const std::size_t sequenceLength = getUtf8SequenceLength(m_pending[0]);
+        start = std::min(sequenceLength - m_pendingSize, size);
+        std::memcpy(m_pending + m_pendingSize, data, start);
+        m_pendingSize += start;
+        if (m_pendingSize < sequenceLength && !isLast)
+        {
+            m_position += size;
+            return VALID;
+        }
+        if (validateUtf8Scalar(reinterpret_cast<const char*>(m_pending), m_pendingSize) != m_pendingSize)
+        {
+            return m_pendingOffset;
+        }
+        m_pendingSize = 0;
+    }
+
+    /* keep an unfinished sequence at the end of the chunk for the next one */
+    std::size_t end = size;
+    if (!isLast)
+    {
+        for (std::size_t back = 1; back <= 3 && back <= size - start; ++back)
+        {
+            const unsigned char byte = data[size - back];
+            if (byte >= 0xC0)
+            {
+                /* an invalid lead is reported now, so that no token containing it is fired before the error */
+                if (byte >= 0xC2 && byte <= 0xF4 && getUtf8SequenceLength(byte) > back)
+                {
+                    end = size - back;
+                }
+                break;
+            }
+            if (byte < 0x80)
+            {
+                break;
+            }
+        }
+    }
+    const std::size_t invalid = start + validateUtf8(data + start, end - start);
+    if (invalid != end)
+    {
+        return m_position + invalid;
+    }
+    std::memcpy(m_pending, data + end, size - end);
+    m_pendingSize = size - end;
+    m_pendingOffset = m_position + end;
+    m_position += size;
+    return VALID;
+}
@@ -0,0 +1,88 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * UTF-8 validator: returns the offset of the first byte of the first invalid or truncated
+ * sequence, or size if the text is valid. Overlong forms, surrogates and code points
+ * above U+10FFFF are invalid.
+ */
+typedef std::size_t (*Utf8Validator)(const char* data, std::size_t size);
+
+/* Portable validator, a per-sequence state machine */
+std::size_t validateUtf8Scalar(const char* data, std::size_t size);
+#if defined(__x86_64__) || defined(__i386__)
+/* SSE4.2 validator, checks 16 bytes at once with nibble lookup tables */
+std::size_t validateUtf8Sse42(const char* data, std::size_t size);
+#endif
+
+/* The fastest validator supported by the CPU, selected at startup */
+extern const Utf8Validator validateUtf8;
+
+/* Length of the UTF-8 sequence starting with given lead byte, 1 for ASCII and stray bytes */
+inline std::size_t getUtf8SequenceLength(unsigned char lead)
+{
+    return lead < 0xC0 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+}
+
+/**
+ * Length of the Unicode whitespace character (U+0085, U+00A0, U+1680, U+2000..U+200A,
+ * U+2028, U+2029, U+202F, U+205F, U+3000) at the beginning of valid UTF-8 text, zero if there is none.
+ * ASCII whitespace is not checked.
+ */
+inline std::size_t getUnicodeSpaceLength(const char* text, std::size_t size)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+    if (size >= 2 && bytes[0] == 0xC2)
+    {
+        return bytes[1] == 0x85 || bytes[1] == 0xA0 ? 2 : 0;
+    }
+    if (size < 3)
+    {
+        return 0;
+    }
+    switch (bytes[0])
+    {
+        case 0xE1:
+            return bytes[1] == 0x9A && bytes[2] == 0x80 ? 3 : 0;
+        case 0xE2:
+            if (bytes[1] == 0x80)
+            {
+                return bytes[2] <= 0x8A || bytes[2] == 0xA8 || bytes[2] == 0xA9 || bytes[2] == 0xAF ? 3 : 0;
+            }
+            return bytes[1] == 0x81 && bytes[2] == 0x9F ? 3 : 0;
+        case 0xE3:
+            return bytes[1] == 0x80 && bytes[2] == 0x80 ? 3 : 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Validator of input fed in chunks of arbitrary size.
+ * A sequence split by a chunk boundary is kept until the next chunk completes it.
+ */
+class Utf8StreamValidator
+{
+private:
+    unsigned char m_pending[4]; /* beginning of the sequence split by a chunk boundary */
+    std::size_t m_pendingSize;
+    std::size_t m_pendingOffset; /* offset of the split sequence from the beginning of input */
+    std::size_t m_position;      /* offset of the next chunk from the beginning of input */
+public:
+    /* Offset returned when the input is valid so far */
+    static const std::size_t VALID = SIZE_MAX;
+
+    explicit Utf8StreamValidator(std::size_t position = 0): m_pendingSize(0), m_pendingOffset(0), m_position(position)
+    {
+    }
+    /**
+     * Validate next chunk, returns the offset of the first invalid sequence from the beginning of input
+     * (it may start in a previous chunk) or VALID. A sequence truncated by the end of the last chunk is invalid.
+     */
+    std::size_t feed(const char* data, std::size_t size, bool isLast = false);
+};
+
+#endif /* UTF8_H */
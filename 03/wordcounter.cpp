@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+#include "parsererror.h"
+#include "staticsaxparser.h"
+#include "tokenizer.h"
+#include "wordcounter.h"
+
+namespace
+{
+
+/* Initial hash table size */
+const std::size_t INITIAL_SLOT_COUNT = 1024;
+
+std::uint32_t hashWord(std::string_view word)
+{
+    return static_cast<std::uint32_t>(std::hash<std::string_view>()(word));
+}
+
+std::size_t resolveThreadCount(std::size_t threadCount)
+{
+    return threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+}
+
+}
+
+WordCounter::WordCounter(): m_slots(INITIAL_SLOT_COUNT, Slot{ 0, NO_WORD }), m_arenaNext(nullptr), m_arenaLeft(0),
+    m_totalCount(0), m_onWordCounted(new Observable<WordId>())
+{
+}
+
+const char* WordCounter::store(std::string_view word)
+{
+    /* long words get their own block, so that the current one is not wasted */
+    if (word.size() > ARENA_BLOCK_SIZE / 4)
+    {
+        m_arena.emplace_back(new char[word.size()]);
+        std::memcpy(m_arena.back().get(), word.data(), word.size());
+        return m_arena.back().get();
+    }
+    if (word.size() > m_arenaLeft)
+    {
+        m_arena.emplace_back(new char[ARENA_BLOCK_SIZE]);
+        m_arenaNext = m_arena.back().get();
+        m_arenaLeft = ARENA_BLOCK_SIZE;
+    }
+    char* text = m_arenaNext;
+    std::memcpy(text, word.data(), word.size());
+    m_arenaNext += word.size();
+    m_arenaLeft -= word.size();
+    return text;
+}
+
+void WordCounter::grow()
+{
+    std::vector<Slot> slots(m_slots.size() * 2, Slot{ 0, NO_WORD });
+    const std::size_t mask = slots.size() - 1;
+    for (WordId id = 0; id < m_entries.size(); ++id)
+    {
+        std::size_t index = m_entries[id].hash & mask;
+        while (slots[index].id != NO_WORD)
+        {
+            index = (index + 1) & mask;
+        }
+        slots[index] = Slot{ m_entries[id].hash, id };
+    }
+    m_slots.swap(slots);
+}
+
+WordCounter::WordId WordCounter::intern(std::string_view word, std::uint32_t hash)
+{
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t index = hash & mask;
+    while (m_slots[index].id != NO_WORD)
+    {
+        const Slot& slot = m_slots[index];
+        if (slot.hash == hash)
+        {
+            const Entry& entry = m_entries[slot.id];
+            if (entry.length == word.size() && !std::memcmp(entry.text, word.data(), word.size()))
+            {
+                return slot.id;
+            }
+        }
+        index = (index + 1) & mask;
+    }
+    if (m_entries.size() == NO_WORD)
+    {
+        throw std::length_error("Too many distinct words");
+    }
+    const WordId id = static_cast<WordId>(m_entries.size());
+    m_entries.push_back(Entry{ store(word), static_cast<std::uint32_t>(word.size()), hash, 0 });
+    m_slots[index] = Slot{ hash, id };
+    /* keep the load factor at most 1/2, so probe sequences stay short */
+    if (m_entries.size() * 2 > m_slots.size())
+    {
+        grow();
+    }
+    return id;
+}
+
+WordCounter::WordId WordCounter::intern(std::string_view word)
+{
+    return intern(word, hashWord(word));
+}
+
+WordCounter::WordId WordCounter::add(std::string_view word, std::uint64_t count)
+{
+    const WordId id = intern(word, hashWord(word));
+    m_entries[id].count += count;
+    m_totalCount += count;
+    return id;
+}
+
+WordCounter::WordId WordCounter::find(std::string_view word) const
+{
+    const std::uint32_t hash = hashWord(word);
+    const std::size_t mask = m_slots.size() - 1;
+    for (std::size_t index = hash & mask; m_slots[index].id != NO_WORD; index = (index + 1) & mask)
+    {
+        const Slot& slot = m_slots[index];
+        if (slot.hash == hash && getWord(slot.id) == word)
+        {
+            return slot.id;
+        }
+    }
+    return NO_WORD;
+}
+
+std::uint64_t WordCounter::getCount(std::string_view word) const
+{
+    const WordId id = find(word);
+    return id == NO_WORD ? 0 : m_entries[id].count;
+}
+
+void WordCounter::merge(const WordCounter& other)
+{
+    for (const Entry& entry : other.m_entries)
+    {
+        /* the stored hash saves rehashing */
+        const WordId id = intern(std::string_view(entry.text, entry.length), entry.hash);
+        m_entries[id].count += entry.count;
+    }
+    m_totalCount += other.m_totalCount;
+}
+
+std::vector<WordCounter::WordId> WordCounter::top(std::size_t k) const
+{
+    std::vector<WordId> ids(m_entries.size());
+    for (WordId id = 0; id < ids.size(); ++id)
+    {
+        ids[id] = id;
+    }
+    k = std::min(k, ids.size());
+    std::partial_sort(ids.begin(), ids.begin() + k, ids.end(), [this](WordId left, WordId right)
+    {
+        if (m_entries[left].count != m_entries[right].count)
+        {
+            return m_entries[left].count > m_entries[right].count;
+        }
+        return getWord(left) < getWord(right);
+    });
+    ids.resize(k);
+    return ids;
+}
+
+void WordCounter::mergeAll(std::vector<WordCounter>& counters, std::size_t threadCount)
+{
+    threadCount = resolveThreadCount(threadCount);
+    /* on every level counter i takes counter i + stride, the merges of a level are independent */
+    for (std::size_t stride = 1; stride < counters.size(); stride *= 2)
+    {
+        std::vector<std::size_t> targets;
+        for (std::size_t i = 0; i + stride < counters.size(); i += 2 * stride)
+        {
+            targets.push_back(i);
+        }
+        for (std::size_t first = 0; first < targets.size(); first += threadCount)
+        {
+            std::vector<std::thread> threads;
+            const std::size_t last = std::min(targets.size(), first + threadCount);
+            for (std::size_t t = first + 1; t < last; ++t)
+            {
+                threads.emplace_back([&counters, stride, i = targets[t]]() { counters[i].merge(counters[i + stride]); });
+            }
+            counters[targets[first]].merge(counters[targets[first] + stride]);
+            for (std::thread& thread : threads)
+            {
+                thread.join();
+            }
+        }
+    }
+    counters.resize(std::min<std::size_t>(counters.size(), 1));
+}
+
+WordCounter WordCounter::countParallel(std::string_view input, std::size_t threadCount)
+{
+    threadCount = resolveThreadCount(threadCount);
+    const std::vector<std::size_t> bounds = splitAtWhitespace(input, std::max<std::size_t>(input.size() / threadCount, 1));
+    const std::size_t segmentCount = bounds.size() - 1;
+    std::vector<WordCounter> counters(segmentCount);
+    std::vector<std::exception_ptr> errors(segmentCount);
+    auto count = [&input, &bounds, &counters, &errors](std::size_t index)
+    {
+        try
+        {
+            StaticSaxParser<WordCounter> parser(counters[index]);
+            parser.parse(input.substr(bounds[index], bounds[index + 1] - bounds[index]));
+        }
+        catch (const ParserException& e)
+        {
+            /* offsets are relative to the segment */
+            errors[index] = std::make_exception_ptr(ParserException(e.errorCode, e.offset + bounds[index]));
+        }
+        catch (...)
+        {
+            errors[index] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < segmentCount; ++i)
+    {
+        threads.emplace_back(count, i);
+    }
+    count(0);
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    /* the first error in document order is the one a sequential parse reports */
+    for (const std::exception_ptr& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+    mergeAll(counters, threadCount);
+    return std::move(counters.front());
+}
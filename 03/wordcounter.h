@@ -0,0 +1,133 @@
+#ifndef WORDCOUNTER_H
+#define WORDCOUNTER_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "observable.h"
+
+/**
+ * Word frequency counter.
+ *
+ * Words are interned into an open-addressing hash table with linear probing,
+ * every distinct word gets a dense 32-bit id in order of its first occurrence.
+ * Word characters are copied once into an arena of large blocks, so counting allocates
+ * nothing per word and the table holds no std::string keys.
+ * The counter is a handler of StaticSaxParser:
+ *     WordCounter counter;
+ *     StaticSaxParser<WordCounter>(counter).parse(input);
+ * Listeners on word counted receive the id of every counted word.
+ */
+class WordCounter
+{
+public:
+    /* Dense id of a distinct word */
+    typedef std::uint32_t WordId;
+    /* Id of no word */
+    static const WordId NO_WORD = UINT32_MAX;
+private:
+    /* Hash table slot */
+    struct Slot
+    {
+        std::uint32_t hash; /* low bits of the word hash */
+        WordId id;          /* NO_WORD if the slot is free */
+    };
+    /* Distinct word */
+    struct Entry
+    {
+        const char* text;   /* word characters in the arena */
+        std::uint32_t length;
+        std::uint32_t hash;
+        std::uint64_t count;
+    };
+
+    static const std::size_t ARENA_BLOCK_SIZE = 64 << 10;
+
+    std::vector<Slot> m_slots;                    /* hash table, the size is a power of two */
+    std::vector<Entry> m_entries;                 /* words by id */
+    std::vector<std::unique_ptr<char[]>> m_arena; /* blocks of word characters */
+    char* m_arenaNext;                            /* free space of the current block */
+    std::size_t m_arenaLeft;
+    std::uint64_t m_totalCount;                   /* count of all words */
+    std::unique_ptr<Observable<WordId>> m_onWordCounted; /* on the heap to keep the counter movable */
+
+    /* Copy word characters into the arena */
+    const char* store(std::string_view word);
+    /* Double the table */
+    void grow();
+    /* Find or insert the word with given hash */
+    WordId intern(std::string_view word, std::uint32_t hash);
+public:
+    WordCounter();
+    WordCounter(WordCounter&&) = default;
+    WordCounter& operator=(WordCounter&&) = default;
+
+    /** Intern the word without counting it */
+    WordId intern(std::string_view word);
+    /** Count the word, returns its id */
+    WordId add(std::string_view word, std::uint64_t count = 1);
+    /** StaticSaxParser handler method */
+    void onWord(std::string_view word)
+    {
+        WordId id = add(word);
+        if (m_onWordCounted->hasListeners())
+        {
+            m_onWordCounted->fireEvent(id);
+        }
+    }
+    /** Id of the word, NO_WORD if it was not seen */
+    WordId find(std::string_view word) const;
+    /** Word of the id, points into the counter */
+    std::string_view getWord(WordId id) const
+    {
+        return std::string_view(m_entries[id].text, m_entries[id].length);
+    }
+    /** Occurrence count of the word of the id */
+    std::uint64_t getCount(WordId id) const
+    {
+        return m_entries[id].count;
+    }
+    /** Occurrence count of the word, zero if it was not seen */
+    std::uint64_t getCount(std::string_view word) const;
+    /** Count of distinct words, ids are below it */
+    std::size_t size() const
+    {
+        return m_entries.size();
+    }
+    /** Count of all counted words */
+    std::uint64_t getTotalCount() const
+    {
+        return m_totalCount;
+    }
+    /** Add counts of the other counter, ids of this counter don't change */
+    void merge(const WordCounter& other);
+    /** Ids of k most frequent words, by count descending, ties by word */
+    std::vector<WordId> top(std::size_t k) const;
+
+    /**
+     * Merge counters on several threads in a binary tree, the result is in the first one.
+     * Zero threadCount means hardware concurrency.
+     */
+    static void mergeAll(std::vector<WordCounter>& counters, std::size_t threadCount = 0);
+    /**
+     * Count words of input on several threads: the input is split at whitespace into a segment per thread,
+     * segments are counted independently and merged. Errors are the same as of SaxParser.
+     * Zero threadCount means hardware concurrency.
+     */
+    static WordCounter countParallel(std::string_view input, std::size_t threadCount = 0);
+
+    /** Add listener callback on word counted */
+    void addListenerOnWordCounted(void (* listener)(WordId))
+    {
+        m_onWordCounted->addListener(listener);
+    }
+    /** Remove listener callback on word counted */
+    void removeListenerOnWordCounted(void (* listener)(WordId))
+    {
+        m_onWordCounted->removeListener(listener);
+    }
+};
+
+#endif /* WORDCOUNTER_H */
@@ -0,0 +1,66 @@
+#ifndef ALIGNED_H
+#define ALIGNED_H
+
+#include <cstddef>
+#include <new>
+
+/* Alignment of matrix rows and kernel buffers: a cache line, which also fits any vector register */
+const std::size_t MATRIX_ALIGNMENT = 64;
+
+/* Allocate uninitialized storage for count values aligned to MATRIX_ALIGNMENT */
+template<typename T>
+T* allocateAligned(std::size_t count)
+{
+    return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(MATRIX_ALIGNMENT)));
+}
+
+/* Free storage allocated by allocateAligned() */
+template<typename T>
+void freeAligned(T* data)
+{
+    ::operator delete(data, std::align_val_t(MATRIX_ALIGNMENT));
+}
+
+/* Row stride in values: the row length rounded up to whole cache lines, so every row starts aligned */
+template<typename T>
+std::size_t getAlignedStride(std::size_t colCount)
+{
+    const std::size_t lineCount = MATRIX_ALIGNMENT / sizeof(T);
+    return (colCount + lineCount - 1) / lineCount * lineCount;
+}
+
+/* Standard allocator of aligned storage, for kernel buffers */
+template<typename T>
+class AlignedAllocator
+{
+public:
+    typedef T value_type;
+
+    AlignedAllocator()
+    {
+    }
+    template<typename Other>
+    AlignedAllocator(const AlignedAllocator<Other>&)
+    {
+    }
+    T* allocate(std::size_t count)
+    {
+        return allocateAligned<T>(count);
+    }
+    void deallocate(T* data, std::size_t)
+    {
+        freeAligned(data);
+    }
+    template<typename Other>
+    bool operator ==(const AlignedAllocator<Other>&) const
+    {
+        return true;
+    }
+    template<typename Other>
+    bool operator !=(const AlignedAllocator<Other>&) const
+    {
+        return false;
+    }
+};
+
+#endif // ALIGNED_H
@@ -0,0 +1,546 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "executor.h"
+#include "gemm.h"
+#include "matrix.h"
+#include "scale.h"
+#include "sparse.h"
+#include "transpose.h"
+
+/*
+ * Matrix kernel benchmark.
+ * Multiplies seeded random square matrices with the blocked kernel and with a naive triple loop,
+ * every consumer reports a checksum of the product, so the results are comparable.
+ */
+
+const unsigned int SEED = 2019;            /* matrix generator seed */
+const std::size_t REPEAT_COUNT = 3;        /* runs per measurement, the best one is reported */
+const std::size_t NAIVE_SIZE_LIMIT = 512;  /* the naive loop is too slow above this size */
+
+/* Random square matrix data with values small enough for any product to fit into int */
+std::vector<int> generateData(std::size_t size, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> value(-1000, 1000);
+    std::vector<int> data(size * size);
+    for (int& element : data)
+    {
+        element = value(generator);
+    }
+    return data;
+}
+
+/* Naive product of square matrices */
+std::vector<int> multiplyNaive(const std::vector<int>& a, const std::vector<int>& b, std::size_t size)
+{
+    std::vector<int> c(size * size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        for (std::size_t j = 0; j < size; ++j)
+        {
+            std::int64_t sum = 0;
+            for (std::size_t k = 0; k < size; ++k)
+            {
+                sum += static_cast<std::int64_t>(a[i * size + k]) * b[k * size + j];
+            }
+            c[i * size + j] = static_cast<int>(sum);
+        }
+    }
+    return c;
+}
+
+/* Checksum of a product */
+std::uint64_t getChecksum(const std::vector<int>& data)
+{
+    std::uint64_t checksum = 0;
+    for (int element : data)
+    {
+        checksum = checksum * 31 + element;
+    }
+    return checksum;
+}
+
+/* Best time of several runs of a consumer, the consumer result is stored */
+template<typename Consumer>
+double measureSeconds(Consumer consumer, std::uint64_t& result)
+{
+    double bestSeconds = 0;
+    for (std::size_t i = 0; i < REPEAT_COUNT; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        result = consumer();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!i || seconds < bestSeconds)
+        {
+            bestSeconds = seconds;
+        }
+    }
+    return bestSeconds;
+}
+
+/* Print a row of the product table: time and multiply-add throughput */
+void printMeasurement(const char* name, std::size_t size, double seconds, std::uint64_t checksum)
+{
+    const double operationCount = static_cast<double>(size) * size * size;
+    std::cout << std::left << std::setw(12) << name << std::right << std::setw(8) << size
+              << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+              << std::setw(12) << std::setprecision(2) << operationCount / seconds / 1e9
+              << std::setw(24) << checksum << std::endl;
+}
+
+/* Matrix product throughput per size */
+void runProductBenchmarks()
+{
+    std::cout << std::endl << "Matrix product, micro-kernel: " << getGemmKernelName() << std::endl;
+    std::cout << std::left << std::setw(12) << "consumer" << std::right << std::setw(8) << "size"
+              << std::setw(12) << "ms" << std::setw(12) << "GMAC/s" << std::setw(24) << "checksum" << std::endl;
+    for (std::size_t size : { 64, 256, 512, 1024 })
+    {
+        std::vector<int> a = generateData(size, SEED);
+        std::vector<int> b = generateData(size, SEED + 1);
+        Matrix<int> lhs(a.data(), size, size);
+        Matrix<int> rhs(b.data(), size, size);
+        std::uint64_t checksum = 0;
+        double seconds = measureSeconds([&lhs, &rhs, size]()
+        {
+            Matrix<int> product = lhs * rhs;
+            std::vector<int> data(size * size);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                for (std::size_t j = 0; j < size; ++j)
+                {
+                    data[i * size + j] = product[i][j];
+                }
+            }
+            return getChecksum(data);
+        }, checksum);
+        printMeasurement("blocked", size, seconds, checksum);
+        if (size <= NAIVE_SIZE_LIMIT)
+        {
+            seconds = measureSeconds([&a, &b, size]() { return getChecksum(multiplyNaive(a, b, size)); }, checksum);
+            printMeasurement("naive", size, seconds, checksum);
+        }
+    }
+}
+
+/* Element-wise pass that materializes its result, as every operator did without expression templates */
+template<typename Operation>
+std::vector<int> applyElementwise(const std::vector<int>& lhs, const std::vector<int>& rhs, Operation operation)
+{
+    std::vector<int> result(lhs.size());
+    bool overflow = false;
+    for (std::size_t i = 0; i < lhs.size(); ++i)
+    {
+        const std::int64_t value = operation(static_cast<std::int64_t>(lhs[i]), rhs[i]);
+        overflow |= value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max();
+        result[i] = static_cast<int>(value);
+    }
+    if (overflow)
+    {
+        throw std::out_of_range("Matrix expression overflow");
+    }
+    return result;
+}
+
+/* Checksum of a matrix */
+std::uint64_t getChecksum(Matrix<int>& matrix, std::size_t size)
+{
+    std::vector<int> data(size * size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        for (std::size_t j = 0; j < size; ++j)
+        {
+            data[i * size + j] = matrix[i][j];
+        }
+    }
+    return getChecksum(data);
+}
+
+/* C = A * 3 + B - D: one fused pass versus a temporary per operator */
+void runExpressionBenchmarks()
+{
+    std::cout << std::endl << "Element-wise expression C = A * 3 + B - D" << std::endl;
+    std::cout << std::left << std::setw(12) << "consumer" << std::right << std::setw(8) << "size"
+              << std::setw(12) << "ms" << std::setw(12) << "GB/s" << std::setw(24) << "checksum" << std::endl;
+    for (std::size_t size : { 256, 1024, 4096 })
+    {
+        std::vector<int> a = generateData(size, SEED);
+        std::vector<int> b = generateData(size, SEED + 1);
+        std::vector<int> d = generateData(size, SEED + 2);
+        Matrix<int> lhs(a.data(), size, size);
+        Matrix<int> middle(b.data(), size, size);
+        Matrix<int> rhs(d.data(), size, size);
+        Matrix<int> result;
+        std::uint64_t checksum = 0;
+        /* three matrices read, one written */
+        const double byteCount = 4.0 * size * size * sizeof(int);
+        auto print = [size, byteCount](const char* name, double seconds, std::uint64_t checksum)
+        {
+            std::cout << std::left << std::setw(12) << name << std::right << std::setw(8) << size
+                      << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+                      << std::setw(12) << std::setprecision(2) << byteCount / seconds / 1e9
+                      << std::setw(24) << checksum << std::endl;
+        };
+        double seconds = measureSeconds([&]()
+        {
+            result = lhs * 3 + middle - rhs;
+            return static_cast<std::uint64_t>(result[size - 1][size - 1]);
+        }, checksum);
+        print("fused", seconds, getChecksum(result, size));
+        std::vector<int> temporary;
+        seconds = measureSeconds([&]()
+        {
+            std::vector<int> three(a.size(), 3);
+            temporary = applyElementwise(a, three, [](std::int64_t x, std::int64_t y) { return x * y; });
+            temporary = applyElementwise(temporary, b, [](std::int64_t x, std::int64_t y) { return x + y; });
+            temporary = applyElementwise(temporary, d, [](std::int64_t x, std::int64_t y) { return x - y; });
+            return static_cast<std::uint64_t>(temporary.back());
+        }, checksum);
+        print("temporaries", seconds, getChecksum(temporary));
+    }
+}
+
+/* Chain of small transforms: the compile-time sized matrix versus the run-time sized one */
+template<std::size_t N>
+void runTransformBenchmark(std::size_t count)
+{
+    std::mt19937 generator(SEED);
+    std::uniform_real_distribution<double> value(-1, 1);
+    std::vector<double> data(N * N);
+    for (double& element : data)
+    {
+        element = value(generator) / N;
+    }
+    std::uint64_t checksum = 0;
+    double seconds = measureSeconds([&data, count]()
+    {
+        const Matrix<double, N, N> transform(data.data());
+        Matrix<double, N, N> result = transform;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            result = result * transform + transform;
+        }
+        return static_cast<std::uint64_t>(static_cast<std::int64_t>(result[0][0] * 1e9));
+    }, checksum);
+    std::cout << std::left << std::setw(12) << "fixed" << std::right << std::setw(8) << N
+              << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+              << std::setw(12) << std::setprecision(2) << count / seconds / 1e6 << std::setw(24) << checksum << std::endl;
+    seconds = measureSeconds([&data, count]()
+    {
+        const Matrix<double> transform(data.data(), N, N);
+        Matrix<double> result = transform;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            result = result * transform + transform;
+        }
+        return static_cast<std::uint64_t>(static_cast<std::int64_t>(result[0][0] * 1e9));
+    }, checksum);
+    std::cout << std::left << std::setw(12) << "dynamic" << std::right << std::setw(8) << N
+              << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+              << std::setw(12) << std::setprecision(2) << count / seconds / 1e6 << std::setw(24) << checksum << std::endl;
+}
+
+/* Small transform throughput */
+void runTransformBenchmarks()
+{
+    const std::size_t count = 1000000;
+    std::cout << std::endl << "Transform chain R = R * T + T, double" << std::endl;
+    std::cout << std::left << std::setw(12) << "consumer" << std::right << std::setw(8) << "size"
+              << std::setw(12) << "ms" << std::setw(12) << "M/s" << std::setw(24) << "checksum" << std::endl;
+    runTransformBenchmark<3>(count);
+    runTransformBenchmark<4>(count);
+}
+
+/* Scalar multiplication as it was: a pass for the extremes, then a pass for the products */
+void scaleTwoPass(std::vector<int>& data, int factor)
+{
+    const auto minMax = std::minmax_element(data.begin(), data.end());
+    const std::int64_t low = static_cast<std::int64_t>(*minMax.first) * factor;
+    const std::int64_t high = static_cast<std::int64_t>(*minMax.second) * factor;
+    if (std::min(low, high) < std::numeric_limits<int>::min() || std::max(low, high) > std::numeric_limits<int>::max())
+    {
+        throw std::out_of_range("Matrix scalar multiplication overflow");
+    }
+    for (int& element : data)
+    {
+        element *= factor;
+    }
+}
+
+/* Scalar multiplication throughput, factors alternate so the values stay bounded */
+void runScaleBenchmarks()
+{
+    std::cout << std::endl << "Scalar multiplication, kernel: " << getScaleKernelName() << std::endl;
+    std::cout << std::left << std::setw(12) << "consumer" << std::right << std::setw(8) << "size"
+              << std::setw(12) << "ms" << std::setw(12) << "GB/s" << std::setw(24) << "checksum" << std::endl;
+    for (std::size_t size : { 256, 1024, 4096 })
+    {
+        std::vector<int> data = generateData(size, SEED);
+        /* a read and a write of every value */
+        const double byteCount = 2.0 * size * size * sizeof(int);
+        auto print = [size, byteCount](const char* name, double seconds, std::uint64_t checksum)
+        {
+            std::cout << std::left << std::setw(12) << name << std::right << std::setw(8) << size
+                      << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+                      << std::setw(12) << std::setprecision(2) << byteCount / seconds / 1e9
+                      << std::setw(24) << checksum << std::endl;
+        };
+        Matrix<int> matrix(data.data(), size, size);
+        std::uint64_t checksum = 0;
+        double seconds = measureSeconds([&matrix]()
+        {
+            matrix *= -1;
+            return 0;
+        }, checksum);
+        print("one pass", seconds, getChecksum(matrix, size));
+        seconds = measureSeconds([&data]()
+        {
+            scaleTwoPass(data, -1);
+            return 0;
+        }, checksum);
+        print("two passes", seconds, getChecksum(data));
+    }
+}
+
+/* Product of the default executor against the serial one */
+void runParallelBenchmarks()
+{
+    std::cout << std::endl << "Parallel matrix product, threads: " << getMatrixExecutor()->getConcurrency() << std::endl;
+    std::cout << std::left << std::setw(12) << "consumer" << std::right << std::setw(8) << "size"
+              << std::setw(12) << "ms" << std::setw(12) << "GMAC/s" << std::setw(24) << "checksum" << std::endl;
+    for (std::size_t size : { 256, 1024 })
+    {
+        std::vector<int> a = generateData(size, SEED);
+        std::vector<int> b = generateData(size, SEED + 1);
+        Matrix<int> lhs(a.data(), size, size);
+        Matrix<int> rhs(b.data(), size, size);
+        auto multiply = [&lhs, &rhs, size]()
+        {
+            Matrix<int> product = lhs * rhs;
+            return getChecksum(product, size);
+        };
+        std::uint64_t checksum = 0;
+        double seconds = measureSeconds(multiply, checksum);
+        printMeasurement("parallel", size, seconds, checksum);
+        setMatrixExecutor(std::make_shared<SerialExecutor>());
+        seconds = measureSeconds(multiply, checksum);
+        printMeasurement("serial", size, seconds, checksum);
+        setMatrixExecutor(nullptr);
+    }
+}
+
+/* Naive in-place transposition */
+void transposeNaive(std::vector<int>& data, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        for (std::size_t j = i + 1; j < size; ++j)
+        {
+            std::swap(data[i * size + j], data[j * size + i]);
+        }
+    }
+}
+
+/* Transposition and column-major conversion against naive loops */
+void runTransposeBenchmarks()
+{
+    std::cout << std::endl << "Transposition, tile kernel: " << getTransposeKernelName() << std::endl;
+    std::cout << std::left << std::setw(16) << "consumer" << std::right << std::setw(8) << "size"
+              << std::setw(12) << "ms" << std::setw(12) << "GB/s" << std::setw(24) << "checksum" << std::endl;
+    for (std::size_t size : { 1024, 4096 })
+    {
+        std::vector<int> data = generateData(size, SEED);
+        /* a read and a write of every value */
+        const double byteCount = 2.0 * size * size * sizeof(int);
+        auto print = [size, byteCount](const char* name, double seconds, std::uint64_t checksum)
+        {
+            std::cout << std::left << std::setw(16) << name << std::right << std::setw(8) << size
+                      << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+                      << std::setw(12) << std::setprecision(2) << byteCount / seconds / 1e9
+                      << std::setw(24) << checksum << std::endl;
+        };
+        /* the checksums are taken outside of the measurements, they cost more than a transposition */
+        std::uint64_t checksum = 0;
+        Matrix<int> converted;
+        double seconds = measureSeconds([&data, &converted, size]()
+        {
+            converted = Matrix<int>(data.data(), size, size, MatrixLayout::ColumnMajor);
+            return 0;
+        }, checksum);
+        print("column-major", seconds, getChecksum(converted, size));
+        std::vector<int> rowMajor(size * size);
+        seconds = measureSeconds([&data, &rowMajor, size]()
+        {
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                for (std::size_t j = 0; j < size; ++j)
+                {
+                    rowMajor[i * size + j] = data[j * size + i];
+                }
+            }
+            return 0;
+        }, checksum);
+        print("naive copy", seconds, getChecksum(rowMajor));
+
+        /* an odd number of runs leaves the values transposed */
+        Matrix<int> matrix(data.data(), size, size);
+        seconds = measureSeconds([&matrix]()
+        {
+            matrix.transpose();
+            return 0;
+        }, checksum);
+        print("in place", seconds, getChecksum(matrix, size));
+        seconds = measureSeconds([&data, size]()
+        {
+            transposeNaive(data, size);
+            return 0;
+        }, checksum);
+        print("naive in place", seconds, getChecksum(data));
+    }
+}
+
+/* Sparse products against dense ones for a matrix with 1% of nonzero values */
+void runSparseBenchmarks()
+{
+    std::cout << std::endl << "Sparse matrix products, 1% nonzero" << std::endl;
+    std::cout << std::left << std::setw(16) << "consumer" << std::right << std::setw(8) << "size"
+              << std::setw(12) << "ms" << std::setw(12) << "MB" << std::setw(24) << "checksum" << std::endl;
+    const std::size_t size = 4096;
+    const std::size_t colCount = 64;
+    std::mt19937 generator(SEED);
+    std::uniform_int_distribution<int> position(0, 99);
+    std::vector<int> data = generateData(size, SEED);
+    for (int& element : data)
+    {
+        element = position(generator) ? 0 : element;
+    }
+    const Matrix<int> dense(data.data(), size, size);
+    const CsrMatrix<int> sparse(dense);
+    const Matrix<int> vector(generateData(size, SEED + 1).data(), size, 1);
+    const Matrix<int> other(generateData(size, SEED + 2).data(), size, colCount);
+    std::vector<int> values(size);
+    vector.copyTo(values.data());
+    auto print = [size](const char* name, double seconds, double byteCount, std::uint64_t checksum)
+    {
+        std::cout << std::left << std::setw(16) << name << std::right << std::setw(8) << size
+                  << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+                  << std::setw(12) << byteCount / 1e6 << std::setw(24) << checksum << std::endl;
+    };
+    const double denseBytes = static_cast<double>(size) * dense.getStride() * sizeof(int);
+    const double sparseBytes = static_cast<double>(sparse.getNonZeroCount()) * (sizeof(int) + sizeof(std::size_t)) +
+                               (size + 1) * sizeof(std::size_t);
+    std::uint64_t checksum = 0;
+    double seconds = measureSeconds([&sparse, &values]() { return getChecksum(sparse * values); }, checksum);
+    print("csr * vector", seconds, sparseBytes, checksum);
+    seconds = measureSeconds([&dense, &vector, size]()
+    {
+        Matrix<int> product = dense * vector;
+        std::vector<int> result(size);
+        product.copyTo(result.data());
+        return getChecksum(result);
+    }, checksum);
+    print("dense * vector", seconds, denseBytes, checksum);
+    seconds = measureSeconds([&sparse, &other]()
+    {
+        Matrix<int> product = sparse * other;
+        std::vector<int> result(product.getRowCount() * product.getColCount());
+        product.copyTo(result.data());
+        return getChecksum(result);
+    }, checksum);
+    print("csr * matrix", seconds, sparseBytes, checksum);
+    seconds = measureSeconds([&dense, &other]()
+    {
+        Matrix<int> product = dense * other;
+        std::vector<int> result(product.getRowCount() * product.getColCount());
+        product.copyTo(result.data());
+        return getChecksum(result);
+    }, checksum);
+    print("dense * matrix", seconds, denseBytes, checksum);
+}
+
+/* A user loop over all values: checked proxies against row spans and row pointers */
+void runAccessBenchmarks()
+{
+    std::cout << std::endl << "User loop sum of all values" << std::endl;
+    std::cout << std::left << std::setw(16) << "consumer" << std::right << std::setw(8) << "size"
+              << std::setw(12) << "ms" << std::setw(12) << "GB/s" << std::setw(24) << "checksum" << std::endl;
+    const std::size_t size = 4096;
+    std::vector<int> data = generateData(size, SEED);
+    Matrix<int> matrix(data.data(), size, size);
+    const double byteCount = static_cast<double>(size) * size * sizeof(int);
+    auto print = [size, byteCount](const char* name, double seconds, std::uint64_t checksum)
+    {
+        std::cout << std::left << std::setw(16) << name << std::right << std::setw(8) << size
+                  << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+                  << std::setw(12) << std::setprecision(2) << byteCount / seconds / 1e9
+                  << std::setw(24) << checksum << std::endl;
+    };
+    std::uint64_t checksum = 0;
+    double seconds = measureSeconds([&matrix, size]()
+    {
+        std::int64_t sum = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            for (std::size_t j = 0; j < size; ++j)
+            {
+                sum += matrix[i][j];
+            }
+        }
+        return static_cast<std::uint64_t>(sum);
+    }, checksum);
+    print("proxy", seconds, checksum);
+    seconds = measureSeconds([&matrix]()
+    {
+        std::int64_t sum = 0;
+        for (MatrixSpan<const int> row : static_cast<const Matrix<int>&>(matrix))
+        {
+            for (int value : row)
+            {
+                sum += value;
+            }
+        }
+        return static_cast<std::uint64_t>(sum);
+    }, checksum);
+    print("span", seconds, checksum);
+    seconds = measureSeconds([&matrix, size]()
+    {
+        std::int64_t sum = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            const int* row = matrix.getRowData(i);
+            for (std::size_t j = 0; j < size; ++j)
+            {
+                sum += row[j];
+            }
+        }
+        return static_cast<std::uint64_t>(sum);
+    }, checksum);
+    print("row pointer", seconds, checksum);
+}
+
+/* Benchmark suit */
+void runBenchmarks()
+{
+    runProductBenchmarks();
+    runExpressionBenchmarks();
+    runScaleBenchmarks();
+    runTransformBenchmarks();
+    runParallelBenchmarks();
+    runTransposeBenchmarks();
+    runSparseBenchmarks();
+    runAccessBenchmarks();
+}
+
+/* Program entry point */
+int main(void) {
+    runBenchmarks();
+}
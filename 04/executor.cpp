@@ -0,0 +1,228 @@
+#include "executor.h"
+
+namespace
+{
+
+/* Default tuning: 64 KB blocks, parallel from 256 KB of int values or about a millisecond of products */
+const MatrixParallelism DEFAULT_PARALLELISM = { 1 << 14, 1 << 16, 1 << 23 };
+
+std::mutex s_settingsMutex;                        /* guards the settings below */
+std::shared_ptr<MatrixExecutor> s_executor;        /* executor of the matrix kernels, created on first use */
+MatrixParallelism s_parallelism = DEFAULT_PARALLELISM;
+
+/* Fork-join job the current thread takes part in, linked to the jobs it is nested in */
+struct ActiveJob
+{
+    const ForkJoinExecutor* executor; /* executor of the job */
+    const ActiveJob* outer;           /* job whose chunk started this one, or nullptr */
+};
+
+/* Innermost job of the current thread */
+thread_local const ActiveJob* t_activeJob = nullptr;
+
+/* Registration of the current thread in a job for the scope of the guard */
+class ActiveJobGuard
+{
+private:
+    ActiveJob m_job; /* registered job */
+public:
+    explicit ActiveJobGuard(const ForkJoinExecutor* executor): m_job{ executor, t_activeJob }
+    {
+        t_activeJob = &m_job;
+    }
+    ~ActiveJobGuard()
+    {
+        t_activeJob = m_job.outer;
+    }
+    ActiveJobGuard(const ActiveJobGuard&) = delete;
+    ActiveJobGuard& operator=(const ActiveJobGuard&) = delete;
+};
+
+/* Check if the current thread takes part in a job of the executor */
+bool isInJob(const ForkJoinExecutor* executor)
+{
+    for (const ActiveJob* job = t_activeJob; job; job = job->outer)
+    {
+        if (job->executor == executor)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+void runChunksSerially(std::size_t count, std::size_t grain, const MatrixTask& task)
+{
+    std::exception_ptr error;
+    for (std::size_t begin = 0; begin < count; begin += grain)
+    {
+        try
+        {
+            task(begin, std::min(begin + grain, count));
+        }
+        catch (...)
+        {
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+ForkJoinExecutor::ForkJoinExecutor(std::size_t threadCount): m_generation(0), m_activeCount(0), m_isStopped(false),
+    m_task(nullptr), m_count(0), m_grain(1), m_nextChunk(0)
+{
+    if (!threadCount)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 1; i < threadCount; ++i)
+    {
+        m_workers.push_back(std::thread(&ForkJoinExecutor::work, this));
+    }
+}
+
+ForkJoinExecutor::~ForkJoinExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopped = true;
+    }
+    m_jobStarted.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ForkJoinExecutor::work()
+{
+    std::size_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobStarted.wait(lock, [this, generation]() { return m_isStopped || m_generation != generation; });
+            if (m_isStopped)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+        {
+            ActiveJobGuard guard(this);
+            runChunks();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!--m_activeCount)
+        {
+            m_jobFinished.notify_one();
+        }
+    }
+}
+
+void ForkJoinExecutor::runChunks()
+{
+    const std::size_t chunkCount = (m_count + m_grain - 1) / m_grain;
+    for (std::size_t chunk = m_nextChunk++; chunk < chunkCount; chunk = m_nextChunk++)
+    {
+        try
+        {
+            (*m_task)(chunk * m_grain, std::min((chunk + 1) * m_grain, m_count));
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+            {
+                m_error = std::current_exception();
+            }
+        }
+    }
+}
+
+void ForkJoinExecutor::run(std::size_t count, std::size_t grain, const MatrixTask& task)
+{
+    /* a nested call must not touch the run lock: the calling thread of the outer job owns it */
+    if (m_workers.empty() || count <= grain || isInJob(this))
+    {
+        runChunksSerially(count, grain, task);
+        return;
+    }
+    std::unique_lock<std::mutex> runLock(m_runMutex, std::try_to_lock);
+    if (!runLock.owns_lock())
+    {
+        runChunksSerially(count, grain, task);
+        return;
+    }
+    ActiveJobGuard guard(this);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_count = count;
+        m_grain = grain;
+        m_nextChunk = 0;
+        m_error = nullptr;
+        m_activeCount = m_workers.size();
+        ++m_generation;
+    }
+    m_jobStarted.notify_all();
+    runChunks();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobFinished.wait(lock, [this]() { return !m_activeCount; });
+    m_task = nullptr;
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    lock.unlock();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+std::shared_ptr<MatrixExecutor> getMatrixExecutor()
+{
+    std::lock_guard<std::mutex> lock(s_settingsMutex);
+    if (!s_executor)
+    {
+        s_executor = std::make_shared<ForkJoinExecutor>();
+    }
+    return s_executor;
+}
+
+void setMatrixExecutor(std::shared_ptr<MatrixExecutor> executor)
+{
+    std::lock_guard<std::mutex> lock(s_settingsMutex);
+    s_executor = executor;
+}
+
+MatrixParallelism getMatrixParallelism()
+{
+    std::lock_guard<std::mutex> lock(s_settingsMutex);
+    return s_parallelism;
+}
+
+void setMatrixParallelism(const MatrixParallelism& parallelism)
+{
+    std::lock_guard<std::mutex> lock(s_settingsMutex);
+    s_parallelism = parallelism;
+}
+
+void runRowBlocks(std::size_t count, std::size_t colCount, const MatrixTask& task)
+{
+    const MatrixParallelism parallelism = getMatrixParallelism();
+    const std::size_t grain = std::max<std::size_t>(1, parallelism.grainSize / std::max<std::size_t>(1, colCount));
+    if (count * colCount < parallelism.serialThreshold)
+    {
+        task(0, count);
+        return;
+    }
+    getMatrixExecutor()->run(count, grain, task);
+}
@@ -0,0 +1,209 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Executors of the parallel matrix kernels.
+ *
+ * A kernel splits its rows into chunks: chunk i covers [i * grain, min((i + 1) * grain, count)).
+ * An executor runs every chunk exactly once, in any order and on any thread, and returns when all of them
+ * are done. Every chunk runs even if some of them throw, the first exception is rethrown afterwards.
+ */
+
+/* Chunk of a parallel kernel: process rows [begin, end) */
+typedef std::function<void(std::size_t begin, std::size_t end)> MatrixTask;
+
+/* Executor interface */
+class MatrixExecutor
+{
+public:
+    virtual ~MatrixExecutor()
+    {
+    }
+    /* Run task over [0, count) in chunks of grain rows */
+    virtual void run(std::size_t count, std::size_t grain, const MatrixTask& task) = 0;
+    /* Number of threads that run chunks at once */
+    virtual std::size_t getConcurrency() const = 0;
+};
+
+/* Run the chunks one after another in the calling thread */
+void runChunksSerially(std::size_t count, std::size_t grain, const MatrixTask& task);
+
+/* Executor that runs everything in the calling thread */
+class SerialExecutor: public MatrixExecutor
+{
+public:
+    void run(std::size_t count, std::size_t grain, const MatrixTask& task) override
+    {
+        runChunksSerially(count, grain, task);
+    }
+    std::size_t getConcurrency() const override
+    {
+        return 1;
+    }
+};
+
+/**
+ * Built-in fork-join executor: a fixed set of worker threads takes chunks from a shared counter,
+ * the calling thread works as well. One job runs at a time: a nested call from a chunk, on any thread
+ * of the job, runs its chunks serially, which the threads detect by a thread-local list of their jobs.
+ * A call from another thread while a job is running also runs its chunks serially instead of waiting.
+ */
+class ForkJoinExecutor: public MatrixExecutor
+{
+private:
+    std::vector<std::thread> m_workers;      /* worker threads */
+    std::mutex m_runMutex;                   /* serializes the jobs of different calling threads */
+    std::mutex m_mutex;                      /* guards the job state below */
+    std::condition_variable m_jobStarted;    /* workers wait for a job */
+    std::condition_variable m_jobFinished;   /* the calling thread waits for the workers */
+    std::size_t m_generation;                /* number of the current job */
+    std::size_t m_activeCount;               /* workers that didn't finish the current job yet */
+    bool m_isStopped;                        /* executor is being destroyed */
+    const MatrixTask* m_task;                /* chunk function of the current job */
+    std::size_t m_count;                     /* rows of the current job */
+    std::size_t m_grain;                     /* rows of a chunk of the current job */
+    std::atomic<std::size_t> m_nextChunk;    /* next chunk to be taken */
+    std::exception_ptr m_error;              /* first exception of the current job */
+
+    /* Worker thread loop */
+    void work();
+    /* Take chunks of the current job until there are none left */
+    void runChunks();
+public:
+    /* threadCount is the total number of threads including the calling one, 0 means hardware concurrency */
+    explicit ForkJoinExecutor(std::size_t threadCount = 0);
+    ~ForkJoinExecutor();
+    ForkJoinExecutor(const ForkJoinExecutor&) = delete;
+    ForkJoinExecutor& operator=(const ForkJoinExecutor&) = delete;
+
+    void run(std::size_t count, std::size_t grain, const MatrixTask& task) override;
+    std::size_t getConcurrency() const override
+    {
+        return m_workers.size() + 1;
+    }
+};
+
+/**
+ * Executor backed by an external thread pool with exec(function) returning a std::future
+ * and size(), such as the ThreadPool of 09. The pool is referenced, not owned.
+ * The calling thread takes chunks as well and waits for the chunks rather than for the pool tasks,
+ * so a pool that starts its tasks late only loses parallelism.
+ */
+template<typename Pool>
+class PoolExecutor: public MatrixExecutor
+{
+private:
+    /* Job shared with the pool tasks, which may outlive the call */
+    struct Job
+    {
+        MatrixTask task;                        /* chunk function */
+        std::size_t count;                      /* rows */
+        std::size_t grain;                      /* rows of a chunk */
+        std::size_t chunkCount;                 /* chunks */
+        std::atomic<std::size_t> nextChunk;     /* next chunk to be taken */
+        std::size_t doneCount;                  /* finished chunks */
+        std::exception_ptr error;               /* first exception */
+        std::mutex mutex;                       /* guards doneCount and error */
+        std::condition_variable finished;       /* all chunks are done */
+
+        /* Take chunks until there are none left */
+        void runChunks()
+        {
+            for (std::size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+            {
+                std::exception_ptr chunkError;
+                try
+                {
+                    task(chunk * grain, std::min((chunk + 1) * grain, count));
+                }
+                catch (...)
+                {
+                    chunkError = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (chunkError && !error)
+                {
+                    error = chunkError;
+                }
+                if (++doneCount == chunkCount)
+                {
+                    finished.notify_all();
+                }
+            }
+        }
+    };
+
+    Pool& m_pool; /* thread pool */
+public:
+    explicit PoolExecutor(Pool& pool): m_pool(pool)
+    {
+    }
+    void run(std::size_t count, std::size_t grain, const MatrixTask& task) override
+    {
+        const std::size_t chunkCount = (count + grain - 1) / grain;
+        if (chunkCount < 2 || !m_pool.size())
+        {
+            runChunksSerially(count, grain, task);
+            return;
+        }
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->task = task;
+        job->count = count;
+        job->grain = grain;
+        job->chunkCount = chunkCount;
+        job->nextChunk = 0;
+        job->doneCount = 0;
+        for (std::size_t i = 0; i < std::min(m_pool.size(), chunkCount - 1); ++i)
+        {
+            m_pool.exec(std::function<void()>([job]() { job->runChunks(); }));
+        }
+        job->runChunks();
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&job]() { return job->doneCount == job->chunkCount; });
+        if (job->error)
+        {
+            std::rethrow_exception(job->error);
+        }
+    }
+    std::size_t getConcurrency() const override
+    {
+        return m_pool.size() + 1;
+    }
+};
+
+/* Tuning of the parallel kernels */
+struct MatrixParallelism
+{
+    std::size_t grainSize;        /* values of a row block, a block has at least one row */
+    std::size_t serialThreshold;  /* element-wise kernels over fewer values run serially */
+    std::size_t productThreshold; /* products of fewer multiply-adds run serially */
+};
+
+/* Executor of the matrix kernels, a ForkJoinExecutor of hardware concurrency by default */
+std::shared_ptr<MatrixExecutor> getMatrixExecutor();
+/* Replace the executor of the matrix kernels, nullptr restores the default one */
+void setMatrixExecutor(std::shared_ptr<MatrixExecutor> executor);
+/* Get the tuning of the parallel kernels */
+MatrixParallelism getMatrixParallelism();
+/* Set the tuning of the parallel kernels */
+void setMatrixParallelism(const MatrixParallelism& parallelism);
+
+/**
+ * Run task over count rows of colCount values with the matrix executor,
+ * serially if there are fewer than the serial threshold values.
+ */
+void runRowBlocks(std::size_t count, std::size_t colCount, const MatrixTask& task);
+
+#endif // EXECUTOR_H
@@ -0,0 +1,327 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+/*
+ * Lazy element-wise matrix arithmetic.
+ *
+ * A + B, A - B, A * factor and factor * A build expression nodes instead of matrices, a matrix is
+ * constructed or assigned from a whole expression in one pass without temporary buffers.
+ * Nodes hold matrices by reference and subexpressions by value, so an expression must not outlive
+ * the matrices it refers to: assign it to a Matrix, not to auto.
+ *
+ * Integer elements are evaluated in 64-bit arithmetic when no intermediate value can exceed it, in 128-bit
+ * arithmetic when no intermediate value can exceed that, and in checked 128-bit arithmetic otherwise.
+ * Only the final values are checked to fit into the element type, so an expression like
+ * A * INT64_MAX - A * INT64_MAX + A is evaluated whenever its values fit.
+ * Floating point elements are evaluated in the element type.
+ */
+
+/* Size of a matrix dimension known only at run time */
+const std::size_t MATRIX_DYNAMIC = 0;
+
+/* Matrix<T> is the run-time sized matrix, see matrix.h */
+template<typename T, std::size_t R = MATRIX_DYNAMIC, std::size_t C = MATRIX_DYNAMIC>
+class Matrix;
+
+/* Upper bound of the absolute values an expression may produce */
+typedef unsigned __int128 MatrixBound;
+
+/* Largest bound, saturated bounds stay there */
+const MatrixBound MATRIX_BOUND_MAX = ~static_cast<MatrixBound>(0);
+
+/* Bound of an integer matrix element */
+template<typename Element>
+MatrixBound getElementBound()
+{
+    return static_cast<MatrixBound>(1) << std::numeric_limits<Element>::digits;
+}
+
+/* Saturating bound of a sum */
+inline MatrixBound addBounds(MatrixBound lhs, MatrixBound rhs)
+{
+    return lhs > MATRIX_BOUND_MAX - rhs ? MATRIX_BOUND_MAX : lhs + rhs;
+}
+
+/* Saturating bound of a product */
+inline MatrixBound multiplyBounds(MatrixBound lhs, MatrixBound rhs)
+{
+    return lhs && rhs > MATRIX_BOUND_MAX / lhs ? MATRIX_BOUND_MAX : lhs * rhs;
+}
+
+/*
+ * 128-bit integer that records overflow, the value type of expressions whose bound exceeds 128 bits:
+ * the values the expression actually produces are checked instead of the bound.
+ */
+class MatrixCheckedValue
+{
+private:
+    __int128 m_value;  /* value, valid if there was no overflow */
+    bool m_isOverflow; /* some intermediate value exceeded 128 bits */
+public:
+    template<typename Integer, typename = typename std::enable_if<std::is_integral<Integer>::value>::type>
+    MatrixCheckedValue(Integer value): m_value(value), m_isOverflow(false)
+    {
+    }
+    friend MatrixCheckedValue operator +(const MatrixCheckedValue& lhs, const MatrixCheckedValue& rhs)
+    {
+        MatrixCheckedValue result(0);
+        result.m_isOverflow = __builtin_add_overflow(lhs.m_value, rhs.m_value, &result.m_value) ||
+                              lhs.m_isOverflow || rhs.m_isOverflow;
+        return result;
+    }
+    friend MatrixCheckedValue operator -(const MatrixCheckedValue& lhs, const MatrixCheckedValue& rhs)
+    {
+        MatrixCheckedValue result(0);
+        result.m_isOverflow = __builtin_sub_overflow(lhs.m_value, rhs.m_value, &result.m_value) ||
+                              lhs.m_isOverflow || rhs.m_isOverflow;
+        return result;
+    }
+    friend MatrixCheckedValue operator *(const MatrixCheckedValue& lhs, const MatrixCheckedValue& rhs)
+    {
+        MatrixCheckedValue result(0);
+        result.m_isOverflow = __builtin_mul_overflow(lhs.m_value, rhs.m_value, &result.m_value) ||
+                              lhs.m_isOverflow || rhs.m_isOverflow;
+        return result;
+    }
+    /* Check if the value fits into an integer type */
+    template<typename Integer>
+    bool fits() const
+    {
+        return !m_isOverflow && m_value >= std::numeric_limits<Integer>::min() && m_value <= std::numeric_limits<Integer>::max();
+    }
+    template<typename Integer, typename = typename std::enable_if<std::is_integral<Integer>::value>::type>
+    explicit operator Integer() const
+    {
+        return static_cast<Integer>(m_value);
+    }
+};
+
+/* Check if an evaluated value fits into the element type */
+template<typename Element, typename Value>
+inline bool fitsElement(const Value& value)
+{
+    if constexpr (std::is_same<Value, MatrixCheckedValue>::value)
+    {
+        return value.template fits<Element>();
+    }
+    else
+    {
+        return value >= std::numeric_limits<Element>::min() && value <= std::numeric_limits<Element>::max();
+    }
+}
+
+/**
+ * Base of the expression nodes.
+ * A node provides the Element type, getRowCount(), getColCount(), getBound(), evaluate<Value>(row, col)
+ * and aliases(target), which checks if evaluating element (i, j) may read a value of the target view
+ * other than its element (i, j).
+ */
+template<typename Derived>
+class MatrixExpression
+{
+public:
+    /* Get the node */
+    const Derived& self() const
+    {
+        return static_cast<const Derived&>(*this);
+    }
+};
+
+/* Storage of an operand in a node: matrices by reference, subexpressions by value */
+template<typename Expression>
+struct MatrixOperand
+{
+    typedef const Expression type;
+};
+
+template<typename T, std::size_t R, std::size_t C>
+struct MatrixOperand<Matrix<T, R, C>>
+{
+    typedef const Matrix<T, R, C>& type;
+};
+
+/* Element-wise combination of two expressions of the same size */
+template<typename Lhs, typename Rhs, typename Operation>
+class MatrixElementwise: public MatrixExpression<MatrixElementwise<Lhs, Rhs, Operation>>
+{
+public:
+    typedef typename Lhs::Element Element;
+    static_assert(std::is_same<Element, typename Rhs::Element>::value, "Matrix element types mismatch");
+private:
+    typename MatrixOperand<Lhs>::type m_lhs; /* left operand */
+    typename MatrixOperand<Rhs>::type m_rhs; /* right operand */
+public:
+    MatrixElementwise(const Lhs& lhs, const Rhs& rhs): m_lhs(lhs), m_rhs(rhs)
+    {
+        if (lhs.getRowCount() != rhs.getRowCount() || lhs.getColCount() != rhs.getColCount())
+        {
+            throw std::out_of_range("Matrix sizes mismatch in element-wise operation");
+        }
+    }
+    std::size_t getRowCount() const
+    {
+        return m_lhs.getRowCount();
+    }
+    std::size_t getColCount() const
+    {
+        return m_lhs.getColCount();
+    }
+    /* Both addition and subtraction are bounded by the sum of the operand bounds */
+    MatrixBound getBound() const
+    {
+        return addBounds(m_lhs.getBound(), m_rhs.getBound());
+    }
+    template<typename Target>
+    bool aliases(const Target& target) const
+    {
+        return m_lhs.aliases(target) || m_rhs.aliases(target);
+    }
+    template<typename Value>
+    Value evaluate(std::size_t row, std::size_t col) const
+    {
+        return Operation()(m_lhs.template evaluate<Value>(row, col), m_rhs.template evaluate<Value>(row, col));
+    }
+};
+
+/* Expression multiplied on scalar */
+template<typename Operand>
+class MatrixScaled: public MatrixExpression<MatrixScaled<Operand>>
+{
+public:
+    typedef typename Operand::Element Element;
+private:
+    typename MatrixOperand<Operand>::type m_operand; /* scaled operand */
+    Element m_factor;                                /* scalar factor */
+public:
+    MatrixScaled(const Operand& operand, Element factor): m_operand(operand), m_factor(factor)
+    {
+    }
+    std::size_t getRowCount() const
+    {
+        return m_operand.getRowCount();
+    }
+    std::size_t getColCount() const
+    {
+        return m_operand.getColCount();
+    }
+    MatrixBound getBound() const
+    {
+        const MatrixBound factor = static_cast<MatrixBound>(m_factor);
+        return multiplyBounds(m_operand.getBound(), m_factor < 0 ? 0 - factor : factor);
+    }
+    template<typename Target>
+    bool aliases(const Target& target) const
+    {
+        return m_operand.aliases(target);
+    }
+    template<typename Value>
+    Value evaluate(std::size_t row, std::size_t col) const
+    {
+        return m_operand.template evaluate<Value>(row, col) * static_cast<Value>(m_factor);
+    }
+};
+
+template<typename Lhs, typename Rhs>
+MatrixElementwise<Lhs, Rhs, std::plus<>> operator +(const MatrixExpression<Lhs>& lhs, const MatrixExpression<Rhs>& rhs)
+{
+    return MatrixElementwise<Lhs, Rhs, std::plus<>>(lhs.self(), rhs.self());
+}
+
+template<typename Lhs, typename Rhs>
+MatrixElementwise<Lhs, Rhs, std::minus<>> operator -(const MatrixExpression<Lhs>& lhs, const MatrixExpression<Rhs>& rhs)
+{
+    return MatrixElementwise<Lhs, Rhs, std::minus<>>(lhs.self(), rhs.self());
+}
+
+template<typename Operand>
+MatrixScaled<Operand> operator *(const MatrixExpression<Operand>& operand, typename Operand::Element factor)
+{
+    return MatrixScaled<Operand>(operand.self(), factor);
+}
+
+template<typename Operand>
+MatrixScaled<Operand> operator *(typename Operand::Element factor, const MatrixExpression<Operand>& operand)
+{
+    return MatrixScaled<Operand>(operand.self(), factor);
+}
+
+/* Column stride of contiguous rows, known at compile time, so that the loops over them are vectorized */
+typedef std::integral_constant<std::size_t, 1> MatrixUnitStride;
+
+/* Evaluate integer rows [rowBegin, rowEnd) of an expression into data, return false if some value doesn't fit */
+template<typename Value, typename Expression, typename Element, typename ColStride>
+bool evaluateElements(const Expression& expression, Element* data, std::size_t stride, std::size_t rowBegin, std::size_t rowEnd,
+                      ColStride colStride)
+{
+    /* no branches in the loop, so it is vectorized; the overflow is reported after the pass */
+    bool overflow = false;
+    const std::size_t colCount = expression.getColCount();
+    for (std::size_t i = rowBegin; i < rowEnd; ++i)
+    {
+        Element* row = data + i * stride;
+        for (std::size_t j = 0; j < colCount; ++j)
+        {
+            const Value value = expression.template evaluate<Value>(i, j);
+            overflow |= !fitsElement<Element>(value);
+            row[j * colStride] = static_cast<Element>(value);
+        }
+    }
+    return !overflow;
+}
+
+/**
+ * Evaluate rows [rowBegin, rowEnd) of an expression into data, element (i, j) goes to data[i * stride + j * colStride].
+ * Integer expressions use the narrowest accumulator their bound allows, checked 128-bit values if the bound
+ * doesn't fit even into 128 bits. They return false if a value doesn't fit into the element type,
+ * data is partially written then. Rows may be evaluated concurrently.
+ */
+template<typename Expression, typename Element, typename ColStride = MatrixUnitStride>
+bool evaluateRows(const Expression& expression, Element* data, std::size_t stride, std::size_t rowBegin, std::size_t rowEnd,
+                  ColStride colStride = MatrixUnitStride())
+{
+    if constexpr (!std::is_integral<Element>::value)
+    {
+        const std::size_t colCount = expression.getColCount();
+        for (std::size_t i = rowBegin; i < rowEnd; ++i)
+        {
+            Element* row = data + i * stride;
+            for (std::size_t j = 0; j < colCount; ++j)
+            {
+                row[j * colStride] = expression.template evaluate<Element>(i, j);
+            }
+        }
+        return true;
+    }
+    else
+    {
+        const MatrixBound bound = expression.getBound();
+        if (bound <= static_cast<MatrixBound>(std::numeric_limits<std::int64_t>::max()))
+        {
+            return evaluateElements<std::int64_t>(expression, data, stride, rowBegin, rowEnd, colStride);
+        }
+        if (bound <= MATRIX_BOUND_MAX >> 1)
+        {
+            return evaluateElements<__int128>(expression, data, stride, rowBegin, rowEnd, colStride);
+        }
+        return evaluateElements<MatrixCheckedValue>(expression, data, stride, rowBegin, rowEnd, colStride);
+    }
+}
+
+/* Evaluate a whole expression, see evaluateRows(), throw std::out_of_range on overflow */
+template<typename Expression, typename Element, typename ColStride = MatrixUnitStride>
+void evaluateExpression(const Expression& expression, Element* data, std::size_t stride, ColStride colStride = MatrixUnitStride())
+{
+    if (!evaluateRows(expression, data, stride, 0, expression.getRowCount(), colStride))
+    {
+        throw std::out_of_range("Matrix expression overflow");
+    }
+}
+
+#endif // EXPRESSION_H
@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "aligned.h"
+#include "gemm.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+GemmMicroKernel selectKernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return gemmMicroKernelAvx2;
+    }
+#endif
+    return gemmMicroKernelScalar;
+}
+
+/* Pack an mc x kc block of A into micro-panels of GEMM_MR rows, missing rows of the last panel are zero */
+template<typename Element>
+void packA(const Element* a, std::size_t lda, std::size_t inca, std::size_t mc, std::size_t kc, Element* packed)
+{
+    for (std::size_t panel = 0; panel < mc; panel += GEMM_MR)
+    {
+        const std::size_t rowCount = std::min(GEMM_MR, mc - panel);
+        for (std::size_t kk = 0; kk < kc; ++kk)
+        {
+            for (std::size_t r = 0; r < GEMM_MR; ++r)
+            {
+                *packed++ = r < rowCount ? a[(panel + r) * lda + kk * inca] : 0;
+            }
+        }
+    }
+}
+
+/* Pack a k x nc panel of B into micro-panels of GEMM_NR columns, missing columns of the last panel are zero */
+template<typename Element>
+void packB(const Element* b, std::size_t ldb, std::size_t incb, std::size_t k, std::size_t nc, Element* packed)
+{
+    for (std::size_t panel = 0; panel < nc; panel += GEMM_NR)
+    {
+        const std::size_t colCount = std::min(GEMM_NR, nc - panel);
+        for (std::size_t kk = 0; kk < k; ++kk)
+        {
+            const Element* row = b + kk * ldb + panel * incb;
+            for (std::size_t col = 0; col < GEMM_NR; ++col)
+            {
+                *packed++ = col < colCount ? row[col * incb] : 0;
+            }
+        }
+    }
+}
+
+/* Largest absolute value of an m x n integer matrix */
+template<typename Element>
+std::uint64_t getMaxAbs(const Element* data, std::size_t ld, std::size_t inc, std::size_t m, std::size_t n)
+{
+    std::uint64_t result = 0;
+    for (std::size_t i = 0; i < m; ++i)
+    {
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            const Element value = data[i * ld + j * inc];
+            result = std::max<std::uint64_t>(result, value < 0 ? 0 - static_cast<std::uint64_t>(value) : value);
+        }
+    }
+    return result;
+}
+
+/* Store an accumulated element of the product */
+template<typename Element, typename Accumulator>
+inline void storeElement(Element& target, Accumulator value)
+{
+    if constexpr (std::is_integral<Element>::value)
+    {
+        if (value < std::numeric_limits<Element>::min() || value > std::numeric_limits<Element>::max())
+        {
+            throw std::out_of_range("Matrix multiplication overflow");
+        }
+    }
+    target = static_cast<Element>(value);
+}
+
+/* Store an exactly accumulated element of the product */
+template<typename Element>
+inline void storeElement(Element& target, const DotAccumulator<Element>& value)
+{
+    if (!value.get(target))
+    {
+        throw std::out_of_range("Matrix multiplication overflow");
+    }
+}
+
+/* Product without blocking with exact accumulators, for small operands */
+template<typename Element>
+void multiplyDirect(const Element* a, std::size_t lda, std::size_t inca, const Element* b, std::size_t ldb, std::size_t incb,
+                    Element* c, std::size_t ldc, std::size_t incc, std::size_t m, std::size_t n, std::size_t k)
+{
+    for (std::size_t i = 0; i < m; ++i)
+    {
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            DotAccumulator<Element> sum;
+            for (std::size_t kk = 0; kk < k; ++kk)
+            {
+                sum.add(a[i * lda + kk * inca], b[kk * ldb + j * incb]);
+            }
+            if (!sum.get(c[i * ldc + j * incc]))
+            {
+                throw std::out_of_range("Matrix multiplication overflow");
+            }
+        }
+    }
+}
+
+/* Portable micro-kernel for any element and accumulator types */
+template<typename Element, typename Accumulator>
+void multiplyTile(std::size_t depth, const Element* a, const Element* b, Accumulator* c, std::size_t ldc)
+{
+    Accumulator sums[GEMM_MR][GEMM_NR] = {};
+    for (std::size_t kk = 0; kk < depth; ++kk)
+    {
+        for (std::size_t r = 0; r < GEMM_MR; ++r)
+        {
+            const Accumulator value = a[r];
+            for (std::size_t col = 0; col < GEMM_NR; ++col)
+            {
+                sums[r][col] += value * b[col];
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    for (std::size_t r = 0; r < GEMM_MR; ++r)
+    {
+        for (std::size_t col = 0; col < GEMM_NR; ++col)
+        {
+            c[r * ldc + col] += sums[r][col];
+        }
+    }
+}
+
+/* Exact micro-kernel for integer products that don't fit into 64 bits */
+template<typename Element>
+void multiplyTileExact(std::size_t depth, const Element* a, const Element* b, DotAccumulator<Element>* c, std::size_t ldc)
+{
+    for (std::size_t kk = 0; kk < depth; ++kk)
+    {
+        for (std::size_t r = 0; r < GEMM_MR; ++r)
+        {
+            for (std::size_t col = 0; col < GEMM_NR; ++col)
+            {
+                c[r * ldc + col].add(a[r], b[col]);
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+}
+
+/*
+ * Blocked product with a micro-kernel, see the header.
+ * Slices are at most sliceDepth deep. If Sum differs from Accumulator, the kernel tile is added
+ * to a tile of Sum after every slice, so an Accumulator only has to hold the sum of one slice.
+ * B is packed panel by panel unless packedB holds it already packed, see GemmPackedOperand.
+ */
+template<typename Element, typename Accumulator, typename Sum = Accumulator>
+void multiplyBlocked(void (*kernel)(std::size_t, const Element*, const Element*, Accumulator*, std::size_t),
+                     std::size_t sliceDepth, const Element* a, std::size_t lda, std::size_t inca,
+                     const Element* b, std::size_t ldb, std::size_t incb, const Element* packedB,
+                     Element* c, std::size_t ldc, std::size_t incc, std::size_t m, std::size_t n, std::size_t k)
+{
+    if (m * n * k <= GEMM_DIRECT_LIMIT)
+    {
+        multiplyDirect(a, lda, inca, b, ldb, incb, c, ldc, incc, m, n, k);
+        return;
+    }
+    constexpr bool isSummed = !std::is_same<Sum, Accumulator>::value;
+    const std::size_t panelSize = (std::min(n, GEMM_NC) + GEMM_NR - 1) / GEMM_NR * GEMM_NR * k;
+    std::vector<Element, AlignedAllocator<Element>> panelB(packedB ? 0 : panelSize);
+    std::vector<Element, AlignedAllocator<Element>> packedA(GEMM_MC * GEMM_KC);
+    std::vector<Accumulator, AlignedAllocator<Accumulator>> tile(GEMM_MC * GEMM_NC);
+    std::vector<Sum> sums(isSummed ? GEMM_MC * GEMM_NC : 0);
+    for (std::size_t jc = 0; jc < n; jc += GEMM_NC)
+    {
+        const std::size_t nc = std::min(GEMM_NC, n - jc);
+        const Element* panel = packedB ? packedB + jc * k : panelB.data();
+        if (!packedB)
+        {
+            packB(b + jc * incb, ldb, incb, k, nc, panelB.data());
+        }
+        for (std::size_t ic = 0; ic < m; ic += GEMM_MC)
+        {
+            const std::size_t mc = std::min(GEMM_MC, m - ic);
+            std::fill(tile.begin(), tile.end(), Accumulator());
+            std::fill(sums.begin(), sums.end(), Sum());
+            for (std::size_t pc = 0; pc < k; pc += sliceDepth)
+            {
+                const std::size_t kc = std::min(sliceDepth, k - pc);
+                packA(a + ic * lda + pc * inca, lda, inca, mc, kc, packedA.data());
+                for (std::size_t jr = 0; jr < nc; jr += GEMM_NR)
+                {
+                    for (std::size_t ir = 0; ir < mc; ir += GEMM_MR)
+                    {
+                        kernel(kc, packedA.data() + ir * kc, panel + jr * k + pc * GEMM_NR,
+                               tile.data() + ir * GEMM_NC + jr, GEMM_NC);
+                    }
+                }
+                if constexpr (isSummed)
+                {
+                    for (std::size_t i = 0; i < mc; ++i)
+                    {
+                        for (std::size_t j = 0; j < nc; ++j)
+                        {
+                            sums[i * GEMM_NC + j] += tile[i * GEMM_NC + j];
+                        }
+                    }
+                    std::fill(tile.begin(), tile.end(), Accumulator());
+                }
+            }
+            for (std::size_t i = 0; i < mc; ++i)
+            {
+                for (std::size_t j = 0; j < nc; ++j)
+                {
+                    if constexpr (isSummed)
+                    {
+                        storeElement(c[(ic + i) * ldc + (jc + j) * incc], sums[i * GEMM_NC + j]);
+                    }
+                    else
+                    {
+                        storeElement(c[(ic + i) * ldc + (jc + j) * incc], tile[i * GEMM_NC + j]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Integer product, always blocked. A partial sum over depth d is bounded by d * max|a| * max|b|:
+ * if it fits into 64 bits for the whole depth, the 64-bit kernel accumulates everything; if it fits
+ * for a shorter depth, slices of that depth are accumulated by the kernel and summed in 128 bits;
+ * if even a single product doesn't fit, as for large 64-bit values, the tiles are exact accumulators.
+ * maxAbsB is max|b|, packedB is B packed or null, see multiplyBlocked().
+ */
+template<typename Element>
+void multiplyIntegral(void (*kernel)(std::size_t, const Element*, const Element*, std::int64_t*, std::size_t),
+                      const Element* a, std::size_t lda, std::size_t inca, const Element* b, std::size_t ldb, std::size_t incb,
+                      std::uint64_t maxAbsB, const Element* packedB, Element* c, std::size_t ldc, std::size_t incc,
+                      std::size_t m, std::size_t n, std::size_t k)
+{
+    const unsigned __int128 product = static_cast<unsigned __int128>(getMaxAbs(a, lda, inca, m, k)) * maxAbsB;
+    const std::uint64_t max = std::numeric_limits<std::int64_t>::max();
+    const std::size_t depth = product ? static_cast<std::size_t>(std::min<unsigned __int128>(max / product, k)) : k;
+    if (depth >= k)
+    {
+        multiplyBlocked(kernel, GEMM_KC, a, lda, inca, b, ldb, incb, packedB, c, ldc, incc, m, n, k);
+    }
+    else if (depth)
+    {
+        multiplyBlocked<Element, std::int64_t, __int128>(kernel, std::min(depth, GEMM_KC), a, lda, inca, b, ldb, incb,
+                                                         packedB, c, ldc, incc, m, n, k);
+    }
+    else
+    {
+        multiplyBlocked(multiplyTileExact<Element>, GEMM_KC, a, lda, inca, b, ldb, incb, packedB, c, ldc, incc, m, n, k);
+    }
+}
+
+}
+
+void gemmMicroKernelScalar(std::size_t depth, const int* a, const int* b, std::int64_t* c, std::size_t ldc)
+{
+    multiplyTile(depth, a, b, c, ldc);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * vpmuldq multiplies the low signed halves of 64-bit lanes: a row of B is widened to two vectors
+ * of four 64-bit lanes, an element of A is broadcast to every 32-bit lane.
+ * Twelve accumulators hold the 6 x 8 tile in registers during the whole depth loop.
+ */
+__attribute__((target("avx2")))
+void gemmMicroKernelAvx2(std::size_t depth, const int* a, const int* b, std::int64_t* c, std::size_t ldc)
+{
+    __m256i c00 = _mm256_setzero_si256();
+    __m256i c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256();
+    __m256i c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256();
+    __m256i c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256();
+    __m256i c31 = _mm256_setzero_si256();
+    __m256i c40 = _mm256_setzero_si256();
+    __m256i c41 = _mm256_setzero_si256();
+    __m256i c50 = _mm256_setzero_si256();
+    __m256i c51 = _mm256_setzero_si256();
+    for (std::size_t kk = 0; kk < depth; ++kk)
+    {
+        const __m256i b0 = _mm256_cvtepi32_epi64(_mm_load_si128(reinterpret_cast<const __m128i*>(b)));
+        const __m256i b1 = _mm256_cvtepi32_epi64(_mm_load_si128(reinterpret_cast<const __m128i*>(b + 4)));
+        __m256i value = _mm256_set1_epi32(a[0]);
+        c00 = _mm256_add_epi64(c00, _mm256_mul_epi32(value, b0));
+        c01 = _mm256_add_epi64(c01, _mm256_mul_epi32(value, b1));
+        value = _mm256_set1_epi32(a[1]);
+        c10 = _mm256_add_epi64(c10, _mm256_mul_epi32(value, b0));
+        c11 = _mm256_add_epi64(c11, _mm256_mul_epi32(value, b1));
+        value = _mm256_set1_epi32(a[2]);
+        c20 = _mm256_add_epi64(c20, _mm256_mul_epi32(value, b0));
+        c21 = _mm256_add_epi64(c21, _mm256_mul_epi32(value, b1));
+        value = _mm256_set1_epi32(a[3]);
+        c30 = _mm256_add_epi64(c30, _mm256_mul_epi32(value, b0));
+        c31 = _mm256_add_epi64(c31, _mm256_mul_epi32(value, b1));
+        value = _mm256_set1_epi32(a[4]);
+        c40 = _mm256_add_epi64(c40, _mm256_mul_epi32(value, b0));
+        c41 = _mm256_add_epi64(c41, _mm256_mul_epi32(value, b1));
+        value = _mm256_set1_epi32(a[5]);
+        c50 = _mm256_add_epi64(c50, _mm256_mul_epi32(value, b0));
+        c51 = _mm256_add_epi64(c51, _mm256_mul_epi32(value, b1));
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    const __m256i sums[GEMM_MR][2] = {
+        { c00, c01 }, { c10, c11 }, { c20, c21 }, { c30, c31 }, { c40, c41 }, { c50, c51 }
+    };
+    for (std::size_t r = 0; r < GEMM_MR; ++r)
+    {
+        __m256i* row = reinterpret_cast<__m256i*>(c + r * ldc);
+        _mm256_store_si256(row, _mm256_add_epi64(_mm256_load_si256(row), sums[r][0]));
+        _mm256_store_si256(row + 1, _mm256_add_epi64(_mm256_load_si256(row + 1), sums[r][1]));
+    }
+}
+
+#endif
+
+const GemmMicroKernel gemmMicroKernel = selectKernel();
+
+const char* getGemmKernelName()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (gemmMicroKernel == gemmMicroKernelAvx2)
+    {
+        return "avx2";
+    }
+#endif
+    return "scalar";
+}
+
+template<typename Element>
+GemmPackedOperand<Element>::GemmPackedOperand(const Element* b, std::size_t ldb, std::size_t incb, std::size_t k, std::size_t n):
+    m_data(b), m_ld(ldb), m_inc(incb), m_rowCount(k), m_colCount(n), m_maxAbs(0),
+    m_panels((n + GEMM_NR - 1) / GEMM_NR * GEMM_NR * k)
+{
+    if constexpr (std::is_integral<Element>::value)
+    {
+        m_maxAbs = ::getMaxAbs(b, ldb, incb, k, n);
+    }
+    /* panels of GEMM_NC columns are packed one after another, so the one starting at column j is at j * k */
+    packB(b, ldb, incb, k, n, m_panels.data());
+}
+
+template class GemmPackedOperand<int>;
+template class GemmPackedOperand<std::int64_t>;
+template class GemmPackedOperand<float>;
+template class GemmPackedOperand<double>;
+
+void multiplyMatrices(const int* a, std::size_t lda, std::size_t inca, const int* b, std::size_t ldb, std::size_t incb,
+                      int* c, std::size_t ldc, std::size_t incc, std::size_t m, std::size_t n, std::size_t k)
+{
+    multiplyIntegral<int>(gemmMicroKernel, a, lda, inca, b, ldb, incb, getMaxAbs(b, ldb, incb, k, n), nullptr,
+                     c, ldc, incc, m, n, k);
+}
+
+void multiplyMatrices(const std::int64_t* a, std::size_t lda, std::size_t inca, const std::int64_t* b, std::size_t ldb,
+                      std::size_t incb, std::int64_t* c, std::size_t ldc, std::size_t incc,
+                      std::size_t m, std::size_t n, std::size_t k)
+{
+    multiplyIntegral<std::int64_t>(multiplyTile<std::int64_t, std::int64_t>, a, lda, inca, b, ldb, incb,
+                                   getMaxAbs(b, ldb, incb, k, n), nullptr, c, ldc, incc, m, n, k);
+}
+
+void multiplyMatrices(const float* a, std::size_t lda, std::size_t inca, const float* b, std::size_t ldb, std::size_t incb,
+                      float* c, std::size_t ldc, std::size_t incc, std::size_t m, std::size_t n, std::size_t k)
+{
+    multiplyBlocked<float, float>(multiplyTile<float, float>, GEMM_KC, a, lda, inca, b, ldb, incb, nullptr,
+                                  c, ldc, incc, m, n, k);
+}
+
+void multiplyMatrices(const double* a, std::size_t lda, std::size_t inca, const double* b, std::size_t ldb, std::size_t incb,
+                      double* c, std::size_t ldc, std::size_t incc, std::size_t m, std::size_t n, std::size_t k)
+{
+    multiplyBlocked<double, double>(multiplyTile<double, double>, GEMM_KC, a, lda, inca, b, ldb, incb, nullptr,
+                                    c, ldc, incc, m, n, k);
+}
+
+void multiplyMatrices(const int* a, std::size_t lda, std::size_t inca, const GemmPackedOperand<int>& b,
+                      int* c, std::size_t ldc, std::size_t incc, std::size_t m)
+{
+    multiplyIntegral(gemmMicroKernel, a, lda, inca, b.getData(), b.getLd(), b.getInc(), b.getMaxAbs(), b.getPanels(),
+                     c, ldc, incc, m, b.getColCount(), b.getRowCount());
+}
+
+void multiplyMatrices(const std::int64_t* a, std::size_t lda, std::size_t inca, const GemmPackedOperand<std::int64_t>& b,
+                      std::int64_t* c, std::size_t ldc, std::size_t incc, std::size_t m)
+{
+    multiplyIntegral(multiplyTile<std::int64_t, std::int64_t>, a, lda, inca, b.getData(), b.getLd(), b.getInc(),
+                     b.getMaxAbs(), b.getPanels(), c, ldc, incc, m, b.getColCount(), b.getRowCount());
+}
+
+void multiplyMatrices(const float* a, std::size_t lda, std::size_t inca, const GemmPackedOperand<float>& b,
+                      float* c, std::size_t ldc, std::size_t incc, std::size_t m)
+{
+    multiplyBlocked(multiplyTile<float, float>, GEMM_KC, a, lda, inca, b.getData(), b.getLd(), b.getInc(), b.getPanels(),
+                    c, ldc, incc, m, b.getColCount(), b.getRowCount());
+}
+
+void multiplyMatrices(const double* a, std::size_t lda, std::size_t inca, const GemmPackedOperand<double>& b,
+                      double* c, std::size_t ldc, std::size_t incc, std::size_t m)
+{
+    multiplyBlocked(multiplyTile<double, double>, GEMM_KC, a, lda, inca, b.getData(), b.getLd(), b.getInc(), b.getPanels(),
+                    c, ldc, incc, m, b.getColCount(), b.getRowCount());
+}
@@ -0,0 +1,202 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "aligned.h"
+
+/*
+ * Integer matrix product with cache blocking.
+ *
+ * Matrices are row-major, a leading dimension is the distance between rows in elements.
+ * The product is computed in the classic blocked order: a panel of GEMM_NC columns of B is packed once,
+ * then for every block of GEMM_MC rows of A and every GEMM_KC deep slice the block of A is packed
+ * into micro-panels of GEMM_MR rows, which stay in L2, while a micro-panel of GEMM_NR columns of B
+ * stays in L1. A micro-kernel multiplies a GEMM_MR x GEMM_NR tile. Integer products are accumulated
+ * in 64 bits when the operands allow it, in 64-bit slices summed in 128 bits when a slice allows it
+ * and exactly otherwise, all in the blocked order. Floating point products are accumulated in the element type.
+ */
+
+/* Rows of a micro-kernel tile */
+const std::size_t GEMM_MR = 6;
+/* Columns of a micro-kernel tile */
+const std::size_t GEMM_NR = 8;
+/* Depth of a packed slice */
+const std::size_t GEMM_KC = 256;
+/* Rows of a packed block of A */
+const std::size_t GEMM_MC = 72;
+/* Columns of a packed panel of B */
+const std::size_t GEMM_NC = 256;
+/* Largest m * n * k of a product computed directly, packing doesn't pay off below it */
+const std::size_t GEMM_DIRECT_LIMIT = 16 * 16 * 16;
+
+/**
+ * Micro-kernel: add the product of a packed GEMM_MR x depth micro-panel of A (column after column)
+ * and a packed depth x GEMM_NR micro-panel of B (row after row) to the tile c with leading dimension ldc.
+ * b and the rows of c are aligned to MATRIX_ALIGNMENT, the kernels use aligned vector loads.
+ */
+typedef void (*GemmMicroKernel)(std::size_t depth, const int* a, const int* b, std::int64_t* c, std::size_t ldc);
+
+/* Portable micro-kernel */
+void gemmMicroKernelScalar(std::size_t depth, const int* a, const int* b, std::int64_t* c, std::size_t ldc);
+#if defined(__x86_64__) || defined(__i386__)
+/* AVX2 micro-kernel, four 64-bit products per instruction */
+void gemmMicroKernelAvx2(std::size_t depth, const int* a, const int* b, std::int64_t* c, std::size_t ldc);
+#endif
+
+/* The fastest micro-kernel supported by the CPU, selected at startup */
+extern const GemmMicroKernel gemmMicroKernel;
+
+/* Name of the selected micro-kernel */
+const char* getGemmKernelName();
+
+/* Exact sum of products of floating point elements, that is just their sum */
+template<typename Element, bool isIntegral = std::is_integral<Element>::value>
+class DotAccumulator
+{
+private:
+    Element m_sum = 0; /* sum of the products */
+public:
+    /* Add a product */
+    void add(Element lhs, Element rhs)
+    {
+        m_sum += lhs * rhs;
+    }
+    /* Get the sum */
+    bool get(Element& result) const
+    {
+        result = m_sum;
+        return true;
+    }
+};
+
+/*
+ * Exact sum of products of integer elements.
+ * Products of 64-bit values are exact in 128 bits, a sum that wraps around 128 bits is counted in the carry,
+ * so any sum which fits into the element type is restored exactly.
+ */
+template<typename Element>
+class DotAccumulator<Element, true>
+{
+private:
+    __int128 m_sum = 0; /* sum of the products modulo 2^128 */
+    int m_carry = 0;    /* signed count of wraparounds */
+public:
+    /* Add a product */
+    void add(Element lhs, Element rhs)
+    {
+        const __int128 product = static_cast<__int128>(lhs) * rhs;
+        if (__builtin_add_overflow(m_sum, product, &m_sum))
+        {
+            m_carry += product < 0 ? -1 : 1;
+        }
+    }
+    /* Get the sum, return false if it doesn't fit into the element type */
+    bool get(Element& result) const
+    {
+        if (m_carry || m_sum < std::numeric_limits<Element>::min() || m_sum > std::numeric_limits<Element>::max())
+        {
+            return false;
+        }
+        result = static_cast<Element>(m_sum);
+        return true;
+    }
+};
+
+/**
+ * Right operand B of products with several row blocks of a left operand, like the blocks multiplied in parallel:
+ * B is packed into micro-panels over the whole depth and the largest absolute value of its integer elements
+ * is found once instead of in every product. B itself must outlive the operand, small products read it directly.
+ */
+template<typename Element>
+class GemmPackedOperand
+{
+private:
+    const Element* m_data;   /* B */
+    std::size_t m_ld;        /* distance between rows of B */
+    std::size_t m_inc;       /* distance between columns of B */
+    std::size_t m_rowCount;  /* depth of the products */
+    std::size_t m_colCount;  /* columns of B */
+    std::uint64_t m_maxAbs;  /* largest absolute value of B, zero for floating point elements */
+    std::vector<Element, AlignedAllocator<Element>> m_panels; /* micro-panels of GEMM_NR columns, column after column */
+public:
+    /* Pack the k x n matrix B */
+    GemmPackedOperand(const Element* b, std::size_t ldb, std::size_t incb, std::size_t k, std::size_t n);
+    const Element* getData() const
+    {
+        return m_data;
+    }
+    std::size_t getLd() const
+    {
+        return m_ld;
+    }
+    std::size_t getInc() const
+    {
+        return m_inc;
+    }
+    std::size_t getRowCount() const
+    {
+        return m_rowCount;
+    }
+    std::size_t getColCount() const
+    {
+        return m_colCount;
+    }
+    std::uint64_t getMaxAbs() const
+    {
+        return m_maxAbs;
+    }
+    /* Get the micro-panels, the one of column j starts at j * depth */
+    const Element* getPanels() const
+    {
+        return m_panels.data();
+    }
+};
+
+extern template class GemmPackedOperand<int>;
+extern template class GemmPackedOperand<std::int64_t>;
+extern template class GemmPackedOperand<float>;
+extern template class GemmPackedOperand<double>;
+
+/**
+ * Compute c = a * b with strided operands, see the row-major version below.
+ * inc is the distance between columns, a transposed operand is passed by swapping its ld and inc.
+ * The operands are packed anyway, so only the packing and the final stores depend on the strides.
+ */
+void multiplyMatrices(const int* a, std::size_t lda, std::size_t inca, const int* b, std::size_t ldb, std::size_t incb,
+                      int* c, std::size_t ldc, std::size_t incc, std::size_t m, std::size_t n, std::size_t k);
+void multiplyMatrices(const std::int64_t* a, std::size_t lda, std::size_t inca, const std::int64_t* b, std::size_t ldb,
+                      std::size_t incb, std::int64_t* c, std::size_t ldc, std::size_t incc,
+                      std::size_t m, std::size_t n, std::size_t k);
+void multiplyMatrices(const float* a, std::size_t lda, std::size_t inca, const float* b, std::size_t ldb, std::size_t incb,
+                      float* c, std::size_t ldc, std::size_t incc, std::size_t m, std::size_t n, std::size_t k);
+void multiplyMatrices(const double* a, std::size_t lda, std::size_t inca, const double* b, std::size_t ldb, std::size_t incb,
+                      double* c, std::size_t ldc, std::size_t incc, std::size_t m, std::size_t n, std::size_t k);
+
+/* Compute c = a * b for m rows of a with a packed right operand, see the strided version above */
+void multiplyMatrices(const int* a, std::size_t lda, std::size_t inca, const GemmPackedOperand<int>& b,
+                      int* c, std::size_t ldc, std::size_t incc, std::size_t m);
+void multiplyMatrices(const std::int64_t* a, std::size_t lda, std::size_t inca, const GemmPackedOperand<std::int64_t>& b,
+                      std::int64_t* c, std::size_t ldc, std::size_t incc, std::size_t m);
+void multiplyMatrices(const float* a, std::size_t lda, std::size_t inca, const GemmPackedOperand<float>& b,
+                      float* c, std::size_t ldc, std::size_t incc, std::size_t m);
+void multiplyMatrices(const double* a, std::size_t lda, std::size_t inca, const GemmPackedOperand<double>& b,
+                      double* c, std::size_t ldc, std::size_t incc, std::size_t m);
+
+/**
+ * Compute c = a * b, where a is m x k, b is k x n and c is m x n.
+ * Integer versions throw std::out_of_range if an element of the product doesn't fit into the element type,
+ * c is partially written then.
+ */
+template<typename Element>
+void multiplyMatrices(const Element* a, std::size_t lda, const Element* b, std::size_t ldb, Element* c, std::size_t ldc,
+                      std::size_t m, std::size_t n, std::size_t k)
+{
+    multiplyMatrices(a, lda, 1, b, ldb, 1, c, ldc, 1, m, n, k);
+}
+
+#endif // GEMM_H
@@ -1,115 +1,354 @@
+#include <atomic>
+#include <vector>
+
+#include "gemm.h"
 #include "matrix.h"
+#include "scale.h"
+#include "transpose.h"
+
+namespace
+{
+
+/* Transpose rowCount x colCount values over blocks of source rows in parallel, see transposeValues() */
+template<typename T>
+void transposeRows(const T* source, std::size_t sourceStride, T* target, std::size_t targetStride,
+                   std::size_t rowCount, std::size_t colCount)
+{
+    if (rowCount * colCount < getMatrixParallelism().serialThreshold)
+    {
+        transposeValues(source, sourceStride, target, targetStride, rowCount, colCount);
+        return;
+    }
+    /* a block of rows per thread in whole recursion blocks */
+    std::shared_ptr<MatrixExecutor> executor = getMatrixExecutor();
+    const std::size_t rowsPerThread = (rowCount + executor->getConcurrency() - 1) / executor->getConcurrency();
+    const std::size_t grain = (rowsPerThread + TRANSPOSE_BLOCK_SIZE - 1) / TRANSPOSE_BLOCK_SIZE * TRANSPOSE_BLOCK_SIZE;
+    executor->run(rowCount, grain, [=](std::size_t begin, std::size_t end)
+    {
+        transposeValues(source + begin * sourceStride, sourceStride, target + begin, targetStride, end - begin, colCount);
+    });
+}
+
+/**
+ * Transpose a square matrix in place over strips of TRANSPOSE_BLOCK_SIZE rows in parallel:
+ * a strip transposes its diagonal block and exchanges the rest of its rows with the same columns.
+ */
+template<typename T>
+void transposeStrips(T* data, std::size_t stride, std::size_t size)
+{
+    if (size * size < getMatrixParallelism().serialThreshold)
+    {
+        transposeSquare(data, stride, size);
+        return;
+    }
+    const std::size_t stripCount = (size + TRANSPOSE_BLOCK_SIZE - 1) / TRANSPOSE_BLOCK_SIZE;
+    getMatrixExecutor()->run(stripCount, 1, [=](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t strip = begin; strip < end; ++strip)
+        {
+            const std::size_t first = strip * TRANSPOSE_BLOCK_SIZE;
+            const std::size_t last = std::min(first + TRANSPOSE_BLOCK_SIZE, size);
+            transposeSquare(data + first * stride + first, stride, last - first);
+            transposeSwap(data + first * stride + last, data + last * stride + first, stride, last - first, size - last);
+        }
+    });
+}
+
+}
 
-Matrix::Matrix(int* data, std::size_t rowCount, std::size_t colCount): m_rowCount(rowCount), m_colCount(colCount), m_data(nullptr)
+template<typename T>
+void Matrix<T>::allocate()
 {
-    std::size_t size = getSize();
-    if (!size)
+    if (!getSize())
     {
-        if (colCount || rowCount)
+        if (m_colCount || m_rowCount)
         {
             throw std::out_of_range("Zero aand nonzero matrix sizes mixed");
         }
+        m_stride = 0;
+        m_data = nullptr;
+        return;
+    }
+    m_stride = getAlignedStride<T>(m_colCount);
+    m_data = allocateAligned<T>(getStorageSize());
+}
+
+template<typename T>
+void Matrix<T>::clearPadding()
+{
+    for (std::size_t i = 0; i < m_rowCount; ++i)
+    {
+        std::fill(m_data + i * m_stride + m_colCount, m_data + (i + 1) * m_stride, T());
+    }
+}
+
+template<typename T>
+Matrix<T>::Matrix(const T* data, std::size_t rowCount, std::size_t colCount, MatrixLayout layout):
+    m_rowCount(rowCount), m_colCount(colCount), m_stride(0), m_data(nullptr)
+{
+    allocate();
+    if (layout == MatrixLayout::ColumnMajor)
+    {
+        /* column-major data is the row-major transposed matrix */
+        transposeRows(data, m_rowCount, m_data, m_stride, m_colCount, m_rowCount);
     }
     else
     {
-        m_data = new int[size];
-        std::copy(data, data + size, m_data);
+        for (std::size_t i = 0; i < m_rowCount; ++i)
+        {
+            std::copy(data + i * m_colCount, data + (i + 1) * m_colCount, m_data + i * m_stride);
+        }
     }
+    clearPadding();
+}
+
+template<typename T>
+Matrix<T>::Matrix(std::size_t rowCount, std::size_t colCount): m_rowCount(rowCount), m_colCount(colCount), m_stride(0), m_data(nullptr)
+{
+    allocate();
+    std::fill(m_data, m_data + getStorageSize(), T());
 }
 
-Matrix::Matrix(): m_rowCount(0), m_colCount(0), m_data(nullptr)
+template<typename T>
+Matrix<T>::Matrix(): m_rowCount(0), m_colCount(0), m_stride(0), m_data(nullptr)
 {
 }
 
-Matrix::Matrix(const Matrix& other): m_rowCount(other.m_rowCount), m_colCount(other.m_colCount), m_data(nullptr)
+template<typename T>
+Matrix<T>::Matrix(const Matrix& other): m_rowCount(other.m_rowCount), m_colCount(other.m_colCount), m_stride(0), m_data(nullptr)
 {
-    std::size_t size = getSize();
-    m_data = new int[size];
-    std::copy(other.m_data, other.m_data + size, m_data);
+    allocate();
+    std::copy(other.m_data, other.m_data + getStorageSize(), m_data);
 }
 
-Matrix& Matrix::operator=(const Matrix& other)
+template<typename T>
+Matrix<T>& Matrix<T>::operator=(const Matrix& other)
 {
     if(this != &other) {
-        std::size_t size = other.getSize();
-        if (getSize() != size)
+        std::size_t size = other.getStorageSize();
+        if (getStorageSize() != size)
         {
-            delete[] m_data;
-            m_data = new int[size];
+            /* the matrix stays empty if the allocation fails */
+            freeAligned(m_data);
+            m_data = nullptr;
+            m_rowCount = 0;
+            m_colCount = 0;
+            m_stride = 0;
+            m_data = allocateAligned<T>(size);
         }
         std::copy(other.m_data, other.m_data + size, m_data);
         m_rowCount = other.m_rowCount;
         m_colCount = other.m_colCount;
+        m_stride = other.m_stride;
+    }
+    return *this;
+}
+
+template<typename T>
+Matrix<T>::Matrix(Matrix&& other) noexcept: m_rowCount(other.m_rowCount), m_colCount(other.m_colCount), m_stride(other.m_stride), m_data(other.m_data)
+{
+    other.m_rowCount = 0;
+    other.m_colCount = 0;
+    other.m_stride = 0;
+    other.m_data = nullptr;
+}
+
+template<typename T>
+Matrix<T>& Matrix<T>::operator=(Matrix&& other) noexcept
+{
+    if (this != &other)
+    {
+        freeAligned(m_data);
+        m_rowCount = other.m_rowCount;
+        m_colCount = other.m_colCount;
+        m_stride = other.m_stride;
+        m_data = other.m_data;
+        other.m_rowCount = 0;
+        other.m_colCount = 0;
+        other.m_stride = 0;
+        other.m_data = nullptr;
     }
     return *this;
 }
 
-bool Matrix::equals(const Matrix& other) const
+template<typename T>
+bool Matrix<T>::equals(const Matrix& other) const
 {
     if (m_rowCount != other.m_rowCount || m_colCount != other.m_colCount)
     {
         return false;
     }
-    std::size_t const size = getSize();
-    const int* otherData = other.m_data;
-    for (std::size_t i = 0; i < size; ++i)
+    std::atomic<bool> isEqual(true);
+    runRowBlocks(m_rowCount, m_colCount, [this, &other, &isEqual](std::size_t begin, std::size_t end)
     {
-        if (otherData[i] != m_data[i])
+        for (std::size_t i = begin; i < end && isEqual; ++i)
         {
-            return false;
+            const T* row = m_data + i * m_stride;
+            if (!std::equal(row, row + m_colCount, other.m_data + i * m_stride))
+            {
+                isEqual = false;
+            }
+        }
+    });
+    return isEqual;
+}
+
+template<typename T>
+void Matrix<T>::multiply(T factor)
+{
+    /*
+     * The padding is zero, so it may be processed with the values.
+     * Floating point products don't overflow into an error, so they need no check.
+     */
+    if constexpr (!std::is_integral<T>::value)
+    {
+        runRowBlocks(m_rowCount, m_stride, [this, factor](std::size_t begin, std::size_t end)
+        {
+            scaleValues(m_data + begin * m_stride, (end - begin) * m_stride, factor);
+        });
+    }
+    else
+    {
+        /*
+         * If a row block overflows, it is unchanged and the blocks already multiplied are divided back.
+         * The division is exact because the integer products didn't overflow.
+         */
+        std::atomic<bool> overflow(false);
+        std::vector<char> isScaled(m_rowCount);
+        runRowBlocks(m_rowCount, m_stride, [this, factor, &overflow, &isScaled](std::size_t begin, std::size_t end)
+        {
+            if (overflow)
+            {
+                return;
+            }
+            try
+            {
+                scaleValues(m_data + begin * m_stride, (end - begin) * m_stride, factor);
+                std::fill(isScaled.begin() + begin, isScaled.begin() + end, 1);
+            }
+            catch (const std::out_of_range& e)
+            {
+                overflow = true;
+            }
+        });
+        if (overflow)
+        {
+            runRowBlocks(m_rowCount, m_stride, [this, factor, &isScaled](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    if (isScaled[i])
+                    {
+                        std::for_each(m_data + i * m_stride, m_data + (i + 1) * m_stride, [factor](T& value) { value /= factor; });
+                    }
+                }
+            });
+            throw std::out_of_range("Matrix scalar multiplication overflow");
         }
     }
-    return true;
 }
 
-/* Test if multiplicatio n doesn't cause overflow */
-inline void testMul(int lhs, int rhs) {
-    if (lhs > 0 && rhs > 0 && lhs > std::numeric_limits<int>::max() / rhs ||
-        lhs < 0 && rhs > 0 && lhs < std::numeric_limits<int>::min() / rhs ||
-        lhs > 0 && rhs < 0 && rhs < std::numeric_limits<int>::min() / lhs ||
-        lhs < 0 && rhs < 0 && (lhs < std::numeric_limits<int>::min() || rhs < std::numeric_limits<int>::min() || -lhs > std::numeric_limits<int>::max() / -rhs)) {
-        throw std::out_of_range("Matrix scalar multiplication overflow");
+template<typename T>
+Matrix<T> Matrix<T>::createProduct(const ConstMatrixView<T>& lhs, const ConstMatrixView<T>& rhs)
+{
+    if (lhs.getColCount() != rhs.getRowCount())
+    {
+        throw std::out_of_range("Matrix sizes mismatch in multiplication");
     }
+    /* every value is written by the product, only the padding is cleared */
+    Matrix result;
+    result.m_rowCount = lhs.getRowCount();
+    result.m_colCount = rhs.getColCount();
+    result.allocate();
+    result.clearPadding();
+    multiplyViews(lhs, rhs, result.view());
+    return result;
 }
 
-void Matrix::multiply(int factor)
+template<typename T>
+void multiplyViews(const ConstMatrixView<T>& lhs, const ConstMatrixView<T>& rhs, const MatrixView<T>& target)
 {
-    std::size_t size = getSize();
-    if (!factor)
+    if (lhs.getColCount() != rhs.getRowCount() || lhs.getRowCount() != target.getRowCount() ||
+        rhs.getColCount() != target.getColCount())
+    {
+        throw std::out_of_range("Matrix sizes mismatch in multiplication");
+    }
+    const std::size_t m = lhs.getRowCount();
+    const std::size_t n = rhs.getColCount();
+    const std::size_t k = lhs.getColCount();
+    auto multiplyRows = [&lhs, &rhs, &target, n, k](std::size_t begin, std::size_t end)
     {
-        std::memset(m_data, 0, size * sizeof(int));
+        multiplyMatrices(lhs.getData() + begin * lhs.getRowStride(), lhs.getRowStride(), lhs.getColStride(),
+                         rhs.getData(), rhs.getRowStride(), rhs.getColStride(),
+                         target.getData() + begin * target.getRowStride(), target.getRowStride(), target.getColStride(),
+                         end - begin, n, k);
+    };
+    if (m * n * k < getMatrixParallelism().productThreshold)
+    {
+        multiplyRows(0, m);
         return;
     }
+    /* a block of rows per thread, in whole micro-panels and at least a packed block of A; B is packed once for all */
+    std::shared_ptr<MatrixExecutor> executor = getMatrixExecutor();
+    const std::size_t rowsPerThread = (m + executor->getConcurrency() - 1) / executor->getConcurrency();
+    const std::size_t grain = std::max(GEMM_MC, (rowsPerThread + GEMM_MR - 1) / GEMM_MR * GEMM_MR);
+    const GemmPackedOperand<T> packedRhs(rhs.getData(), rhs.getRowStride(), rhs.getColStride(), k, n);
+    executor->run(m, grain, [&lhs, &packedRhs, &target](std::size_t begin, std::size_t end)
+    {
+        multiplyMatrices(lhs.getData() + begin * lhs.getRowStride(), lhs.getRowStride(), lhs.getColStride(), packedRhs,
+                         target.getData() + begin * target.getRowStride(), target.getRowStride(), target.getColStride(),
+                         end - begin);
+    });
+}
 
-    /*
-     * It is cheaper to find extremi of the matrix values and test them against overflow
-     * than to check for overflow on every multiplication.
-     * Also this makes this mutation rollbackable.
-     */
-    const auto minMax = std::minmax_element(m_data, m_data + size);
-    testMul(*minMax.first, factor);
-    testMul(*minMax.second, factor);
-
-    for (std::size_t i = 1; i < size; ++i)
+template<typename T>
+void Matrix<T>::copyTo(T* data, MatrixLayout layout) const
+{
+    if (layout == MatrixLayout::ColumnMajor)
     {
-        m_data[i] *= factor;
+        transposeRows(m_data, m_stride, data, m_rowCount, m_rowCount, m_colCount);
+        return;
+    }
+    for (std::size_t i = 0; i < m_rowCount; ++i)
+    {
+        std::copy(m_data + i * m_stride, m_data + i * m_stride + m_colCount, data + i * m_colCount);
     }
 }
 
-Matrix::Row Matrix::operator[](std::size_t idx)
+template<typename T>
+void Matrix<T>::transpose()
 {
-    if (idx >= m_rowCount)
+    if (m_rowCount == m_colCount)
     {
-        throw std::out_of_range("Matrix row index out of range");
+        transposeStrips(m_data, m_stride, m_rowCount);
+        return;
     }
-    return Row(m_data + idx * m_colCount, m_rowCount);
+    Matrix result;
+    result.m_rowCount = m_colCount;
+    result.m_colCount = m_rowCount;
+    result.allocate();
+    result.clearPadding();
+    transposeRows(m_data, m_stride, result.m_data, result.m_stride, m_rowCount, m_colCount);
+    *this = std::move(result);
 }
 
-int& Matrix::Row::operator[](std::size_t idx)
+template<typename T>
+typename Matrix<T>::Row Matrix<T>::operator[](std::size_t idx)
 {
-    if (idx >= m_size)
+    if (idx >= m_rowCount)
     {
-        throw std::out_of_range("Matrix column index out of range");
+        throw std::out_of_range("Matrix row index out of range");
     }
-    return m_data[idx];
+    return Row(m_data + idx * m_stride, m_colCount);
 }
+
+template class Matrix<int>;
+template class Matrix<std::int64_t>;
+template class Matrix<float>;
+template class Matrix<double>;
+
+template void multiplyViews(const ConstMatrixView<int>&, const ConstMatrixView<int>&, const MatrixView<int>&);
+template void multiplyViews(const ConstMatrixView<std::int64_t>&, const ConstMatrixView<std::int64_t>&,
+                            const MatrixView<std::int64_t>&);
+template void multiplyViews(const ConstMatrixView<float>&, const ConstMatrixView<float>&, const MatrixView<float>&);
+template void multiplyViews(const ConstMatrixView<double>&, const ConstMatrixView<double>&, const MatrixView<double>&);
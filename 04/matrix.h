@@ -2,60 +2,413 @@
 #define MATRIX_H
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <initializer_list>
+#include <limits>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
-/* Integer matrix */
-class Matrix
+#include "aligned.h"
+#include "executor.h"
+#include "expression.h"
+#include "gemm.h"
+#include "view.h"
+
+/* Storage order of external matrix data */
+enum class MatrixLayout
+{
+    RowMajor,   /* rows are placed one after another */
+    ColumnMajor /* columns are placed one after another */
+};
+
+/* Supported element types */
+template<typename T>
+struct IsMatrixElement: std::integral_constant<bool, std::is_same<T, int>::value || std::is_same<T, std::int64_t>::value ||
+                                                     std::is_same<T, float>::value || std::is_same<T, double>::value>
+{
+};
+
+/**
+ * Matrix of R x C elements of type T with the sizes known at compile time.
+ * The elements are stored inline without heap allocation and the products are fully unrolled,
+ * integer operations throw std::out_of_range on overflow like the ones of the run-time sized matrix.
+ * Matrix<T> with the default sizes is the run-time sized matrix, see the specialization below.
+ */
+template<typename T, std::size_t R, std::size_t C>
+class Matrix: public MatrixExpression<Matrix<T, R, C>>
 {
+    static_assert(IsMatrixElement<T>::value, "Matrix elements are int, std::int64_t, float or double");
+    static_assert(R != MATRIX_DYNAMIC && C != MATRIX_DYNAMIC, "Matrix sizes are either both fixed or both dynamic");
+
+    template<typename, std::size_t, std::size_t>
+    friend class Matrix;
 private:
-    /* Matrix row proxy class */
-    class Row {
-        friend class Matrix;
-    private:
-        int* m_data;                         /* link to the row data array */
-        std::size_t& m_size;                 /* matrix row length */
-    public:
-        Row(int* data, std::size_t& size): m_data(data), m_size(size)
+    T m_data[R * C]; /* matrix values placed row after row */
+
+    /* Compute element (I, J) of the product, return false if it doesn't fit into T */
+    template<std::size_t K, std::size_t I, std::size_t J, std::size_t... Indices>
+    bool multiplyElement(const Matrix<T, C, K>& other, T& target, std::index_sequence<Indices...>) const
+    {
+        DotAccumulator<T> sum;
+        (sum.add(m_data[I * C + Indices], other.m_data[Indices * K + J]), ...);
+        return sum.get(target);
+    }
+    /* Compute all elements of the product, return false if some of them doesn't fit into T */
+    template<std::size_t K, std::size_t... Indices>
+    bool multiplyUnrolled(const Matrix<T, C, K>& other, Matrix<T, R, K>& result, std::index_sequence<Indices...>) const
+    {
+        return (multiplyElement<K, Indices / K, Indices % K>(other, result.m_data[Indices], std::make_index_sequence<C>()) & ...);
+    }
+public:
+    typedef T Element;
+
+    /* Zero matrix ctor */
+    Matrix(): m_data()
+    {
+    }
+    /* Verbose ctor, copies R * C values */
+    explicit Matrix(const T* data)
+    {
+        std::copy(data, data + R * C, m_data);
+    }
+    /* Values ctor, the values are placed row after row */
+    Matrix(std::initializer_list<T> values)
+    {
+        if (values.size() != R * C)
+        {
+            throw std::out_of_range("Matrix value count mismatch");
+        }
+        std::copy(values.begin(), values.end(), m_data);
+    }
+    /* Expression ctor, see evaluateExpression() */
+    template<typename Expression>
+    Matrix(const MatrixExpression<Expression>& expression)
+    {
+        const Expression& source = expression.self();
+        if (source.getRowCount() != R || source.getColCount() != C)
+        {
+            throw std::out_of_range("Matrix sizes mismatch in assignment");
+        }
+        evaluateExpression(source, m_data, C);
+    }
+    /* Expression assignment operator, the matrix is unchanged on overflow */
+    template<typename Expression>
+    Matrix& operator=(const MatrixExpression<Expression>& expression)
+    {
+        return *this = Matrix(expression);
+    }
+    /* Get row count */
+    static constexpr std::size_t getRowCount()
+    {
+        return R;
+    }
+    /* Get column count */
+    static constexpr std::size_t getColCount()
+    {
+        return C;
+    }
+    /* Expression leaf: bound of the values */
+    MatrixBound getBound() const
+    {
+        return getElementBound<T>();
+    }
+    /* Expression leaf: check if the values may be read at other positions of the target, see BasicMatrixView::aliases() */
+    template<typename Target>
+    bool aliases(const Target& target) const
+    {
+        return view().aliases(target);
+    }
+    /* Expression leaf: value by row and column */
+    template<typename Value>
+    Value evaluate(std::size_t row, std::size_t col) const
+    {
+        return m_data[row * C + col];
+    }
+    /* Get view of the values */
+    MatrixView<T> view()
+    {
+        return MatrixView<T>(m_data, R, C, C);
+    }
+    /* Get read-only view of the values */
+    ConstMatrixView<T> view() const
+    {
+        return ConstMatrixView<T>(m_data, R, C, C);
+    }
+    operator MatrixView<T>()
+    {
+        return view();
+    }
+    operator ConstMatrixView<T>() const
+    {
+        return view();
+    }
+    /* Get link to the values of a row, checked only in the checked mode, see view.h */
+    T* getRowData(std::size_t idx)
+    {
+        checkMatrixIndex(idx < R, "Matrix row index out of range");
+        return m_data + idx * C;
+    }
+    /* Get link to the values of a row, checked only in the checked mode, see view.h */
+    const T* getRowData(std::size_t idx) const
+    {
+        checkMatrixIndex(idx < R, "Matrix row index out of range");
+        return m_data + idx * C;
+    }
+    /* Get span of a row, checked only in the checked mode, see view.h */
+    MatrixSpan<T> getRow(std::size_t idx)
+    {
+        return MatrixSpan<T>(getRowData(idx), C);
+    }
+    /* Get span of a row, checked only in the checked mode, see view.h */
+    MatrixSpan<const T> getRow(std::size_t idx) const
+    {
+        return MatrixSpan<const T>(getRowData(idx), C);
+    }
+    /* Iterators over the row spans */
+    MatrixRowIterator<T> begin()
+    {
+        return MatrixRowIterator<T>(m_data, C, C);
+    }
+    MatrixRowIterator<T> end()
+    {
+        return MatrixRowIterator<T>(m_data + R * C, C, C);
+    }
+    MatrixRowIterator<const T> begin() const
+    {
+        return MatrixRowIterator<const T>(m_data, C, C);
+    }
+    MatrixRowIterator<const T> end() const
+    {
+        return MatrixRowIterator<const T>(m_data + R * C, C, C);
+    }
+    /* Get row by index */
+    MatrixRow<T> operator[](std::size_t idx)
+    {
+        if (idx >= R)
         {
+            throw std::out_of_range("Matrix row index out of range");
         }
-        const Row& operator=(const Row&)
+        return MatrixRow<T>(m_data + idx * C, C);
+    }
+    /* Equals to operator */
+    bool operator ==(const Matrix& other) const
+    {
+        return std::equal(m_data, m_data + R * C, other.m_data);
+    }
+    /* Inequal to operator */
+    bool operator !=(const Matrix& other) const
+    {
+        return !(*this == other);
+    }
+    /* Scalar multiplication operator, the matrix is unchanged on overflow */
+    Matrix& operator *=(T factor)
+    {
+        return *this = *this * factor;
+    }
+    /* Matrix multiplication operator */
+    template<std::size_t K>
+    Matrix<T, R, K> operator *(const Matrix<T, C, K>& other) const
+    {
+        Matrix<T, R, K> result;
+        if (!multiplyUnrolled(other, result, std::make_index_sequence<R * K>()))
         {
-            return *this;
+            throw std::out_of_range("Matrix multiplication overflow");
         }
-        Row& operator=(Row&&) = delete;
-        Row(const Row&) = delete;
-        Row(Row&&) = delete;
-        /* Access index operator */
-        int& operator[](std::size_t idx);
-    };
+        return result;
+    }
+    /* Matrix multiplication assignment operator, the matrix is unchanged on overflow */
+    Matrix& operator *=(const Matrix<T, C, C>& other)
+    {
+        *this = *this * other;
+        return *this;
+    }
+    /* Addition assignment operator, the matrix is unchanged on overflow */
+    template<typename Expression>
+    Matrix& operator +=(const MatrixExpression<Expression>& other)
+    {
+        return *this = *this + other;
+    }
+    /* Subtraction assignment operator, the matrix is unchanged on overflow */
+    template<typename Expression>
+    Matrix& operator -=(const MatrixExpression<Expression>& other)
+    {
+        return *this = *this - other;
+    }
+};
+
+/**
+ * Matrix of elements of type T with the sizes known at run time.
+ * Integer operations throw std::out_of_range on overflow.
+ * Scalar multiplication, expressions, comparison and products of large matrices run over row blocks
+ * on the matrix executor, see executor.h.
+ */
+template<typename T>
+class Matrix<T, MATRIX_DYNAMIC, MATRIX_DYNAMIC>: public MatrixExpression<Matrix<T>>
+{
+    static_assert(IsMatrixElement<T>::value, "Matrix elements are int, std::int64_t, float or double");
+private:
+    typedef MatrixRow<T> Row;
 
     std::size_t m_rowCount; /* row count */
     std::size_t m_colCount; /* column count */
-    int* m_data;            /* flat array that contains the matrix values placed row after row */
+    std::size_t m_stride;   /* distance between rows in values, rows are padded to whole cache lines */
+    T* m_data;              /* aligned flat array that contains the matrix rows placed one after another */
 private:
     /* Get matrix value count */
     std::size_t getSize() const
     {
         return m_rowCount * m_colCount;
     }
+    /* Get value count of the storage including the padding */
+    std::size_t getStorageSize() const
+    {
+        return m_rowCount * m_stride;
+    }
+    /* Compute the stride and allocate the storage for the current sizes */
+    void allocate();
+    /* Zero the padding of the rows */
+    void clearPadding();
     /* Check if ths matrix is equal to another matrix */
     bool equals(const Matrix& other) const;
-    /* Multiply matrix on scalar */
-    void multiply(int factor);
+    /*
+     * Multiply matrix on scalar in one pass over row blocks in parallel, see scaleValues().
+     * Only integer products are checked: an integer matrix is unchanged if one overflows,
+     * floating point products follow IEEE rules and are never rolled back.
+     */
+    void multiply(T factor);
+    /* Compute product of views without initializing the result first, see multiplyViews() */
+    static Matrix createProduct(const ConstMatrixView<T>& lhs, const ConstMatrixView<T>& rhs);
+
+    friend class BasicMatrixView<T>;
+    friend class BasicMatrixView<const T>;
 public:
+    typedef T Element;
+
     /* Default ctor */
     Matrix();
-    /* Verbose ctor */
-    Matrix(int* data, std::size_t rowCount, std::size_t colCount);
+    /* Verbose ctor, column-major data is transposed into place, see transposeValues() */
+    Matrix(const T* data, std::size_t rowCount, std::size_t colCount, MatrixLayout layout = MatrixLayout::RowMajor);
+    /* Zero matrix ctor */
+    Matrix(std::size_t rowCount, std::size_t colCount);
     /* Copy ctor */
     Matrix(const Matrix& other);
     /* Copy assignment operator */
     Matrix& operator=(const Matrix& other);
+    /* Move ctor, the source becomes an empty matrix */
+    Matrix(Matrix&& other) noexcept;
+    /* Move assignment operator, the source becomes an empty matrix */
+    Matrix& operator=(Matrix&& other) noexcept;
+    /* Expression ctor, evaluates the expression in one pass over row blocks in parallel, see evaluateRows() */
+    template<typename Expression>
+    Matrix(const MatrixExpression<Expression>& expression);
+    /* Expression assignment operator, the matrix is unchanged on overflow */
+    template<typename Expression>
+    Matrix& operator=(const MatrixExpression<Expression>& expression)
+    {
+        return *this = Matrix(expression);
+    }
     ~Matrix()
     {
-        delete[] m_data;
+        freeAligned(m_data);
+    }
+    /* Get row count */
+    std::size_t getRowCount() const
+    {
+        return m_rowCount;
+    }
+    /* Get column count */
+    std::size_t getColCount() const
+    {
+        return m_colCount;
+    }
+    /* Get distance between rows in values, a multiple of MATRIX_ALIGNMENT bytes */
+    std::size_t getStride() const
+    {
+        return m_stride;
+    }
+    /* Expression leaf: bound of the values */
+    MatrixBound getBound() const
+    {
+        return getElementBound<T>();
+    }
+    /* Expression leaf: check if the values may be read at other positions of the target, see BasicMatrixView::aliases() */
+    template<typename Target>
+    bool aliases(const Target& target) const
+    {
+        return view().aliases(target);
+    }
+    /* Expression leaf: value by row and column */
+    template<typename Value>
+    Value evaluate(std::size_t row, std::size_t col) const
+    {
+        return static_cast<const T*>(__builtin_assume_aligned(m_data + row * m_stride, MATRIX_ALIGNMENT))[col];
+    }
+    /* Get view of the values, valid until the matrix is assigned, moved or destroyed */
+    MatrixView<T> view()
+    {
+        return MatrixView<T>(m_data, m_rowCount, m_colCount, m_stride);
+    }
+    /* Get read-only view of the values, valid until the matrix is assigned, moved or destroyed */
+    ConstMatrixView<T> view() const
+    {
+        return ConstMatrixView<T>(m_data, m_rowCount, m_colCount, m_stride);
+    }
+    operator MatrixView<T>()
+    {
+        return view();
+    }
+    operator ConstMatrixView<T>() const
+    {
+        return view();
+    }
+    /* Get link to the values of a row, aligned to MATRIX_ALIGNMENT, checked only in the checked mode, see view.h */
+    T* getRowData(std::size_t idx)
+    {
+        checkMatrixIndex(idx < m_rowCount, "Matrix row index out of range");
+        return static_cast<T*>(__builtin_assume_aligned(m_data + idx * m_stride, MATRIX_ALIGNMENT));
+    }
+    /* Get link to the values of a row, aligned to MATRIX_ALIGNMENT, checked only in the checked mode, see view.h */
+    const T* getRowData(std::size_t idx) const
+    {
+        checkMatrixIndex(idx < m_rowCount, "Matrix row index out of range");
+        return static_cast<const T*>(__builtin_assume_aligned(m_data + idx * m_stride, MATRIX_ALIGNMENT));
     }
+    /* Get span of a row, checked only in the checked mode, see view.h */
+    MatrixSpan<T> getRow(std::size_t idx)
+    {
+        return MatrixSpan<T>(getRowData(idx), m_colCount);
+    }
+    /* Get span of a row, checked only in the checked mode, see view.h */
+    MatrixSpan<const T> getRow(std::size_t idx) const
+    {
+        return MatrixSpan<const T>(getRowData(idx), m_colCount);
+    }
+    /* Iterators over the row spans: rows are padded, so every row is contiguous but the matrix isn't */
+    MatrixRowIterator<T> begin()
+    {
+        return MatrixRowIterator<T>(m_data, m_colCount, m_stride);
+    }
+    MatrixRowIterator<T> end()
+    {
+        return MatrixRowIterator<T>(m_data + getStorageSize(), m_colCount, m_stride);
+    }
+    MatrixRowIterator<const T> begin() const
+    {
+        return MatrixRowIterator<const T>(m_data, m_colCount, m_stride);
+    }
+    MatrixRowIterator<const T> end() const
+    {
+        return MatrixRowIterator<const T>(m_data + getStorageSize(), m_colCount, m_stride);
+    }
+    /* Copy the values to rowCount * colCount values of data in the given order */
+    void copyTo(T* data, MatrixLayout layout = MatrixLayout::RowMajor) const;
+    /**
+     * Transpose the matrix in parallel with the cache-oblivious kernel, see transpose.h.
+     * A square matrix is transposed in place, otherwise the values are moved into new storage.
+     */
+    void transpose();
     /* Get row by index */
     Row operator[](std::size_t idx);
     /* Equals to operator */
@@ -68,12 +421,72 @@ public:
     {
         return !equals(other);
     }
-    /* Scalar multiplication operator */
-    Matrix& operator *=(int factor)
+    /* Scalar multiplication operator, an integer matrix is unchanged on overflow, see multiply() */
+    Matrix& operator *=(T factor)
     {
         multiply(factor);
         return *this;
     }
+    /* Matrix multiplication operator, see multiplyViews() */
+    Matrix operator *(const ConstMatrixView<T>& other) const
+    {
+        return createProduct(*this, other);
+    }
+    /* Matrix multiplication assignment operator, the matrix is unchanged on overflow */
+    Matrix& operator *=(const Matrix& other)
+    {
+        *this = *this * other;
+        return *this;
+    }
+    /* Addition assignment operator, the matrix is unchanged on overflow */
+    template<typename Expression>
+    Matrix& operator +=(const MatrixExpression<Expression>& other)
+    {
+        return *this = *this + other;
+    }
+    /* Subtraction assignment operator, the matrix is unchanged on overflow */
+    template<typename Expression>
+    Matrix& operator -=(const MatrixExpression<Expression>& other)
+    {
+        return *this = *this - other;
+    }
 };
 
+template<typename T>
+template<typename Expression>
+Matrix<T>::Matrix(const MatrixExpression<Expression>& expression): Matrix()
+{
+    const Expression& source = expression.self();
+    m_rowCount = source.getRowCount();
+    m_colCount = source.getColCount();
+    allocate();
+    std::atomic<bool> fits(true);
+    runRowBlocks(m_rowCount, m_colCount, [this, &source, &fits](std::size_t begin, std::size_t end)
+    {
+        if (!evaluateRows(source, m_data, m_stride, begin, end))
+        {
+            fits = false;
+        }
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            std::fill(m_data + i * m_stride + m_colCount, m_data + (i + 1) * m_stride, T());
+        }
+    });
+    if (!fits)
+    {
+        throw std::out_of_range("Matrix expression overflow");
+    }
+}
+
+template<typename T>
+Matrix<typename BasicMatrixView<T>::Element> BasicMatrixView<T>::operator*(const ConstMatrixView<Element>& other) const
+{
+    return Matrix<Element>::createProduct(*this, other);
+}
+
+extern template class Matrix<int>;
+extern template class Matrix<std::int64_t>;
+extern template class Matrix<float>;
+extern template class Matrix<double>;
+
 #endif // MATRIX_H
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "scale.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+ScaleKernel selectKernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return scaleBlockAvx2;
+    }
+#endif
+    return scaleBlockScalar;
+}
+
+/* Block kernel of 64-bit values */
+bool scaleBlockInt64(std::int64_t* data, std::size_t size, std::int64_t factor)
+{
+    bool overflow = false;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        std::int64_t product;
+        overflow |= __builtin_mul_overflow(data[i], factor, &product);
+    }
+    if (overflow)
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] *= factor;
+    }
+    return true;
+}
+
+/* Multiply block after block, divide the multiplied blocks back and throw if a block doesn't fit */
+template<typename T, typename Kernel>
+void scaleBlocks(Kernel kernel, T* data, std::size_t size, T factor)
+{
+    for (std::size_t start = 0; start < size; start += SCALE_BLOCK_SIZE)
+    {
+        if (!kernel(data + start, std::min(SCALE_BLOCK_SIZE, size - start), factor))
+        {
+            /* factor isn't zero here: zero products always fit */
+            for (std::size_t i = 0; i < start; ++i)
+            {
+                data[i] /= factor;
+            }
+            throw std::out_of_range("Matrix scalar multiplication overflow");
+        }
+    }
+}
+
+/* Multiply floating point values, there is nothing to check */
+template<typename T>
+void scaleFloating(T* data, std::size_t size, T factor)
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] *= factor;
+    }
+}
+
+}
+
+bool scaleBlockScalar(int* data, std::size_t size, int factor)
+{
+    /* no branches in the loop, the overflow is reported after the pass */
+    bool overflow = false;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const std::int64_t product = static_cast<std::int64_t>(data[i]) * factor;
+        overflow |= product != static_cast<int>(product);
+    }
+    if (overflow)
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] *= factor;
+    }
+    return true;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * vpmuldq multiplies the even 32-bit lanes into 64-bit products, the odd lanes are shifted down for a second one.
+ * A product fits into int when adding 2^31 leaves its upper half zero, the upper halves are ORed across the block
+ * and tested once. The low halves of both products are blended into the result, so no vpmulld is needed.
+ */
+__attribute__((target("avx2")))
+bool scaleBlockAvx2(int* data, std::size_t size, int factor)
+{
+    const __m256i multiplier = _mm256_set1_epi32(factor);
+    const __m256i bias = _mm256_set1_epi64x(0x80000000LL);
+    const std::size_t vectorSize = size / 8 * 8;
+    __m256i overflow = _mm256_setzero_si256();
+    for (std::size_t i = 0; i < vectorSize; i += 8)
+    {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i even = _mm256_mul_epi32(values, multiplier);
+        const __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(values, 32), multiplier);
+        overflow = _mm256_or_si256(overflow, _mm256_srli_epi64(_mm256_add_epi64(even, bias), 32));
+        overflow = _mm256_or_si256(overflow, _mm256_srli_epi64(_mm256_add_epi64(odd, bias), 32));
+    }
+    if (!_mm256_testz_si256(overflow, overflow) || !scaleBlockScalar(data + vectorSize, size - vectorSize, factor))
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < vectorSize; i += 8)
+    {
+        __m256i* target = reinterpret_cast<__m256i*>(data + i);
+        const __m256i values = _mm256_loadu_si256(target);
+        const __m256i even = _mm256_mul_epi32(values, multiplier);
+        const __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(values, 32), multiplier);
+        _mm256_storeu_si256(target, _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA));
+    }
+    return true;
+}
+
+#endif
+
+const ScaleKernel scaleBlock = selectKernel();
+
+const char* getScaleKernelName()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (scaleBlock == scaleBlockAvx2)
+    {
+        return "avx2";
+    }
+#endif
+    return "scalar";
+}
+
+void scaleValues(int* data, std::size_t size, int factor)
+{
+    scaleBlocks(scaleBlock, data, size, factor);
+}
+
+void scaleValues(std::int64_t* data, std::size_t size, std::int64_t factor)
+{
+    scaleBlocks(scaleBlockInt64, data, size, factor);
+}
+
+void scaleValues(float* data, std::size_t size, float factor)
+{
+    scaleFloating(data, size, factor);
+}
+
+void scaleValues(double* data, std::size_t size, double factor)
+{
+    scaleFloating(data, size, factor);
+}
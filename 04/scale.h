@@ -0,0 +1,46 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Overflow checked multiplication of values on a scalar.
+ *
+ * Values are processed in blocks small enough to stay in L1: a block is checked and then multiplied,
+ * so the values are read from memory and written back once. If a product of a block doesn't fit,
+ * the already multiplied blocks are divided back, which is exact because their products did fit.
+ */
+
+/* Values of a block */
+const std::size_t SCALE_BLOCK_SIZE = 2048;
+
+/**
+ * Block kernel: multiply size values on factor if every product fits into int,
+ * return false and leave the values unchanged otherwise.
+ */
+typedef bool (*ScaleKernel)(int* data, std::size_t size, int factor);
+
+/* Portable block kernel */
+bool scaleBlockScalar(int* data, std::size_t size, int factor);
+#if defined(__x86_64__) || defined(__i386__)
+/* AVX2 block kernel, widening multiplication of eight values at once */
+bool scaleBlockAvx2(int* data, std::size_t size, int factor);
+#endif
+
+/* The fastest block kernel supported by the CPU, selected at startup */
+extern const ScaleKernel scaleBlock;
+
+/* Name of the selected block kernel */
+const char* getScaleKernelName();
+
+/**
+ * Multiply size values on factor.
+ * Integer versions throw std::out_of_range if a product doesn't fit into the value type, the values are unchanged then.
+ */
+void scaleValues(int* data, std::size_t size, int factor);
+void scaleValues(std::int64_t* data, std::size_t size, std::int64_t factor);
+void scaleValues(float* data, std::size_t size, float factor);
+void scaleValues(double* data, std::size_t size, double factor);
+
+#endif // SCALE_H
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "gemm.h"
+#include "sparse.h"
+
+namespace
+{
+
+/* Parts of a parallel product per thread, some slack lets the threads even out rows of different cost */
+const std::size_t PARTS_PER_THREAD = 4;
+
+/* Sum of entries: exact for integers, so only the final sum has to fit into the element type */
+template<typename T>
+using EntrySum = typename std::conditional<std::is_integral<T>::value, __int128, T>::type;
+
+/* Convert a sum of entries to the element type, throw std::out_of_range if it doesn't fit */
+template<typename T>
+T getEntrySum(EntrySum<T> sum)
+{
+    if constexpr (std::is_integral<T>::value)
+    {
+        if (sum < std::numeric_limits<T>::min() || sum > std::numeric_limits<T>::max())
+        {
+            throw std::out_of_range("Sparse matrix entry sum overflow");
+        }
+    }
+    return static_cast<T>(sum);
+}
+
+}
+
+template<typename T>
+CooMatrix<T>::CooMatrix(std::size_t rowCount, std::size_t colCount): m_rowCount(rowCount), m_colCount(colCount)
+{
+}
+
+template<typename T>
+CooMatrix<T>::CooMatrix(const Matrix<T>& matrix): CooMatrix(matrix.getRowCount(), matrix.getColCount())
+{
+    const ConstMatrixView<T> view = matrix.view();
+    for (std::size_t i = 0; i < m_rowCount; ++i)
+    {
+        const T* row = view.getData() + i * view.getRowStride();
+        for (std::size_t j = 0; j < m_colCount; ++j)
+        {
+            if (row[j] != T())
+            {
+                m_rows.push_back(i);
+                m_cols.push_back(j);
+                m_values.push_back(row[j]);
+            }
+        }
+    }
+}
+
+template<typename T>
+CooMatrix<T>::CooMatrix(const CsrMatrix<T>& matrix): CooMatrix(matrix.getRowCount(), matrix.getColCount())
+{
+    const std::vector<std::size_t>& rowOffsets = matrix.getRowOffsets();
+    m_rows.reserve(matrix.getNonZeroCount());
+    for (std::size_t i = 0; i < m_rowCount; ++i)
+    {
+        m_rows.insert(m_rows.end(), rowOffsets[i + 1] - rowOffsets[i], i);
+    }
+    m_cols = matrix.getColIndices();
+    m_values = matrix.getValues();
+}
+
+template<typename T>
+void CooMatrix<T>::add(std::size_t row, std::size_t col, T value)
+{
+    if (row >= m_rowCount)
+    {
+        throw std::out_of_range("Matrix row index out of range");
+    }
+    if (col >= m_colCount)
+    {
+        throw std::out_of_range("Matrix column index out of range");
+    }
+    m_rows.push_back(row);
+    m_cols.push_back(col);
+    m_values.push_back(value);
+}
+
+template<typename T>
+Matrix<T> CooMatrix<T>::toDense() const
+{
+    return CsrMatrix<T>(*this).toDense();
+}
+
+template<typename T>
+CsrMatrix<T>::CsrMatrix(std::size_t rowCount, std::size_t colCount, std::vector<std::size_t> rowOffsets,
+                        std::vector<std::size_t> colIndices, std::vector<T> values):
+    m_rowCount(rowCount), m_colCount(colCount), m_rowOffsets(std::move(rowOffsets)),
+    m_colIndices(std::move(colIndices)), m_values(std::move(values))
+{
+    if (m_rowOffsets.size() != m_rowCount + 1 || m_rowOffsets.front() || m_rowOffsets.back() != m_values.size() ||
+        m_colIndices.size() != m_values.size())
+    {
+        throw std::out_of_range("Sparse matrix arrays mismatch");
+    }
+    for (std::size_t i = 0; i < m_rowCount; ++i)
+    {
+        if (m_rowOffsets[i] > m_rowOffsets[i + 1] || m_rowOffsets[i + 1] > m_values.size())
+        {
+            throw std::out_of_range("Sparse matrix arrays mismatch");
+        }
+        for (std::size_t k = m_rowOffsets[i]; k < m_rowOffsets[i + 1]; ++k)
+        {
+            if (m_colIndices[k] >= m_colCount || (k > m_rowOffsets[i] && m_colIndices[k] <= m_colIndices[k - 1]))
+            {
+                throw std::out_of_range("Sparse matrix column indices out of order");
+            }
+        }
+    }
+}
+
+template<typename T>
+CsrMatrix<T>::CsrMatrix(const Matrix<T>& matrix):
+    m_rowCount(matrix.getRowCount()), m_colCount(matrix.getColCount()), m_rowOffsets(m_rowCount + 1)
+{
+    const ConstMatrixView<T> view = matrix.view();
+    for (std::size_t i = 0; i < m_rowCount; ++i)
+    {
+        const T* row = view.getData() + i * view.getRowStride();
+        for (std::size_t j = 0; j < m_colCount; ++j)
+        {
+            if (row[j] != T())
+            {
+                m_colIndices.push_back(j);
+                m_values.push_back(row[j]);
+            }
+        }
+        m_rowOffsets[i + 1] = m_values.size();
+    }
+}
+
+template<typename T>
+CsrMatrix<T>::CsrMatrix(const CooMatrix<T>& matrix):
+    m_rowCount(matrix.getRowCount()), m_colCount(matrix.getColCount()), m_rowOffsets(m_rowCount + 1)
+{
+    /* counting sort of the entries by row keeps the order of the entries within a row */
+    const std::vector<std::size_t>& rows = matrix.getRows();
+    const std::vector<std::size_t>& cols = matrix.getCols();
+    const std::vector<T>& values = matrix.getValues();
+    std::vector<std::size_t> starts(m_rowCount + 1);
+    for (std::size_t row : rows)
+    {
+        ++starts[row + 1];
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+    std::vector<std::pair<std::size_t, T>> entries(values.size());
+    std::vector<std::size_t> positions(starts.begin(), starts.end() - 1);
+    for (std::size_t k = 0; k < values.size(); ++k)
+    {
+        entries[positions[rows[k]]++] = std::make_pair(cols[k], values[k]);
+    }
+
+    /* then every row is sorted by column, the entries of a column are summed and zero sums are dropped */
+    m_colIndices.reserve(values.size());
+    m_values.reserve(values.size());
+    for (std::size_t i = 0; i < m_rowCount; ++i)
+    {
+        auto begin = entries.begin() + starts[i];
+        auto end = entries.begin() + starts[i + 1];
+        std::stable_sort(begin, end, [](const std::pair<std::size_t, T>& lhs, const std::pair<std::size_t, T>& rhs)
+        {
+            return lhs.first < rhs.first;
+        });
+        while (begin != end)
+        {
+            const std::size_t col = begin->first;
+            EntrySum<T> sum = 0;
+            for (; begin != end && begin->first == col; ++begin)
+            {
+                sum += begin->second;
+            }
+            const T value = getEntrySum<T>(sum);
+            if (value != T())
+            {
+                m_colIndices.push_back(col);
+                m_values.push_back(value);
+            }
+        }
+        m_rowOffsets[i + 1] = m_values.size();
+    }
+}
+
+template<typename T>
+std::vector<std::size_t> CsrMatrix<T>::partitionRows(std::size_t partCount) const
+{
+    /* part p starts at the first row whose values start at or after p / partCount of all values */
+    std::vector<std::size_t> bounds(partCount + 1, m_rowCount);
+    for (std::size_t part = 0; part < partCount; ++part)
+    {
+        const std::size_t target = m_values.size() * part / partCount;
+        bounds[part] = std::min<std::size_t>(std::lower_bound(m_rowOffsets.begin(), m_rowOffsets.end(), target) -
+                                             m_rowOffsets.begin(), m_rowCount);
+    }
+    return bounds;
+}
+
+template<typename T>
+void CsrMatrix<T>::runRowParts(std::size_t costPerValue, const MatrixTask& task) const
+{
+    std::shared_ptr<MatrixExecutor> executor = getMatrixExecutor();
+    const std::size_t partCount = std::min(m_rowCount, executor->getConcurrency() * PARTS_PER_THREAD);
+    if ((m_values.size() + m_rowCount) * costPerValue < getMatrixParallelism().serialThreshold || partCount < 2)
+    {
+        task(0, m_rowCount);
+        return;
+    }
+    const std::vector<std::size_t> bounds = partitionRows(partCount);
+    executor->run(partCount, 1, [&bounds, &task](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t part = begin; part < end; ++part)
+        {
+            if (bounds[part] < bounds[part + 1])
+            {
+                task(bounds[part], bounds[part + 1]);
+            }
+        }
+    });
+}
+
+template<typename T>
+T CsrMatrix<T>::getValue(std::size_t row, std::size_t col) const
+{
+    if (row >= m_rowCount)
+    {
+        throw std::out_of_range("Matrix row index out of range");
+    }
+    if (col >= m_colCount)
+    {
+        throw std::out_of_range("Matrix column index out of range");
+    }
+    auto begin = m_colIndices.begin() + m_rowOffsets[row];
+    auto end = m_colIndices.begin() + m_rowOffsets[row + 1];
+    auto position = std::lower_bound(begin, end, col);
+    return position != end && *position == col ? m_values[position - m_colIndices.begin()] : T();
+}
+
+template<typename T>
+Matrix<T> CsrMatrix<T>::toDense() const
+{
+    Matrix<T> result(m_rowCount, m_colCount);
+    const MatrixView<T> view = result.view();
+    for (std::size_t i = 0; i < m_rowCount; ++i)
+    {
+        T* row = view.getData() + i * view.getRowStride();
+        for (std::size_t k = m_rowOffsets[i]; k < m_rowOffsets[i + 1]; ++k)
+        {
+            row[m_colIndices[k]] = m_values[k];
+        }
+    }
+    return result;
+}
+
+template<typename T>
+std::vector<T> CsrMatrix<T>::operator*(const std::vector<T>& vector) const
+{
+    if (vector.size() != m_colCount)
+    {
+        throw std::out_of_range("Matrix sizes mismatch in multiplication");
+    }
+    std::vector<T> result(m_rowCount);
+    std::atomic<bool> fits(true);
+    runRowParts(1, [this, &vector, &result, &fits](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            DotAccumulator<T> sum;
+            for (std::size_t k = m_rowOffsets[i]; k < m_rowOffsets[i + 1]; ++k)
+            {
+                sum.add(m_values[k], vector[m_colIndices[k]]);
+            }
+            if (!sum.get(result[i]))
+            {
+                fits = false;
+            }
+        }
+    });
+    if (!fits)
+    {
+        throw std::out_of_range("Matrix multiplication overflow");
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> CsrMatrix<T>::operator*(const Matrix<T>& matrix) const
+{
+    if (m_colCount != matrix.getRowCount())
+    {
+        throw std::out_of_range("Matrix sizes mismatch in multiplication");
+    }
+    Matrix<T> result(m_rowCount, matrix.getColCount());
+    const ConstMatrixView<T> source = matrix.view();
+    const MatrixView<T> target = result.view();
+    const std::size_t colCount = matrix.getColCount();
+    std::atomic<bool> fits(true);
+    /* row i of the result is the sum of the dense rows selected by the columns of row i scaled by its values */
+    runRowParts(colCount, [this, &source, &target, colCount, &fits](std::size_t begin, std::size_t end)
+    {
+        std::vector<DotAccumulator<T>> sums(colCount);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            std::fill(sums.begin(), sums.end(), DotAccumulator<T>());
+            for (std::size_t k = m_rowOffsets[i]; k < m_rowOffsets[i + 1]; ++k)
+            {
+                const T value = m_values[k];
+                const T* row = source.getData() + m_colIndices[k] * source.getRowStride();
+                for (std::size_t j = 0; j < colCount; ++j)
+                {
+                    sums[j].add(value, row[j]);
+                }
+            }
+            T* row = target.getData() + i * target.getRowStride();
+            for (std::size_t j = 0; j < colCount; ++j)
+            {
+                if (!sums[j].get(row[j]))
+                {
+                    fits = false;
+                }
+            }
+        }
+    });
+    if (!fits)
+    {
+        throw std::out_of_range("Matrix multiplication overflow");
+    }
+    return result;
+}
+
+template class CooMatrix<int>;
+template class CooMatrix<std::int64_t>;
+template class CooMatrix<float>;
+template class CooMatrix<double>;
+
+template class CsrMatrix<int>;
+template class CsrMatrix<std::int64_t>;
+template class CsrMatrix<float>;
+template class CsrMatrix<double>;
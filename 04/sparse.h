@@ -0,0 +1,170 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "matrix.h"
+
+/*
+ * Sparse matrices.
+ *
+ * CooMatrix is a list of (row, column, value) entries for building a matrix in any order,
+ * CsrMatrix stores the nonzero values row after row with their column indices and is used for arithmetic.
+ * Both store only nonzero values, so a matrix of rowCount x colCount elements takes memory proportional
+ * to the number of nonzero values. Integer arithmetic is exact and throws std::out_of_range on overflow
+ * like the one of Matrix. Products with dense operands run over row parts holding about the same number
+ * of nonzero values on the matrix executor, see executor.h.
+ */
+
+template<typename T>
+class CsrMatrix;
+
+/* Sparse matrix in coordinate format */
+template<typename T>
+class CooMatrix
+{
+    static_assert(IsMatrixElement<T>::value, "Matrix elements are int, std::int64_t, float or double");
+private:
+    std::size_t m_rowCount;           /* row count */
+    std::size_t m_colCount;           /* column count */
+    std::vector<std::size_t> m_rows;  /* row indices of the entries */
+    std::vector<std::size_t> m_cols;  /* column indices of the entries */
+    std::vector<T> m_values;          /* values of the entries */
+public:
+    typedef T Element;
+
+    /* Empty matrix ctor */
+    CooMatrix(std::size_t rowCount, std::size_t colCount);
+    /* Nonzero values of a dense matrix */
+    explicit CooMatrix(const Matrix<T>& matrix);
+    /* Values of a CSR matrix */
+    explicit CooMatrix(const CsrMatrix<T>& matrix);
+    /* Add an entry, the values of the entries at the same position are summed */
+    void add(std::size_t row, std::size_t col, T value);
+    /* Get row count */
+    std::size_t getRowCount() const
+    {
+        return m_rowCount;
+    }
+    /* Get column count */
+    std::size_t getColCount() const
+    {
+        return m_colCount;
+    }
+    /* Get entry count */
+    std::size_t getEntryCount() const
+    {
+        return m_values.size();
+    }
+    /* Get row indices of the entries */
+    const std::vector<std::size_t>& getRows() const
+    {
+        return m_rows;
+    }
+    /* Get column indices of the entries */
+    const std::vector<std::size_t>& getCols() const
+    {
+        return m_cols;
+    }
+    /* Get values of the entries */
+    const std::vector<T>& getValues() const
+    {
+        return m_values;
+    }
+    /* Get the dense matrix, throws std::out_of_range if a sum of entries overflows */
+    Matrix<T> toDense() const;
+};
+
+/* Sparse matrix in compressed sparse row format */
+template<typename T>
+class CsrMatrix
+{
+    static_assert(IsMatrixElement<T>::value, "Matrix elements are int, std::int64_t, float or double");
+private:
+    std::size_t m_rowCount;                 /* row count */
+    std::size_t m_colCount;                 /* column count */
+    std::vector<std::size_t> m_rowOffsets;  /* values of row i are [m_rowOffsets[i], m_rowOffsets[i + 1]) */
+    std::vector<std::size_t> m_colIndices;  /* column indices of the values, increasing in every row */
+    std::vector<T> m_values;                /* nonzero values placed row after row */
+
+    /* Row boundaries of partCount parts holding about the same number of values */
+    std::vector<std::size_t> partitionRows(std::size_t partCount) const;
+    /* Run task over row parts balanced by values in parallel, or serially for small matrices */
+    void runRowParts(std::size_t costPerValue, const MatrixTask& task) const;
+public:
+    typedef T Element;
+
+    /* Verbose ctor, throws std::out_of_range if the arrays don't describe a matrix in CSR format */
+    CsrMatrix(std::size_t rowCount, std::size_t colCount, std::vector<std::size_t> rowOffsets,
+              std::vector<std::size_t> colIndices, std::vector<T> values);
+    /* Nonzero values of a dense matrix */
+    explicit CsrMatrix(const Matrix<T>& matrix);
+    /**
+     * Values of a COO matrix, the entries at the same position are summed and zero sums are dropped.
+     * Throws std::out_of_range if an integer sum doesn't fit into the element type.
+     */
+    explicit CsrMatrix(const CooMatrix<T>& matrix);
+    /* Get row count */
+    std::size_t getRowCount() const
+    {
+        return m_rowCount;
+    }
+    /* Get column count */
+    std::size_t getColCount() const
+    {
+        return m_colCount;
+    }
+    /* Get number of the stored values */
+    std::size_t getNonZeroCount() const
+    {
+        return m_values.size();
+    }
+    /* Get row offsets, rowCount + 1 values */
+    const std::vector<std::size_t>& getRowOffsets() const
+    {
+        return m_rowOffsets;
+    }
+    /* Get column indices of the values */
+    const std::vector<std::size_t>& getColIndices() const
+    {
+        return m_colIndices;
+    }
+    /* Get the values */
+    const std::vector<T>& getValues() const
+    {
+        return m_values;
+    }
+    /* Get value by row and column, zero if it isn't stored */
+    T getValue(std::size_t row, std::size_t col) const;
+    /* Get the dense matrix */
+    Matrix<T> toDense() const;
+    /* Sparse matrix by dense vector product */
+    std::vector<T> operator *(const std::vector<T>& vector) const;
+    /* Sparse matrix by dense matrix product */
+    Matrix<T> operator *(const Matrix<T>& matrix) const;
+    /* Equals to operator, compares the sizes and the stored values */
+    bool operator ==(const CsrMatrix& other) const
+    {
+        return m_rowCount == other.m_rowCount && m_colCount == other.m_colCount && m_rowOffsets == other.m_rowOffsets &&
+               m_colIndices == other.m_colIndices && m_values == other.m_values;
+    }
+    /* Inequal to operator */
+    bool operator !=(const CsrMatrix& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+extern template class CooMatrix<int>;
+extern template class CooMatrix<std::int64_t>;
+extern template class CooMatrix<float>;
+extern template class CooMatrix<double>;
+
+extern template class CsrMatrix<int>;
+extern template class CsrMatrix<std::int64_t>;
+extern template class CsrMatrix<float>;
+extern template class CsrMatrix<double>;
+
+#endif // SPARSE_H
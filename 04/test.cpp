@@ -1,35 +1,46 @@
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <random>
+#include <future>
 #include <sstream>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "../09/threadpool.h"
+#include "gemm.h"
 #include "matrix.h"
+#include "scale.h"
+#include "sparse.h"
+#include "transpose.h"
 
 /*
  * Create simple matrices.
  */
-Matrix createMatrix2x2_1()
+Matrix<int> createMatrix2x2_1()
 {
     int* data = new int[4];
     for (std::size_t i = 0; i < 4; ++i)
     {
         data[i] = i;
     }
-    Matrix result(data, 2, 2);
+    Matrix<int> result(data, 2, 2);
     delete[] data;
     return result;
 }
-Matrix createMatrix2x2_2()
+Matrix<int> createMatrix2x2_2()
 {
     int* data = new int[4];
     for (std::size_t i = 0; i < 4; ++i)
     {
         data[i] = i + 1;
     }
-    Matrix result(data, 2, 2);
+    Matrix<int> result(data, 2, 2);
     delete[] data;
     return result;
 }
-Matrix createMatrix2x2_3()
+Matrix<int> createMatrix2x2_3()
 {
     int* data = new int[4];
     for (std::size_t i = 0; i < 4; ++i)
@@ -37,33 +48,33 @@ Matrix createMatrix2x2_3()
         data[i] = i;
         data[i] *= -57;
     }
-    Matrix result(data, 2, 2);
+    Matrix<int> result(data, 2, 2);
     delete[] data;
     return result;
 }
-Matrix createMatrix2x2_zero()
+Matrix<int> createMatrix2x2_zero()
 {
     int* data = new int[4];
     for (std::size_t i = 0; i < 4; ++i)
     {
         data[i] = 0;
     }
-    Matrix result(data, 2, 2);
+    Matrix<int> result(data, 2, 2);
     delete[] data;
     return result;
 }
-Matrix createMatrix4x5()
+Matrix<int> createMatrix4x5()
 {
     int* data = new int[20];
     for (std::size_t i = 0; i < 20; ++i)
     {
         data[i] = i;
     }
-    Matrix result(data, 4, 5);
+    Matrix<int> result(data, 4, 5);
     delete[] data;
     return result;
 }
-std::vector<Matrix> createMatrices()
+std::vector<Matrix<int>> createMatrices()
 {
     return { createMatrix2x2_1(), createMatrix2x2_2(), createMatrix2x2_3(), createMatrix2x2_zero(), createMatrix4x5() };
 }
@@ -71,20 +82,20 @@ std::vector<Matrix> createMatrices()
 /* Test creation matrices of illegal size */
 bool testBadInit() {
     try {
-        Matrix result(nullptr, 0, 5);
+        Matrix<int> result(nullptr, 0, 5);
         return false;
-    } catch (const std::out_of_range& e) {
+    } catch (const std::out_of_range&) {
         return true;
     }
     try {
-        Matrix result(nullptr, 100, 0);
+        Matrix<int> result(nullptr, 100, 0);
         return false;
-    } catch (const std::out_of_range& e) {
+    } catch (const std::out_of_range&) {
     }
     try {
-        Matrix result(nullptr, 0, 0);
+        Matrix<int> result(nullptr, 0, 0);
         return false;
-    } catch (const std::out_of_range& e) {
+    } catch (const std::out_of_range&) {
     }
     return true;
 }
@@ -110,7 +121,7 @@ bool testAssignment() {
     auto v = createMatrices();
 
    for(auto const& value: v) {
-       Matrix matrix = value;
+       Matrix<int> matrix = value;
        if (matrix != value)
        {
            return false;
@@ -121,8 +132,8 @@ bool testAssignment() {
 
 /* Test access to matrix element by index */
 bool testValueAccess() {
-    Matrix m = createMatrix2x2_1();
-    Matrix target = createMatrix2x2_3();
+    Matrix<int> m = createMatrix2x2_1();
+    Matrix<int> target = createMatrix2x2_3();
 
    m[0][0] = target[0][0];
    m[0][1] = target[0][1];
@@ -133,7 +144,7 @@ bool testValueAccess() {
        m[3];
        m[0][7];
        return false;
-   } catch (const std::out_of_range& e) {
+   } catch (const std::out_of_range&) {
    }
 
    return m == target;
@@ -141,8 +152,8 @@ bool testValueAccess() {
 
 /* Test matrix multiplication on scalar */
 bool testScalarMultiplication() {
-    Matrix m = createMatrix2x2_1();
-    Matrix target = createMatrix2x2_3();
+    Matrix<int> m = createMatrix2x2_1();
+    Matrix<int> target = createMatrix2x2_3();
     m *= -57;
     if (m != target)
     {
@@ -150,7 +161,7 @@ bool testScalarMultiplication() {
     }
 
     m = createMatrix2x2_1();
-    Matrix zero = createMatrix2x2_zero();
+    Matrix<int> zero = createMatrix2x2_zero();
     m *= 0;
     if (m != zero)
     {
@@ -161,19 +172,1204 @@ bool testScalarMultiplication() {
         m = createMatrix2x2_1();
         m *= std::numeric_limits<int>::max();
         return false;
-    } catch (const std::out_of_range& e) {
+    } catch (const std::out_of_range&) {
     }
 
     try {
         m = createMatrix2x2_1();
         m *= std::numeric_limits<int>::min();
         return false;
-    } catch (const std::out_of_range& e) {
+    } catch (const std::out_of_range&) {
     }
 
    return true;
 }
 
+/* Create a matrix of random values in [-range, range] */
+template<typename T = int>
+Matrix<T> createRandomMatrix(std::size_t rowCount, std::size_t colCount, std::int64_t range, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<std::int64_t> value(-range, range);
+    std::vector<T> data(rowCount * colCount);
+    for (T& element : data)
+    {
+        element = static_cast<T>(value(generator));
+    }
+    return Matrix<T>(data.data(), rowCount, colCount);
+}
+
+/* Reference triple loop product */
+template<typename T>
+Matrix<T> multiplyNaive(Matrix<T>& lhs, Matrix<T>& rhs)
+{
+    Matrix<T> result(lhs.getRowCount(), rhs.getColCount());
+    for (std::size_t i = 0; i < lhs.getRowCount(); ++i)
+    {
+        for (std::size_t j = 0; j < rhs.getColCount(); ++j)
+        {
+            DotAccumulator<T> sum;
+            for (std::size_t k = 0; k < lhs.getColCount(); ++k)
+            {
+                sum.add(lhs[i][k], rhs[k][j]);
+            }
+            sum.get(result[i][j]);
+        }
+    }
+    return result;
+}
+
+/*
+ * Operands of values up to range whose products cancel in pairs except for the last small one,
+ * so partial sums are large while the product fits into the element type
+ */
+template<typename T>
+std::pair<Matrix<T>, Matrix<T>> createCancellingOperands(std::size_t m, std::size_t n, std::size_t pairCount,
+                                                         std::int64_t range, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<std::int64_t> value(-range, range);
+    std::uniform_int_distribution<std::int64_t> small(-1000, 1000);
+    const std::size_t k = 2 * pairCount + 1;
+    std::vector<T> a(m * k);
+    std::vector<T> b(k * n);
+    for (std::size_t i = 0; i < m; ++i)
+    {
+        for (std::size_t p = 0; p < pairCount; ++p)
+        {
+            a[i * k + 2 * p] = a[i * k + 2 * p + 1] = static_cast<T>(value(generator));
+        }
+        a[i * k + k - 1] = static_cast<T>(small(generator));
+    }
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        for (std::size_t p = 0; p < pairCount; ++p)
+        {
+            b[2 * p * n + j] = static_cast<T>(value(generator));
+            b[(2 * p + 1) * n + j] = -b[2 * p * n + j];
+        }
+        b[(k - 1) * n + j] = static_cast<T>(small(generator));
+    }
+    return std::make_pair(Matrix<T>(a.data(), m, k), Matrix<T>(b.data(), k, n));
+}
+
+/* Test that products with large partial sums are exact: in 128-bit sums of 64-bit slices and in exact tiles */
+bool testWideProducts() {
+    const std::int64_t intMax = std::numeric_limits<int>::max();
+    const std::int64_t int64Max = std::numeric_limits<std::int64_t>::max();
+    /* full range int: a slice is two products deep; 2^26 values: slices of GEMM_KC; full range int64: exact tiles */
+    auto full = createCancellingOperands<int>(67, 129, 150, intMax, 1);
+    auto medium = createCancellingOperands<int>(8, 9, 1500, 1 << 26, 2);
+    auto huge = createCancellingOperands<std::int64_t>(20, 30, 20, int64Max, 3);
+    Matrix<int> fullProduct = full.first * full.second;
+    Matrix<int> mediumProduct = medium.first * medium.second;
+    Matrix<std::int64_t> hugeProduct = huge.first * huge.second;
+    if (fullProduct != multiplyNaive(full.first, full.second) ||
+        mediumProduct != multiplyNaive(medium.first, medium.second) ||
+        hugeProduct != multiplyNaive(huge.first, huge.second))
+    {
+        return false;
+    }
+    /* the last small terms are still there */
+    int lastTerm = full.first[0][300] * full.second[300][0];
+    if (fullProduct[0][0] != lastTerm)
+    {
+        return false;
+    }
+    /* large results still overflow */
+    std::vector<int> maxData(10 * 301, static_cast<int>(intMax));
+    Matrix<int> lhs(maxData.data(), 10, 301);
+    Matrix<int> rhs(maxData.data(), 301, 10);
+    try
+    {
+        lhs * rhs;
+        return false;
+    }
+    catch (const std::out_of_range&)
+    {
+    }
+    return true;
+}
+
+/* Multiply row blocks of lhs by rhs packed once, the way the parallel product splits the work */
+template<typename T>
+Matrix<T> multiplyPacked(const Matrix<T>& lhs, const Matrix<T>& rhs, std::size_t blockRows)
+{
+    Matrix<T> result(lhs.getRowCount(), rhs.getColCount());
+    const ConstMatrixView<T> a = lhs.view();
+    const ConstMatrixView<T> b = rhs.view();
+    const MatrixView<T> c = result.view();
+    const GemmPackedOperand<T> packed(b.getData(), b.getRowStride(), b.getColStride(), b.getRowCount(), b.getColCount());
+    for (std::size_t begin = 0; begin < a.getRowCount(); begin += blockRows)
+    {
+        multiplyMatrices(a.getData() + begin * a.getRowStride(), a.getRowStride(), a.getColStride(), packed,
+                         c.getData() + begin * c.getRowStride(), c.getRowStride(), c.getColStride(),
+                         std::min(blockRows, a.getRowCount() - begin));
+    }
+    return result;
+}
+
+/* Test products of row blocks with a right operand packed once, on every integer path and over several panels of B */
+bool testPackedOperand() {
+    auto full = createCancellingOperands<int>(67, 129, 150, std::numeric_limits<int>::max(), 4);
+    auto huge = createCancellingOperands<std::int64_t>(20, 30, 20, std::numeric_limits<std::int64_t>::max(), 5);
+    Matrix<int> lhs = createRandomMatrix(100, 300, 1000, 6);
+    Matrix<int> rhs = createRandomMatrix(300, 530, 1000, 7);
+    /* small integers, so that the double products are exact in any summation order */
+    Matrix<double> lhsDouble(lhs.getRowCount(), lhs.getColCount());
+    Matrix<double> rhsDouble(rhs.getRowCount(), rhs.getColCount());
+    for (std::size_t k = 0; k < lhs.getColCount(); ++k)
+    {
+        for (std::size_t i = 0; i < lhs.getRowCount(); ++i)
+        {
+            lhsDouble[i][k] = lhs[i][k];
+        }
+        for (std::size_t j = 0; j < rhs.getColCount(); ++j)
+        {
+            rhsDouble[k][j] = rhs[k][j];
+        }
+    }
+    return multiplyPacked(full.first, full.second, 24) == multiplyNaive(full.first, full.second) &&
+           multiplyPacked(huge.first, huge.second, 7) == multiplyNaive(huge.first, huge.second) &&
+           multiplyPacked(lhs, rhs, 36) == multiplyNaive(lhs, rhs) &&
+           multiplyPacked(lhsDouble, rhsDouble, 36) == multiplyNaive(lhsDouble, rhsDouble);
+}
+
+/* Test scalar multiplication kernels supported by the CPU against each other */
+bool testScaleKernels() {
+    const int max = std::numeric_limits<int>::max();
+    const int min = std::numeric_limits<int>::min();
+    const int factors[] = { 0, 1, -1, 2, -3, 46341, max, min };
+    std::mt19937 generator(5);
+    std::uniform_int_distribution<int> value(-50000, 50000);
+    for (std::size_t size : { 1, 7, 8, 9, 63 })
+    {
+        for (int factor : factors)
+        {
+            std::vector<int> data(size);
+            for (int& element : data)
+            {
+                element = value(generator);
+            }
+            /* an edge value in a vector lane or in the tail */
+            data[size / 2] = factor == -1 ? min : data[size / 2];
+            std::vector<int> expected = data;
+            std::vector<int> actual = data;
+            if (scaleBlockScalar(expected.data(), size, factor) != scaleBlock(actual.data(), size, factor) ||
+                expected != actual)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Test single pass scalar multiplication of matrices larger than a block */
+bool testLargeScalarMultiplication() {
+    Matrix<int> m = createRandomMatrix(100, 333, 1000, 1);
+    Matrix<int> original = m;
+    m *= -7;
+    if (m != Matrix<int>(original * -7))
+    {
+        return false;
+    }
+
+    /* the only overflowing value is in the last block, the multiplied blocks are restored */
+    m = original;
+    m[99][332] = std::numeric_limits<int>::max() / 2 + 1;
+    Matrix<int> target = m;
+    try {
+        m *= 2;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    if (m != target)
+    {
+        return false;
+    }
+
+    Matrix<std::int64_t> wide = createRandomMatrix<std::int64_t>(100, 333, 1000000000000LL, 2);
+    wide[99][332] = std::numeric_limits<std::int64_t>::min();
+    Matrix<std::int64_t> wideTarget = wide;
+    try {
+        wide *= -1;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    if (wide != wideTarget)
+    {
+        return false;
+    }
+
+    Matrix<double> real = createRandomMatrix<double>(100, 333, 1000, 3);
+    Matrix<double> expected = real * 0.5;
+    real *= 0.5;
+    if (real != expected)
+    {
+        return false;
+    }
+
+    /* floating point products overflow to infinity without an exception */
+    real[99][332] = std::numeric_limits<double>::max();
+    real *= 2;
+    return real[99][332] == std::numeric_limits<double>::infinity() && real[0][0] == expected[0][0] * 2;
+}
+
+/* Test micro-kernels supported by the CPU against each other */
+bool testGemmKernels() {
+    const std::size_t depth = 37;
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> value(-100000000, 100000000);
+    std::vector<int, AlignedAllocator<int>> a(GEMM_MR * depth);
+    std::vector<int, AlignedAllocator<int>> b(depth * GEMM_NR);
+    for (int& element : a)
+    {
+        element = value(generator);
+    }
+    for (int& element : b)
+    {
+        element = value(generator);
+    }
+    /* kernels add to the tile */
+    std::vector<std::int64_t, AlignedAllocator<std::int64_t>> expected(GEMM_MR * GEMM_NR, 1);
+    gemmMicroKernelScalar(depth, a.data(), b.data(), expected.data(), GEMM_NR);
+    std::vector<std::int64_t, AlignedAllocator<std::int64_t>> actual(GEMM_MR * GEMM_NR, 1);
+    gemmMicroKernel(depth, a.data(), b.data(), actual.data(), GEMM_NR);
+    return actual == expected;
+}
+
+/* Test matrix multiplication on matrix */
+bool testMatrixMultiplication() {
+    Matrix<int> lhs = createMatrix2x2_1();
+    Matrix<int> rhs = createMatrix2x2_2();
+    int targetData[] = { 3, 4, 11, 16 };
+    if (lhs * rhs != Matrix<int>(targetData, 2, 2))
+    {
+        return false;
+    }
+
+    /* sizes that are not multiples of the tile and block sizes */
+    const std::size_t sizes[][3] = { { 1, 1, 1 }, { 3, 7, 5 }, { 4, 8, 1 }, { 67, 300, 129 }, { 130, 513, 70 } };
+    for (const auto& size : sizes)
+    {
+        Matrix<int> a = createRandomMatrix(size[0], size[1], 1000, 1);
+        Matrix<int> b = createRandomMatrix(size[1], size[2], 1000, 2);
+        Matrix<int> product = a * b;
+        if (product != multiplyNaive(a, b) || product.getRowCount() != size[0] || product.getColCount() != size[2])
+        {
+            return false;
+        }
+    }
+
+    try {
+        lhs * createMatrix4x5();
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+
+    /* the result doesn't fit into int, the target is unchanged */
+    const int max = std::numeric_limits<int>::max();
+    int bigData[] = { max, max, max, max };
+    Matrix<int> big(bigData, 2, 2);
+    try {
+        Matrix<int> target = big;
+        target *= big;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    if (big != Matrix<int>(bigData, 2, 2))
+    {
+        return false;
+    }
+
+    /* partial sums don't fit into 64 bits while the result fits into int */
+    int wideData[] = { max, max, -max, -max };
+    int tallData[] = { max, max, max, max };
+    Matrix<int> wide(wideData, 1, 4);
+    Matrix<int> tall(tallData, 4, 1);
+    if ((wide * tall)[0][0] != 0)
+    {
+        return false;
+    }
+    try {
+        int positiveData[] = { max, max, max, max };
+        Matrix<int>(positiveData, 1, 4) * tall;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    return true;
+}
+
+/* Test moving of matrices */
+bool testMove() {
+    Matrix<int> source = createMatrix4x5();
+    Matrix<int> target(std::move(source));
+    if (target != createMatrix4x5() || source.getRowCount() || source.getColCount() || source != Matrix<int>())
+    {
+        return false;
+    }
+
+    source = createMatrix2x2_1();
+    target = std::move(source);
+    if (target != createMatrix2x2_1() || source != Matrix<int>())
+    {
+        return false;
+    }
+
+    /* the moved-from matrix is usable */
+    source = target;
+    return source == createMatrix2x2_1();
+}
+
+/* Test element-wise arithmetic expressions */
+bool testExpressions() {
+    Matrix<int> a = createRandomMatrix(37, 53, 1000000, 1);
+    Matrix<int> b = createRandomMatrix(37, 53, 1000000, 2);
+    Matrix<int> d = createRandomMatrix(37, 53, 1000000, 3);
+    Matrix<int> c = a * 3 + b - d;
+    Matrix<int> reversed = -2 * (b - a) - d * 5;
+    for (std::size_t i = 0; i < 37; ++i)
+    {
+        for (std::size_t j = 0; j < 53; ++j)
+        {
+            if (c[i][j] != a[i][j] * 3 + b[i][j] - d[i][j] ||
+                reversed[i][j] != -2 * (b[i][j] - a[i][j]) - d[i][j] * 5)
+            {
+                return false;
+            }
+        }
+    }
+
+    /* the target may be an operand */
+    Matrix<int> expected = c * 2 + a;
+    c = c * 2 + a;
+    if (c != expected)
+    {
+        return false;
+    }
+    c -= a;
+    c += b - b;
+    if (c != expected - a)
+    {
+        return false;
+    }
+
+    try {
+        Matrix<int> sum = a + createMatrix4x5();
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+
+    /* the result doesn't fit into int, the target is unchanged */
+    const int max = std::numeric_limits<int>::max();
+    int bigData[] = { max, 1, -max, 0 };
+    Matrix<int> big(bigData, 2, 2);
+    try {
+        Matrix<int> target = big;
+        target += big;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        Matrix<int> target = big;
+        target = big * 3 - big;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    if (big != Matrix<int>(bigData, 2, 2))
+    {
+        return false;
+    }
+
+    /* intermediate values don't fit into int, the result does */
+    if (Matrix<int>(big * 2 - big) != big)
+    {
+        return false;
+    }
+    /* intermediate values don't fit into 64 bits */
+    if (Matrix<int>(big * max * 4 - big * max * 4 + big) != big)
+    {
+        return false;
+    }
+    if (Matrix<int>(createMatrix2x2_zero() * max * max * max) != createMatrix2x2_zero())
+    {
+        return false;
+    }
+    return true;
+}
+
+/* Test products and expressions of an element type against the reference, values are exact in any type */
+template<typename T>
+bool testElementType() {
+    const std::size_t sizes[][3] = { { 1, 1, 1 }, { 5, 3, 9 }, { 67, 300, 129 } };
+    for (const auto& size : sizes)
+    {
+        Matrix<T> a = createRandomMatrix<T>(size[0], size[1], 100, 1);
+        Matrix<T> b = createRandomMatrix<T>(size[1], size[2], 100, 2);
+        if (a * b != multiplyNaive(a, b))
+        {
+            return false;
+        }
+    }
+
+    Matrix<T> a = createRandomMatrix<T>(7, 11, 1000, 3);
+    Matrix<T> b = createRandomMatrix<T>(7, 11, 1000, 4);
+    Matrix<T> c = a * 3 + b - 2 * a;
+    Matrix<T> scaled = a;
+    scaled *= 2;
+    for (std::size_t i = 0; i < 7; ++i)
+    {
+        for (std::size_t j = 0; j < 11; ++j)
+        {
+            if (c[i][j] != a[i][j] + b[i][j] || scaled[i][j] != a[i][j] * 2)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Test the overflow checks of 64-bit integer matrices */
+bool testInt64Overflow() {
+    const std::int64_t max = std::numeric_limits<std::int64_t>::max();
+    std::int64_t wideData[] = { max, max, -max, -max };
+    std::int64_t tallData[] = { max, max, max, max };
+    Matrix<std::int64_t> wide(wideData, 1, 4);
+    Matrix<std::int64_t> tall(tallData, 4, 1);
+    /* partial sums wrap around 128 bits while the result is zero */
+    if ((wide * tall)[0][0] != 0)
+    {
+        return false;
+    }
+    try {
+        Matrix<std::int64_t>(tallData, 1, 4) * tall;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+
+    /* the bound exceeds 64 bits, the values are evaluated in 128 bits */
+    if (Matrix<std::int64_t>(wide * 2 - wide) != wide)
+    {
+        return false;
+    }
+    try {
+        Matrix<std::int64_t> sum = wide + wide;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        Matrix<std::int64_t> target = wide;
+        target *= 2;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+
+    /* the bound exceeds 128 bits, the values are checked one by one */
+    Matrix<std::int64_t> small = createRandomMatrix<std::int64_t>(3, 5, 1000, 4);
+    if (Matrix<std::int64_t>(small * max - small * max + small) != small)
+    {
+        return false;
+    }
+    try {
+        Matrix<std::int64_t> product = wide * max * max;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    return true;
+}
+
+/* Test matrices of compile-time sizes */
+bool testFixedMatrices() {
+    /* values are stored inline */
+    if (sizeof(Matrix<double, 4, 4>) != 16 * sizeof(double) || sizeof(Matrix<int, 3, 3>) != 9 * sizeof(int))
+    {
+        return false;
+    }
+
+    /* products agree with the run-time sized ones */
+    Matrix<int> lhs = createRandomMatrix(3, 4, 1000, 1);
+    Matrix<int> rhs = createRandomMatrix(4, 2, 1000, 2);
+    Matrix<int, 3, 4> fixedLhs;
+    Matrix<int, 4, 2> fixedRhs;
+    fixedLhs = lhs;
+    fixedRhs = Matrix<int, 4, 2>(rhs);
+    Matrix<int, 3, 2> fixedProduct = fixedLhs * fixedRhs;
+    Matrix<int> product = lhs * rhs;
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        for (std::size_t j = 0; j < 2; ++j)
+        {
+            if (fixedProduct[i][j] != product[i][j])
+            {
+                return false;
+            }
+        }
+    }
+
+    /* a rotation by 90 degrees applied four times is the identity */
+    Matrix<double, 3, 3> identity = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+    Matrix<double, 3, 3> rotation = { 0, -1, 0, 1, 0, 0, 0, 0, 1 };
+    Matrix<double, 3, 3> transform = identity;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        transform *= rotation;
+    }
+    if (transform != identity || Matrix<double, 3, 3>(rotation * 2.0 - rotation) != rotation)
+    {
+        return false;
+    }
+    Matrix<float, 4, 4> scale;
+    scale += Matrix<float, 4, 4>() * 2.0f;
+    if (scale != Matrix<float, 4, 4>())
+    {
+        return false;
+    }
+
+    /* overflow leaves the target unchanged */
+    const int max = std::numeric_limits<int>::max();
+    Matrix<int, 2, 2> big = { max, max, max, max };
+    Matrix<int, 2, 2> target = big;
+    try {
+        target *= big;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        target *= 2;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    if (target != big)
+    {
+        return false;
+    }
+    const std::int64_t max64 = std::numeric_limits<std::int64_t>::max();
+    Matrix<std::int64_t, 1, 4> wide = { max64, max64, -max64, -max64 };
+    Matrix<std::int64_t, 4, 1> tall = { max64, max64, max64, max64 };
+    if ((wide * tall)[0][0] != 0)
+    {
+        return false;
+    }
+
+    try {
+        (void)Matrix<int, 2, 2>{ 1, 2, 3 };
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        (void)Matrix<int, 3, 4>(rhs);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        big[2];
+        big[0][2];
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    return true;
+}
+
+/* Test that rows start at aligned addresses and the padding is invisible */
+template<typename T>
+bool testAlignedRows() {
+    const std::size_t colCounts[] = { 1, 15, 16, 17, 33 };
+    for (std::size_t colCount : colCounts)
+    {
+        Matrix<T> a = createRandomMatrix<T>(5, colCount, 1000, 1);
+        Matrix<T> b = a;
+        Matrix<T> c = a + b;
+        if (a.getStride() < colCount || a.getStride() * sizeof(T) % MATRIX_ALIGNMENT || b != a ||
+            c != Matrix<T>(a * 2))
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < 5; ++i)
+        {
+            if (reinterpret_cast<std::uintptr_t>(&a[i][0]) % MATRIX_ALIGNMENT ||
+                reinterpret_cast<std::uintptr_t>(&c[i][0]) % MATRIX_ALIGNMENT)
+            {
+                return false;
+            }
+        }
+    }
+
+    /* run-time and compile-time sized matrices with different strides in one expression */
+    Matrix<T> dynamic = createRandomMatrix<T>(3, 3, 1000, 2);
+    Matrix<T, 3, 3> fixed(dynamic);
+    Matrix<T> sum = dynamic + fixed;
+    Matrix<T, 3, 3> difference = fixed - dynamic;
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        for (std::size_t j = 0; j < 3; ++j)
+        {
+            if (sum[i][j] != dynamic[i][j] * 2 || difference[i][j] != 0)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Test sub-block, range and transposed views */
+bool testViews() {
+    Matrix<int> a = createRandomMatrix(6, 5, 1000, 1);
+    MatrixView<int> block = a.view().block(1, 2, 3, 2);
+    ConstMatrixView<int> transposed = a.view().transposed();
+    if (block.getRowCount() != 3 || block.getColCount() != 2 || transposed.getRowCount() != 5 ||
+        transposed.getColCount() != 6 || block[2][1] != a[3][3] || transposed[4][1] != a[1][4] ||
+        a.view().rows(2, 4)[1][0] != a[3][0] || a.view().cols(1, 3)[5][1] != a[5][2])
+    {
+        return false;
+    }
+
+    /* views share the values with the matrix */
+    block[0][0] = 12345;
+    if (a[1][2] != 12345 || transposed[2][1] != 12345 || Matrix<int>(block)[0][0] != 12345)
+    {
+        return false;
+    }
+    try {
+        a.view().block(4, 0, 3, 1);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        a.view().cols(3, 2);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        block[3];
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        block[0][2];
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+
+    /* assignment writes the values, the expression may refer to the view at the same or other positions */
+    Matrix<int> b = createRandomMatrix(6, 5, 1000, 2);
+    Matrix<int> expected = a;
+    a.view().block(0, 0, 2, 2) = b.view().block(4, 3, 2, 2) * 2 + a.view().block(0, 0, 2, 2);
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        for (std::size_t j = 0; j < 2; ++j)
+        {
+            expected[i][j] = b[4 + i][3 + j] * 2 + expected[i][j];
+        }
+    }
+    if (a != expected)
+    {
+        return false;
+    }
+    b[0][0] = std::numeric_limits<int>::max();
+    try {
+        a.view().block(0, 0, 2, 2) = b.view().block(0, 0, 2, 2) * 2;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    MatrixView<int> square = a.view().block(1, 1, 4, 4);
+    const Matrix<int> original(square);
+    square.copyFrom(square.transposed());
+    if (a == expected || square != original.view().transposed() || a.view().rows(5, 6) != expected.view().rows(5, 6))
+    {
+        return false;
+    }
+
+    /* strided targets that don't overlap the operands are written directly */
+    Matrix<int> c = createRandomMatrix(5, 6, 1000, 5);
+    Matrix<int> d(6, 5);
+    d.view().transposed() = c.view() * 3 + c.view();
+    if (d != Matrix<int>(c.view().transposed() * 4) || !a.view().aliases(a.view().transposed()) ||
+        a.view().aliases(a.view()) || a.view().rows(0, 2).aliases(a.view().rows(3, 5)))
+    {
+        return false;
+    }
+
+    /* assigning a view rebinds it, so views swap and a read-only view takes a mutable one */
+    MatrixView<int> top = a.view().rows(0, 1);
+    MatrixView<int> bottom = a.view().rows(5, 6);
+    const Matrix<int> beforeSwap = a;
+    std::swap(top, bottom);
+    ConstMatrixView<int> reader = b.view();
+    reader = top;
+    if (a != beforeSwap || top.getData() != &a[5][0] || bottom.getData() != &a[0][0] || reader.getData() != top.getData() ||
+        reader.getRowCount() != 1)
+    {
+        return false;
+    }
+    try {
+        top.copyFrom(square);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+
+    /* products of strided views, small ones and the ones large enough for the blocked kernel */
+    for (std::size_t size : { 5, 90 })
+    {
+        Matrix<int> lhs = createRandomMatrix(size, size + 3, 1000, 3);
+        Matrix<int> rhs = createRandomMatrix(size + 1, size + 2, 1000, 4);
+        Matrix<int> lhsCopy(lhs.view().transposed());
+        Matrix<int> rhsCopy(rhs.view().block(1, 2, size, size));
+        Matrix<int> product = lhs.view().transposed() * rhs.view().block(1, 2, size, size);
+        if (product != multiplyNaive(lhsCopy, rhsCopy))
+        {
+            return false;
+        }
+        /* the product lands into a transposed block of a bigger matrix, the rest stays zero */
+        Matrix<int> target(size + 4, size + 5);
+        multiplyViews<int>(lhsCopy, rhsCopy, target.view().block(2, 1, size, size + 3).transposed());
+        if (Matrix<int>(target.view().block(2, 1, size, size + 3).transposed()) != product ||
+            target.view().rows(0, 2) != Matrix<int>(2, size + 5).view() ||
+            target.view().cols(0, 1) != Matrix<int>(size + 4, 1).view())
+        {
+            return false;
+        }
+    }
+    try {
+        a.view() * a.view();
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    return true;
+}
+
+/* Test the tile kernels against each other */
+bool testTransposeKernels() {
+    std::vector<int> source(11 * 13);
+    for (std::size_t i = 0; i < source.size(); ++i)
+    {
+        source[i] = static_cast<int>(i);
+    }
+    std::vector<int> expected(10 * 12, -1);
+    std::vector<int> actual(expected);
+    transposeTileScalar(source.data() + 14, 13, expected.data() + 13, 12);
+    transposeTile(source.data() + 14, 13, actual.data() + 13, 12);
+    if (expected != actual || expected[13] != 14 || expected[13 + 12] != 15 || expected[14] != 27 || expected[12] != -1)
+    {
+        return false;
+    }
+    return true;
+}
+
+/* Test transposition of matrices of every shape, in place, out of place and in parallel, and the layouts */
+template<typename T>
+bool testTranspose() {
+    const std::size_t sizes[][2] = { { 1, 1 }, { 1, 9 }, { 8, 8 }, { 7, 9 }, { 33, 33 }, { 33, 65 }, { 100, 100 },
+                                     { 129, 40 } };
+    for (const auto& size : sizes)
+    {
+        const Matrix<T> original = createRandomMatrix<T>(size[0], size[1], 1000, 1);
+        const Matrix<T> expected(original.view().transposed());
+        Matrix<T> matrix = original;
+        matrix.transpose();
+        if (matrix != expected || matrix.getRowCount() != size[1] || matrix.getColCount() != size[0])
+        {
+            return false;
+        }
+        matrix.transpose();
+        if (matrix != original)
+        {
+            return false;
+        }
+
+        /* column-major values are the values of the transposed matrix */
+        std::vector<T> values(size[0] * size[1]);
+        original.copyTo(values.data(), MatrixLayout::ColumnMajor);
+        if (Matrix<T>(values.data(), size[1], size[0]) != expected ||
+            Matrix<T>(values.data(), size[0], size[1], MatrixLayout::ColumnMajor) != original)
+        {
+            return false;
+        }
+        std::vector<T> rowMajor(size[0] * size[1]);
+        original.copyTo(rowMajor.data());
+        if (Matrix<T>(rowMajor.data(), size[0], size[1]) != original)
+        {
+            return false;
+        }
+    }
+
+    /* tiny parallel strips and row blocks */
+    const MatrixParallelism defaultParallelism = getMatrixParallelism();
+    MatrixParallelism parallelism = defaultParallelism;
+    parallelism.serialThreshold = 0;
+    setMatrixParallelism(parallelism);
+    setMatrixExecutor(std::make_shared<ForkJoinExecutor>(4));
+    Matrix<T> square = createRandomMatrix<T>(150, 150, 1000, 2);
+    Matrix<T> wide = createRandomMatrix<T>(70, 150, 1000, 3);
+    const Matrix<T> squareExpected(square.view().transposed());
+    const Matrix<T> wideExpected(wide.view().transposed());
+    square.transpose();
+    wide.transpose();
+    setMatrixExecutor(nullptr);
+    setMatrixParallelism(defaultParallelism);
+    return square == squareExpected && wide == wideExpected;
+}
+
+/* Create a random matrix with about one value in density nonzero */
+template<typename T>
+Matrix<T> createSparseMatrix(std::size_t rowCount, std::size_t colCount, std::size_t density, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<std::size_t> position(0, density - 1);
+    std::uniform_int_distribution<int> value(-1000, 1000);
+    Matrix<T> result(rowCount, colCount);
+    for (std::size_t i = 0; i < rowCount; ++i)
+    {
+        for (std::size_t j = 0; j < colCount; ++j)
+        {
+            if (!position(generator))
+            {
+                result[i][j] = static_cast<T>(value(generator));
+            }
+        }
+    }
+    return result;
+}
+
+/* Test sparse formats, conversions and products against dense matrices */
+template<typename T>
+bool testSparse() {
+    const Matrix<T> dense = createSparseMatrix<T>(50, 40, 20, 1);
+    const CsrMatrix<T> csr(dense);
+    const CooMatrix<T> coo(dense);
+    if (csr.toDense() != dense || coo.toDense() != dense || CsrMatrix<T>(coo) != csr ||
+        CsrMatrix<T>(CooMatrix<T>(csr)) != csr || csr.getNonZeroCount() != coo.getEntryCount() ||
+        csr.getNonZeroCount() * 10 > dense.getRowCount() * dense.getColCount())
+    {
+        return false;
+    }
+
+    /* entries in any order, the ones at the same position are summed and zero sums are dropped */
+    CooMatrix<T> entries(3, 4);
+    entries.add(2, 3, 5);
+    entries.add(0, 1, 7);
+    entries.add(2, 0, 1);
+    entries.add(2, 3, -2);
+    entries.add(1, 2, 4);
+    entries.add(1, 2, -4);
+    const CsrMatrix<T> summed(entries);
+    if (summed.getNonZeroCount() != 3 || summed.getValue(2, 3) != 3 || summed.getValue(0, 1) != 7 ||
+        summed.getValue(1, 2) != 0 || summed.getRowOffsets() != std::vector<std::size_t>({ 0, 1, 1, 3 }) ||
+        summed.getColIndices() != std::vector<std::size_t>({ 1, 0, 3 }))
+    {
+        return false;
+    }
+    try {
+        entries.add(3, 0, 1);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        CsrMatrix<T>(2, 3, { 0, 2, 1 }, { 0, 1 }, { 1, 2 });
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        CsrMatrix<T>(2, 3, { 0, 2, 2 }, { 1, 1 }, { 1, 2 });
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+
+    /* products against dense ones, serially and over tiny parts in parallel */
+    const Matrix<T> vector = createRandomMatrix<T>(40, 1, 1000, 2);
+    const Matrix<T> other = createRandomMatrix<T>(40, 30, 1000, 3);
+    std::vector<T> values(40);
+    vector.copyTo(values.data());
+    const Matrix<T> expectedVector = dense * vector;
+    const Matrix<T> expectedProduct = dense * other;
+    const MatrixParallelism defaultParallelism = getMatrixParallelism();
+    MatrixParallelism parallelism = defaultParallelism;
+    parallelism.serialThreshold = 0;
+    bool isPassed = true;
+    for (std::size_t run = 0; run < 2; ++run)
+    {
+        const std::vector<T> product = csr * values;
+        isPassed &= Matrix<T>(product.data(), 50, 1) == expectedVector && csr * other == expectedProduct;
+        setMatrixParallelism(parallelism);
+        setMatrixExecutor(std::make_shared<ForkJoinExecutor>(4));
+    }
+    setMatrixExecutor(nullptr);
+    setMatrixParallelism(defaultParallelism);
+    return isPassed;
+}
+
+/* Test that integer sparse arithmetic throws on overflow */
+bool testSparseOverflow() {
+    CooMatrix<int> entries(2, 2);
+    entries.add(0, 0, std::numeric_limits<int>::max());
+    entries.add(0, 0, 1);
+    try {
+        CsrMatrix<int> overflowing(entries);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    /* only the final sums have to fit */
+    entries.add(0, 0, -1);
+    entries.add(1, 1, std::numeric_limits<int>::max());
+    const CsrMatrix<int> csr(entries);
+    try {
+        csr * std::vector<int>({ 2, 1 });
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        csr * Matrix<int>(std::vector<int>({ 1, 1, 1, 2 }).data(), 2, 2);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        csr * std::vector<int>({ 1 });
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    return csr * std::vector<int>({ 1, -1 }) == std::vector<int>({ std::numeric_limits<int>::max(), -std::numeric_limits<int>::max() });
+}
+
+/* Test row pointers, row spans and row iterators */
+template<typename T>
+bool testUncheckedAccess() {
+    Matrix<T> matrix = createRandomMatrix<T>(7, 19, 1000, 1);
+    const Matrix<T>& constMatrix = matrix;
+    std::size_t rowCount = 0;
+    for (MatrixSpan<const T> row : constMatrix)
+    {
+        if (row.size() != 19 || row.data() != &matrix[rowCount][0] ||
+            row.data() != constMatrix.getRowData(rowCount) || row[18] != matrix[rowCount][18])
+        {
+            return false;
+        }
+        ++rowCount;
+    }
+    if (rowCount != 7 || reinterpret_cast<std::uintptr_t>(matrix.getRowData(3)) % MATRIX_ALIGNMENT)
+    {
+        return false;
+    }
+
+    /* a user loop over the spans, the padding isn't visited */
+    for (MatrixSpan<T> row : matrix)
+    {
+        for (T& value : row)
+        {
+            value *= 2;
+        }
+    }
+    Matrix<T> expected = createRandomMatrix<T>(7, 19, 1000, 1);
+    expected *= 2;
+    if (matrix != expected || Matrix<T>(matrix + matrix) != Matrix<T>(matrix * 2))
+    {
+        return false;
+    }
+    matrix.getRow(6)[0] = 5;
+    matrix.getRowData(5)[1] = 6;
+    if (matrix[6][0] != 5 || matrix[5][1] != 6)
+    {
+        return false;
+    }
+
+    /* compile-time sized matrices */
+    Matrix<T, 2, 3> fixed({ 1, 2, 3, 4, 5, 6 });
+    T sum = 0;
+    for (MatrixSpan<T> row : fixed)
+    {
+        for (T value : row)
+        {
+            sum += value;
+        }
+    }
+    if (sum != 21 || fixed.getRow(1)[2] != 6 || fixed.getRowData(1) != fixed.getRow(0).end())
+    {
+        return false;
+    }
+
+    Matrix<T> empty;
+    if (empty.begin() != empty.end())
+    {
+        return false;
+    }
+#ifdef MATRIX_CHECKED
+    try {
+        matrix.getRowData(7);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        matrix.getRow(0)[19];
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    try {
+        fixed.getRow(2);
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+#endif
+    return true;
+}
+
+/* Minimal thread pool with the interface of the ThreadPool of 09: a thread per task */
+class TestPool
+{
+private:
+    std::vector<std::thread> m_threads; /* started tasks */
+public:
+    ~TestPool()
+    {
+        for (std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+    std::future<void> exec(std::function<void()> function)
+    {
+        std::packaged_task<void()> task(function);
+        std::future<void> result = task.get_future();
+        m_threads.emplace_back(std::move(task));
+        return result;
+    }
+    std::size_t size() const
+    {
+        return 3;
+    }
+};
+
+/* Run the kernels of parallel tests with the given executor and compare them with the serial results */
+bool checkParallelKernels(const std::shared_ptr<MatrixExecutor>& executor) {
+    setMatrixExecutor(std::make_shared<SerialExecutor>());
+    Matrix<int> a = createRandomMatrix(150, 70, 1000, 1);
+    Matrix<int> b = createRandomMatrix(70, 90, 1000, 2);
+    Matrix<int> c = createRandomMatrix(150, 70, 1000, 3);
+    Matrix<int> product = a * b;
+    Matrix<int> sum = a + c * 3;
+    Matrix<int> scaled = a;
+    scaled *= -7;
+
+    setMatrixExecutor(executor);
+    if (product != multiplyNaive(a, b) || !(a * b == product) || Matrix<int>(a + c * 3) != sum)
+    {
+        return false;
+    }
+    Matrix<int> parallelScaled = a;
+    parallelScaled *= -7;
+    if (parallelScaled != scaled || parallelScaled == a)
+    {
+        return false;
+    }
+
+    /* only the last rows overflow, every row block must be rolled back */
+    Matrix<int> big = createRandomMatrix(200, 100, 1000, 4);
+    big[199][99] = std::numeric_limits<int>::max() / 2;
+    const Matrix<int> original = big;
+    try {
+        big *= 1000;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+    if (big != original)
+    {
+        return false;
+    }
+    Matrix<int> overflowing = a;
+    overflowing[149][0] = std::numeric_limits<int>::max();
+    try {
+        Matrix<int> result = overflowing + overflowing;
+        return false;
+    } catch (const std::out_of_range&) {
+    }
+
+    /* errors of the chunks reach the caller */
+    try {
+        executor->run(100, 7, [](std::size_t begin, std::size_t) {
+            if (begin == 42)
+            {
+                throw std::runtime_error("chunk failed");
+            }
+        });
+        return false;
+    } catch (const std::runtime_error&) {
+    }
+    return true;
+}
+
+/* Test nested runs: chunks on every thread of a job call the executor again, directly and through another one */
+bool testNestedRuns() {
+    ForkJoinExecutor outer(4);
+    ForkJoinExecutor inner(3);
+    const std::size_t size = 16;
+    std::vector<std::atomic<int>> counts(size * size);
+    outer.run(size, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            outer.run(size, 3, [&counts, i, size](std::size_t innerBegin, std::size_t innerEnd) {
+                for (std::size_t j = innerBegin; j < innerEnd; ++j)
+                {
+                    ++counts[i * size + j];
+                }
+            });
+        }
+    });
+    std::vector<std::atomic<int>> crossCounts(size * size * size);
+    outer.run(size, 2, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            inner.run(size, 1, [&, i](std::size_t innerBegin, std::size_t innerEnd) {
+                for (std::size_t j = innerBegin; j < innerEnd; ++j)
+                {
+                    outer.run(size, 5, [&, i, j](std::size_t lastBegin, std::size_t lastEnd) {
+                        for (std::size_t k = lastBegin; k < lastEnd; ++k)
+                        {
+                            ++crossCounts[(i * size + j) * size + k];
+                        }
+                    });
+                }
+            });
+        }
+    });
+    for (const std::atomic<int>& count : counts)
+    {
+        if (count != 1)
+        {
+            return false;
+        }
+    }
+    for (const std::atomic<int>& count : crossCounts)
+    {
+        if (count != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Test the parallel kernels with every executor and tiny blocks */
+bool testParallelKernels() {
+    const MatrixParallelism defaultParallelism = getMatrixParallelism();
+    MatrixParallelism parallelism = defaultParallelism;
+    parallelism.grainSize = 64;
+    parallelism.serialThreshold = 0;
+    parallelism.productThreshold = 0;
+    setMatrixParallelism(parallelism);
+
+    TestPool pool;
+    /* the ThreadPool of 09 may miss the wake-up of a thread in its destructor, so it lives until exit */
+    static ThreadPool* threadPool = new ThreadPool(3);
+    const bool isPassed = checkParallelKernels(std::make_shared<ForkJoinExecutor>(4)) &&
+        checkParallelKernels(std::make_shared<PoolExecutor<TestPool>>(pool)) &&
+        checkParallelKernels(std::make_shared<PoolExecutor<ThreadPool>>(*threadPool)) &&
+        checkParallelKernels(std::make_shared<SerialExecutor>());
+
+    setMatrixExecutor(nullptr);
+    setMatrixParallelism(defaultParallelism);
+    return isPassed;
+}
+
 /** Test suit */
 void runTests() {
     std::cout << "Test run started." << std::endl;
@@ -187,6 +1383,50 @@ void runTests() {
         std::cout << "Value access tests failed" << std::endl;
     if (!testScalarMultiplication())
         std::cout << "Multiplication tests failed" << std::endl;
+    if (!testScaleKernels())
+        std::cout << "Scalar multiplication kernel tests failed" << std::endl;
+    if (!testLargeScalarMultiplication())
+        std::cout << "Large scalar multiplication tests failed" << std::endl;
+    if (!testGemmKernels())
+        std::cout << "Matrix multiplication kernel tests failed" << std::endl;
+    if (!testWideProducts())
+        std::cout << "Wide product test failed" << std::endl;
+    if (!testPackedOperand())
+        std::cout << "Packed operand product test failed" << std::endl;
+    if (!testMatrixMultiplication())
+        std::cout << "Matrix multiplication tests failed" << std::endl;
+    if (!testMove())
+        std::cout << "Move tests failed" << std::endl;
+    if (!testExpressions())
+        std::cout << "Expression tests failed" << std::endl;
+    if (!testElementType<int>() || !testElementType<std::int64_t>() ||
+        !testElementType<float>() || !testElementType<double>())
+        std::cout << "Element type tests failed" << std::endl;
+    if (!testInt64Overflow())
+        std::cout << "64-bit overflow tests failed" << std::endl;
+    if (!testFixedMatrices())
+        std::cout << "Fixed size matrix tests failed" << std::endl;
+    if (!testAlignedRows<int>() || !testAlignedRows<std::int64_t>() ||
+        !testAlignedRows<float>() || !testAlignedRows<double>())
+        std::cout << "Aligned row tests failed" << std::endl;
+    if (!testNestedRuns())
+        std::cout << "Nested executor run tests failed" << std::endl;
+    if (!testParallelKernels())
+        std::cout << "Parallel kernel tests failed" << std::endl;
+    if (!testViews())
+        std::cout << "View tests failed" << std::endl;
+    if (!testTransposeKernels())
+        std::cout << "Transposition kernel tests failed" << std::endl;
+    if (!testTranspose<int>() || !testTranspose<std::int64_t>() ||
+        !testTranspose<float>() || !testTranspose<double>())
+        std::cout << "Transposition tests failed" << std::endl;
+    if (!testSparse<int>() || !testSparse<std::int64_t>() || !testSparse<float>() || !testSparse<double>())
+        std::cout << "Sparse matrix tests failed" << std::endl;
+    if (!testSparseOverflow())
+        std::cout << "Sparse matrix overflow tests failed" << std::endl;
+    if (!testUncheckedAccess<int>() || !testUncheckedAccess<std::int64_t>() ||
+        !testUncheckedAccess<float>() || !testUncheckedAccess<double>())
+        std::cout << "Unchecked access tests failed" << std::endl;
     std::cout << "Test run completed." << std::endl;
 }
 
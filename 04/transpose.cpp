@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "transpose.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+TransposeTileKernel selectKernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+    {
+        return transposeTileAvx;
+    }
+#endif
+    return transposeTileScalar;
+}
+
+/* Transpose a full tile, 32-bit values with the selected kernel */
+template<typename T>
+inline void transposeFullTile(const T* source, std::size_t sourceStride, T* target, std::size_t targetStride)
+{
+    if constexpr (sizeof(T) == sizeof(std::uint32_t))
+    {
+        transposeTile(source, sourceStride, target, targetStride);
+    }
+    else
+    {
+        for (std::size_t i = 0; i < TRANSPOSE_TILE_SIZE; ++i)
+        {
+            for (std::size_t j = 0; j < TRANSPOSE_TILE_SIZE; ++j)
+            {
+                target[j * targetStride + i] = source[i * sourceStride + j];
+            }
+        }
+    }
+}
+
+/* Half of a dimension rounded up to whole tiles */
+inline std::size_t getHalf(std::size_t size)
+{
+    return (size / 2 + TRANSPOSE_TILE_SIZE - 1) / TRANSPOSE_TILE_SIZE * TRANSPOSE_TILE_SIZE;
+}
+
+/* Transpose a block that fits into L1: full tiles with the kernel, the edges value by value */
+template<typename T>
+void transposeBlock(const T* source, std::size_t sourceStride, T* target, std::size_t targetStride,
+                    std::size_t rowCount, std::size_t colCount)
+{
+    const std::size_t tileRowCount = rowCount / TRANSPOSE_TILE_SIZE * TRANSPOSE_TILE_SIZE;
+    const std::size_t tileColCount = colCount / TRANSPOSE_TILE_SIZE * TRANSPOSE_TILE_SIZE;
+    for (std::size_t i = 0; i < tileRowCount; i += TRANSPOSE_TILE_SIZE)
+    {
+        for (std::size_t j = 0; j < tileColCount; j += TRANSPOSE_TILE_SIZE)
+        {
+            transposeFullTile(source + i * sourceStride + j, sourceStride, target + j * targetStride + i, targetStride);
+        }
+        for (std::size_t ii = i; ii < i + TRANSPOSE_TILE_SIZE; ++ii)
+        {
+            for (std::size_t j = tileColCount; j < colCount; ++j)
+            {
+                target[j * targetStride + ii] = source[ii * sourceStride + j];
+            }
+        }
+    }
+    for (std::size_t i = tileRowCount; i < rowCount; ++i)
+    {
+        for (std::size_t j = 0; j < colCount; ++j)
+        {
+            target[j * targetStride + i] = source[i * sourceStride + j];
+        }
+    }
+}
+
+/* Exchange blocks that fit into L1, a full tile pair goes through a buffer */
+template<typename T>
+void swapBlock(T* a, T* b, std::size_t stride, std::size_t rowCount, std::size_t colCount)
+{
+    const std::size_t tileRowCount = rowCount / TRANSPOSE_TILE_SIZE * TRANSPOSE_TILE_SIZE;
+    const std::size_t tileColCount = colCount / TRANSPOSE_TILE_SIZE * TRANSPOSE_TILE_SIZE;
+    T buffer[TRANSPOSE_TILE_SIZE * TRANSPOSE_TILE_SIZE];
+    for (std::size_t i = 0; i < tileRowCount; i += TRANSPOSE_TILE_SIZE)
+    {
+        for (std::size_t j = 0; j < tileColCount; j += TRANSPOSE_TILE_SIZE)
+        {
+            T* aTile = a + i * stride + j;
+            T* bTile = b + j * stride + i;
+            transposeFullTile(aTile, stride, buffer, TRANSPOSE_TILE_SIZE);
+            transposeFullTile(bTile, stride, aTile, stride);
+            for (std::size_t r = 0; r < TRANSPOSE_TILE_SIZE; ++r)
+            {
+                std::copy(buffer + r * TRANSPOSE_TILE_SIZE, buffer + (r + 1) * TRANSPOSE_TILE_SIZE, bTile + r * stride);
+            }
+        }
+        for (std::size_t ii = i; ii < i + TRANSPOSE_TILE_SIZE; ++ii)
+        {
+            for (std::size_t j = tileColCount; j < colCount; ++j)
+            {
+                std::swap(a[ii * stride + j], b[j * stride + ii]);
+            }
+        }
+    }
+    for (std::size_t i = tileRowCount; i < rowCount; ++i)
+    {
+        for (std::size_t j = 0; j < colCount; ++j)
+        {
+            std::swap(a[i * stride + j], b[j * stride + i]);
+        }
+    }
+}
+
+}
+
+void transposeTileScalar(const void* source, std::size_t sourceStride, void* target, std::size_t targetStride)
+{
+    /* values are copied as bytes, so any 32-bit type is transposed */
+    const char* from = static_cast<const char*>(source);
+    char* to = static_cast<char*>(target);
+    for (std::size_t i = 0; i < TRANSPOSE_TILE_SIZE; ++i)
+    {
+        for (std::size_t j = 0; j < TRANSPOSE_TILE_SIZE; ++j)
+        {
+            std::memcpy(to + (j * targetStride + i) * sizeof(std::uint32_t),
+                        from + (i * sourceStride + j) * sizeof(std::uint32_t), sizeof(std::uint32_t));
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * Unpacks interleave pairs of rows, shuffles gather 4 x 4 quarters in each 128-bit lane
+ * and lane permutes put the quarters into place. The values are only moved, so the float
+ * instructions transpose integers just as well.
+ */
+__attribute__((target("avx")))
+void transposeTileAvx(const void* source, std::size_t sourceStride, void* target, std::size_t targetStride)
+{
+    const float* from = static_cast<const float*>(source);
+    float* to = static_cast<float*>(target);
+    __m256 rows[TRANSPOSE_TILE_SIZE];
+    for (std::size_t i = 0; i < TRANSPOSE_TILE_SIZE; ++i)
+    {
+        rows[i] = _mm256_loadu_ps(from + i * sourceStride);
+    }
+    __m256 pairs[TRANSPOSE_TILE_SIZE];
+    for (std::size_t i = 0; i < TRANSPOSE_TILE_SIZE; i += 2)
+    {
+        pairs[i] = _mm256_unpacklo_ps(rows[i], rows[i + 1]);
+        pairs[i + 1] = _mm256_unpackhi_ps(rows[i], rows[i + 1]);
+    }
+    __m256 quarters[TRANSPOSE_TILE_SIZE];
+    for (std::size_t i = 0; i < TRANSPOSE_TILE_SIZE; i += 4)
+    {
+        quarters[i] = _mm256_shuffle_ps(pairs[i], pairs[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        quarters[i + 1] = _mm256_shuffle_ps(pairs[i], pairs[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        quarters[i + 2] = _mm256_shuffle_ps(pairs[i + 1], pairs[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        quarters[i + 3] = _mm256_shuffle_ps(pairs[i + 1], pairs[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        _mm256_storeu_ps(to + i * targetStride, _mm256_permute2f128_ps(quarters[i], quarters[i + 4], 0x20));
+        _mm256_storeu_ps(to + (i + 4) * targetStride, _mm256_permute2f128_ps(quarters[i], quarters[i + 4], 0x31));
+    }
+}
+
+#endif
+
+const TransposeTileKernel transposeTile = selectKernel();
+
+const char* getTransposeKernelName()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (transposeTile == transposeTileAvx)
+    {
+        return "avx";
+    }
+#endif
+    return "scalar";
+}
+
+template<typename T>
+void transposeValues(const T* source, std::size_t sourceStride, T* target, std::size_t targetStride,
+                     std::size_t rowCount, std::size_t colCount)
+{
+    if (rowCount <= TRANSPOSE_BLOCK_SIZE && colCount <= TRANSPOSE_BLOCK_SIZE)
+    {
+        transposeBlock(source, sourceStride, target, targetStride, rowCount, colCount);
+    }
+    else if (rowCount >= colCount)
+    {
+        const std::size_t half = getHalf(rowCount);
+        transposeValues(source, sourceStride, target, targetStride, half, colCount);
+        transposeValues(source + half * sourceStride, sourceStride, target + half, targetStride, rowCount - half, colCount);
+    }
+    else
+    {
+        const std::size_t half = getHalf(colCount);
+        transposeValues(source, sourceStride, target, targetStride, rowCount, half);
+        transposeValues(source + half, sourceStride, target + half * targetStride, targetStride, rowCount, colCount - half);
+    }
+}
+
+template<typename T>
+void transposeSwap(T* a, T* b, std::size_t stride, std::size_t rowCount, std::size_t colCount)
+{
+    if (rowCount <= TRANSPOSE_BLOCK_SIZE && colCount <= TRANSPOSE_BLOCK_SIZE)
+    {
+        swapBlock(a, b, stride, rowCount, colCount);
+    }
+    else if (rowCount >= colCount)
+    {
+        /* the top and the bottom of a are the left and the right of b */
+        const std::size_t half = getHalf(rowCount);
+        transposeSwap(a, b, stride, half, colCount);
+        transposeSwap(a + half * stride, b + half, stride, rowCount - half, colCount);
+    }
+    else
+    {
+        const std::size_t half = getHalf(colCount);
+        transposeSwap(a, b, stride, rowCount, half);
+        transposeSwap(a + half, b + half * stride, stride, rowCount, colCount - half);
+    }
+}
+
+template<typename T>
+void transposeSquare(T* data, std::size_t stride, std::size_t size)
+{
+    if (size <= TRANSPOSE_BLOCK_SIZE)
+    {
+        /* diagonal blocks are a vanishing part of a large matrix */
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            for (std::size_t j = i + 1; j < size; ++j)
+            {
+                std::swap(data[i * stride + j], data[j * stride + i]);
+            }
+        }
+        return;
+    }
+    const std::size_t half = getHalf(size);
+    transposeSquare(data, stride, half);
+    transposeSquare(data + half * stride + half, stride, size - half);
+    transposeSwap(data + half, data + half * stride, stride, half, size - half);
+}
+
+template void transposeValues(const int*, std::size_t, int*, std::size_t, std::size_t, std::size_t);
+template void transposeValues(const std::int64_t*, std::size_t, std::int64_t*, std::size_t, std::size_t, std::size_t);
+template void transposeValues(const float*, std::size_t, float*, std::size_t, std::size_t, std::size_t);
+template void transposeValues(const double*, std::size_t, double*, std::size_t, std::size_t, std::size_t);
+
+template void transposeSquare(int*, std::size_t, std::size_t);
+template void transposeSquare(std::int64_t*, std::size_t, std::size_t);
+template void transposeSquare(float*, std::size_t, std::size_t);
+template void transposeSquare(double*, std::size_t, std::size_t);
+
+template void transposeSwap(int*, int*, std::size_t, std::size_t, std::size_t);
+template void transposeSwap(std::int64_t*, std::int64_t*, std::size_t, std::size_t, std::size_t);
+template void transposeSwap(float*, float*, std::size_t, std::size_t, std::size_t);
+template void transposeSwap(double*, double*, std::size_t, std::size_t, std::size_t);
@@ -0,0 +1,57 @@
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+#include <cstddef>
+
+/*
+ * Cache-oblivious matrix transposition.
+ *
+ * A naive transposition reads rows and writes columns, so for large matrices every written value touches
+ * another page and another cache line. Here the matrix is split in halves along its larger dimension until
+ * a block and its image fit into L1 together, so at every level of the cache hierarchy and of the TLB
+ * the blocks being processed have few enough rows to stay resident. Blocks are transposed in 8 x 8 tiles,
+ * tiles of 32-bit values are shuffled in vector registers.
+ */
+
+/* Side of a block at which the recursion stops */
+const std::size_t TRANSPOSE_BLOCK_SIZE = 32;
+/* Side of a tile */
+const std::size_t TRANSPOSE_TILE_SIZE = 8;
+
+/**
+ * Tile kernel: transpose an 8 x 8 tile of 32-bit values.
+ * Rows of the source and the target are stride values apart, the tiles must not overlap.
+ */
+typedef void (*TransposeTileKernel)(const void* source, std::size_t sourceStride, void* target, std::size_t targetStride);
+
+/* Portable tile kernel */
+void transposeTileScalar(const void* source, std::size_t sourceStride, void* target, std::size_t targetStride);
+#if defined(__x86_64__) || defined(__i386__)
+/* AVX tile kernel, eight rows are transposed in registers by unpacks, shuffles and lane permutes */
+void transposeTileAvx(const void* source, std::size_t sourceStride, void* target, std::size_t targetStride);
+#endif
+
+/* The fastest tile kernel supported by the CPU, selected at startup */
+extern const TransposeTileKernel transposeTile;
+
+/* Name of the selected tile kernel */
+const char* getTransposeKernelName();
+
+/*
+ * The functions below are defined for the matrix element types. Rows are stride values apart.
+ */
+
+/* Write the transposed rowCount x colCount source into target, the storages must not overlap */
+template<typename T>
+void transposeValues(const T* source, std::size_t sourceStride, T* target, std::size_t targetStride,
+                     std::size_t rowCount, std::size_t colCount);
+
+/* Transpose a size x size matrix in place */
+template<typename T>
+void transposeSquare(T* data, std::size_t stride, std::size_t size);
+
+/* Exchange a rowCount x colCount block a with the transposed colCount x rowCount block b, the blocks must not overlap */
+template<typename T>
+void transposeSwap(T* a, T* b, std::size_t stride, std::size_t rowCount, std::size_t colCount);
+
+#endif // TRANSPOSE_H
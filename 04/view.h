@@ -0,0 +1,397 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "expression.h"
+
+/*
+ * Zero-copy views of matrix elements.
+ *
+ * A view refers to rowCount x colCount elements, element (i, j) is data[i * rowStride + j * colStride].
+ * Sub-blocks, row and column ranges and transposition only change the pointer, the sizes and the strides,
+ * so views are passed by value and assigning a view rebinds it like a pointer. A view must not outlive the matrix
+ * it refers to, assigning or moving a run-time sized matrix invalidates its views. Views are expression leaves,
+ * they are mixed with matrices in element-wise expressions and multiplied with the blocked kernel without being copied.
+ */
+
+/*
+ * The unchecked accessors, row pointers and spans, verify indices only in the checked mode:
+ * when MATRIX_CHECKED is defined, which it is by default in builds without NDEBUG like assert().
+ * The mode must be the same in all translation units of a program.
+ */
+#if !defined(MATRIX_CHECKED) && !defined(NDEBUG)
+#define MATRIX_CHECKED
+#endif
+
+/* Throw std::out_of_range with the message if the index isn't valid in the checked mode, do nothing otherwise */
+inline void checkMatrixIndex(bool isValid, const char* message)
+{
+#ifdef MATRIX_CHECKED
+    if (!isValid)
+    {
+        throw std::out_of_range(message);
+    }
+#else
+    (void)isValid;
+    (void)message;
+#endif
+}
+
+/**
+ * Contiguous values of a matrix row, span-like: the values are accessed without checks
+ * and iterated by plain pointers, so loops over them are vectorized.
+ */
+template<typename T>
+class MatrixSpan
+{
+private:
+    T* m_data;          /* link to the first value */
+    std::size_t m_size; /* value count */
+public:
+    MatrixSpan(T* data, std::size_t size): m_data(data), m_size(size)
+    {
+    }
+    /* Get link to the first value */
+    T* data() const
+    {
+        return m_data;
+    }
+    /* Get value count */
+    std::size_t size() const
+    {
+        return m_size;
+    }
+    /* Check if there are no values */
+    bool empty() const
+    {
+        return !m_size;
+    }
+    T* begin() const
+    {
+        return m_data;
+    }
+    T* end() const
+    {
+        return m_data + m_size;
+    }
+    /* Access index operator, checked only in the checked mode */
+    T& operator[](std::size_t idx) const
+    {
+        checkMatrixIndex(idx < m_size, "Matrix column index out of range");
+        return m_data[idx];
+    }
+};
+
+/* Iterator over the rows of a matrix, yields a MatrixSpan per row */
+template<typename T>
+class MatrixRowIterator
+{
+private:
+    T* m_data;            /* link to the current row */
+    std::size_t m_size;   /* row length */
+    std::size_t m_stride; /* distance between rows in values */
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef MatrixSpan<T> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const MatrixSpan<T>* pointer;
+    typedef MatrixSpan<T> reference;
+
+    MatrixRowIterator(T* data, std::size_t size, std::size_t stride): m_data(data), m_size(size), m_stride(stride)
+    {
+    }
+    MatrixSpan<T> operator*() const
+    {
+        return MatrixSpan<T>(m_data, m_size);
+    }
+    MatrixRowIterator& operator++()
+    {
+        m_data += m_stride;
+        return *this;
+    }
+    MatrixRowIterator operator++(int)
+    {
+        MatrixRowIterator result = *this;
+        m_data += m_stride;
+        return result;
+    }
+    bool operator ==(const MatrixRowIterator& other) const
+    {
+        return m_data == other.m_data;
+    }
+    bool operator !=(const MatrixRowIterator& other) const
+    {
+        return m_data != other.m_data;
+    }
+};
+
+/* Matrix row proxy class, shared by matrices and views */
+template<typename T>
+class MatrixRow
+{
+private:
+    T* m_data;          /* link to the first value of the row */
+    std::size_t m_size; /* matrix row length */
+    std::size_t m_step; /* distance between the row values */
+public:
+    MatrixRow(T* data, std::size_t size, std::size_t step = 1): m_data(data), m_size(size), m_step(step)
+    {
+    }
+    const MatrixRow& operator=(const MatrixRow&)
+    {
+        return *this;
+    }
+    MatrixRow& operator=(MatrixRow&&) = delete;
+    MatrixRow(const MatrixRow&) = delete;
+    MatrixRow(MatrixRow&&) = delete;
+    /* Access index operator */
+    T& operator[](std::size_t idx)
+    {
+        if (idx >= m_size)
+        {
+            throw std::out_of_range("Matrix column index out of range");
+        }
+        return m_data[idx * m_step];
+    }
+};
+
+template<typename T>
+class BasicMatrixView;
+
+/* View that allows to change the values */
+template<typename T>
+using MatrixView = BasicMatrixView<T>;
+
+/* Read-only view */
+template<typename T>
+using ConstMatrixView = BasicMatrixView<const T>;
+
+/* Check if a type is a view */
+template<typename Type>
+struct IsMatrixView: std::false_type
+{
+};
+
+template<typename T>
+struct IsMatrixView<BasicMatrixView<T>>: std::true_type
+{
+};
+
+/**
+ * View of matrix elements of type T, which is const for read-only views.
+ * Like a pointer, a const view still allows to change the values it refers to.
+ */
+template<typename T>
+class BasicMatrixView: public MatrixExpression<BasicMatrixView<T>>
+{
+public:
+    typedef typename std::remove_const<T>::type Element;
+private:
+    T* m_data;               /* link to element (0, 0) */
+    std::size_t m_rowCount;  /* row count */
+    std::size_t m_colCount;  /* column count */
+    std::size_t m_rowStride; /* distance between rows in values */
+    std::size_t m_colStride; /* distance between columns in values */
+
+    /**
+     * Evaluate an expression of the view size into the view. An expression that may read the values of the view
+     * at other positions, like a transposed view of the same square, goes through a buffer of the view size;
+     * any other expression is written directly, so it is partially written on overflow.
+     */
+    template<typename Expression>
+    void assign(const Expression& source)
+    {
+        static_assert(!std::is_const<T>::value, "Read-only matrix view can't be assigned");
+        if (source.getRowCount() != m_rowCount || source.getColCount() != m_colCount)
+        {
+            throw std::out_of_range("Matrix sizes mismatch in assignment");
+        }
+        if (!source.aliases(ConstMatrixView<Element>(*this)))
+        {
+            if (m_colStride == 1)
+            {
+                evaluateExpression(source, m_data, m_rowStride);
+            }
+            else
+            {
+                evaluateExpression(source, m_data, m_rowStride, m_colStride);
+            }
+            return;
+        }
+        std::vector<Element> values(m_rowCount * m_colCount);
+        evaluateExpression(source, values.data(), m_colCount);
+        for (std::size_t i = 0; i < m_rowCount; ++i)
+        {
+            for (std::size_t j = 0; j < m_colCount; ++j)
+            {
+                m_data[i * m_rowStride + j * m_colStride] = values[i * m_colCount + j];
+            }
+        }
+    }
+public:
+    BasicMatrixView(T* data, std::size_t rowCount, std::size_t colCount, std::size_t rowStride, std::size_t colStride = 1):
+        m_data(data), m_rowCount(rowCount), m_colCount(colCount), m_rowStride(rowStride), m_colStride(colStride)
+    {
+    }
+    /* Read-only view of a mutable view */
+    template<typename Other, typename = typename std::enable_if<std::is_same<const Other, T>::value>::type>
+    BasicMatrixView(const BasicMatrixView<Other>& other):
+        BasicMatrixView(other.getData(), other.getRowCount(), other.getColCount(), other.getRowStride(), other.getColStride())
+    {
+    }
+    BasicMatrixView(const BasicMatrixView&) = default;
+    /* Rebind to the elements of another view like a pointer, the values are copied by copyFrom() */
+    BasicMatrixView& operator=(const BasicMatrixView&) = default;
+    /**
+     * Expression assignment: the expression is evaluated directly into the view, which is partially written
+     * on overflow then. The expression may refer to the values of the view: if it reads them at other positions,
+     * it is evaluated into a temporary buffer first. A bare view isn't an expression here,
+     * it is either rebound to or copied by copyFrom().
+     */
+    template<typename Expression, typename = typename std::enable_if<!IsMatrixView<Expression>::value>::type>
+    BasicMatrixView& operator=(const MatrixExpression<Expression>& expression)
+    {
+        assign(expression.self());
+        return *this;
+    }
+    /* Copy the values of a view of the same size, which may overlap this one, see the expression assignment */
+    void copyFrom(const ConstMatrixView<Element>& other)
+    {
+        assign(other);
+    }
+    /* Get link to element (0, 0) */
+    T* getData() const
+    {
+        return m_data;
+    }
+    /* Get row count */
+    std::size_t getRowCount() const
+    {
+        return m_rowCount;
+    }
+    /* Get column count */
+    std::size_t getColCount() const
+    {
+        return m_colCount;
+    }
+    /* Get distance between rows in values */
+    std::size_t getRowStride() const
+    {
+        return m_rowStride;
+    }
+    /* Get distance between columns in values */
+    std::size_t getColStride() const
+    {
+        return m_colStride;
+    }
+    /* Expression leaf: bound of the values */
+    MatrixBound getBound() const
+    {
+        return getElementBound<Element>();
+    }
+    /* Get link past the last element, equal to the link to element (0, 0) for an empty view */
+    T* getEnd() const
+    {
+        return m_rowCount && m_colCount ? m_data + (m_rowCount - 1) * m_rowStride + (m_colCount - 1) * m_colStride + 1 : m_data;
+    }
+    /* Expression leaf: check if value (i, j) may be a value of the target other than (i, j): the views overlap with different layouts */
+    bool aliases(const ConstMatrixView<Element>& target) const
+    {
+        if (m_data == target.getData() && m_rowStride == target.getRowStride() && m_colStride == target.getColStride())
+        {
+            return false;
+        }
+        const std::less<const Element*> less;
+        return less(m_data, target.getEnd()) && less(target.getData(), getEnd());
+    }
+    /* Expression leaf: value by row and column */
+    template<typename Value>
+    Value evaluate(std::size_t row, std::size_t col) const
+    {
+        return m_data[row * m_rowStride + col * m_colStride];
+    }
+    /* Get row by index */
+    MatrixRow<T> operator[](std::size_t idx) const
+    {
+        if (idx >= m_rowCount)
+        {
+            throw std::out_of_range("Matrix row index out of range");
+        }
+        return MatrixRow<T>(m_data + idx * m_rowStride, m_colCount, m_colStride);
+    }
+    /* View of rowCount x colCount elements starting at (row, col) */
+    BasicMatrixView block(std::size_t row, std::size_t col, std::size_t rowCount, std::size_t colCount) const
+    {
+        if (row > m_rowCount || rowCount > m_rowCount - row || col > m_colCount || colCount > m_colCount - col)
+        {
+            throw std::out_of_range("Matrix view out of range");
+        }
+        return BasicMatrixView(m_data + row * m_rowStride + col * m_colStride, rowCount, colCount, m_rowStride, m_colStride);
+    }
+    /* View of rows [begin, end) */
+    BasicMatrixView rows(std::size_t begin, std::size_t end) const
+    {
+        if (begin > end)
+        {
+            throw std::out_of_range("Matrix view out of range");
+        }
+        return block(begin, 0, end - begin, m_colCount);
+    }
+    /* View of columns [begin, end) */
+    BasicMatrixView cols(std::size_t begin, std::size_t end) const
+    {
+        if (begin > end)
+        {
+            throw std::out_of_range("Matrix view out of range");
+        }
+        return block(0, begin, m_rowCount, end - begin);
+    }
+    /* Transposed view */
+    BasicMatrixView transposed() const
+    {
+        return BasicMatrixView(m_data, m_colCount, m_rowCount, m_colStride, m_rowStride);
+    }
+    /* Matrix multiplication operator, see multiplyViews() */
+    Matrix<Element> operator *(const ConstMatrixView<Element>& other) const;
+    /* Equals to operator, compares the sizes and the values */
+    bool operator ==(const ConstMatrixView<Element>& other) const
+    {
+        if (m_rowCount != other.getRowCount() || m_colCount != other.getColCount())
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < m_rowCount; ++i)
+        {
+            for (std::size_t j = 0; j < m_colCount; ++j)
+            {
+                if (evaluate<Element>(i, j) != other.template evaluate<Element>(i, j))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    /* Inequal to operator */
+    bool operator !=(const ConstMatrixView<Element>& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/**
+ * Compute target = lhs * rhs with the blocked kernel over row blocks in parallel, see multiplyMatrices().
+ * The views may have any strides, so transposed operands aren't copied. The target must not overlap the operands,
+ * integer versions throw std::out_of_range on overflow and the target is partially written then.
+ * Defined for the supported element types.
+ */
+template<typename T>
+void multiplyViews(const ConstMatrixView<T>& lhs, const ConstMatrixView<T>& rhs, const MatrixView<T>& target);
+
+#endif // VIEW_H
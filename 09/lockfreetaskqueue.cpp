@@ -28,7 +28,7 @@ std::optional<std::function<void()>> LockFreeTaskQueue::acquire()
     }
     if (!head_)
     {
-        lockHead_.clear(std::memory_order::memory_order_relaxed);
+        lockHead_.clear();
         return {};
     }
     Task* head = head_;
@@ -74,7 +74,10 @@ bool LockFreeTaskQueue::tryStore(std::function<void()> task)
     }
     else
     {
-        tail_ = tail_->next_ = new Task(task);
+        // сначала связь, потом хвост: потребитель, увидевший head_ != tail_, увидит и head_->next_
+        Task* last = new Task(task);
+        tail_.load()->next_ = last;
+        tail_ = last;
     }
 
     lockTail_.clear();
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <atomic>
 #include <functional>
+#include <optional>
 
 /**
  * Очередь задач для пула потоков без блокировок
@@ -13,7 +14,7 @@ class LockFreeTaskQueue
     struct Task
     {
         std::function<void()> task_;
-        Task* next_;
+        std::atomic<Task*> next_; // пишется производителем, пока потребитель может читать
 
         Task(std::function<void()> task) :
             task_(task), next_(nullptr)
@@ -23,7 +24,7 @@ class LockFreeTaskQueue
 
     Task* head_;
     std::atomic_flag lockHead_;
-    Task* tail_;
+    std::atomic<Task*> tail_; // читается потребителем без lockTail_
     std::atomic_flag lockTail_;
 
 public:
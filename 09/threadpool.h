@@ -8,6 +8,9 @@
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifdef LOCK_FREE_QUEUE
 #include "lockfreetaskqueue.h"